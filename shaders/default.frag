@@ -4,21 +4,150 @@
 
 layout (location = 0) in vec3 inColor;
 layout (location = 1) in vec2 texCoord;
+layout (location = 2) in vec3 inWorldPosition;
+layout (location = 3) in vec3 inNormal;
+layout (location = 4) in float inViewDepth;
+layout (location = 5) flat in uint inMaterial;
 
 layout (location = 0) out vec4 outFragColor;
 
 layout (set = 2, binding = 0) uniform sampler2D tex1;
 
+// must match SHADOW_CASCADES in shadowcascades.h
+const uint SHADOW_CASCADES = 4;
+
 layout(set = 0, binding = 1) uniform  SceneData{
     vec4 fogColor; // w is for exponent
 	vec4 fogDistances; // x for min, y for max, zw unused.
 	vec4 ambientColor;
 	vec4 sunlightDirection; // w for sun power
 	vec4 sunlightColor;
+	vec4 clusterScale; // xy clusters per pixel, z slice scale, w slice bias
+	uvec4 clusterOptions; // x is 1 to show the light count per cluster instead of shading
+	mat4 cascadeMatrices[SHADOW_CASCADES];
+	vec4 cascadeSplits; // the view depth each cascade ends at
 } sceneData;
 
+// must match the CLUSTER_ constants in renderer.h and lightcull.comp
+const uint CLUSTER_X = 16;
+const uint CLUSTER_Y = 9;
+const uint CLUSTER_Z = 24;
+const uint CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+const uint MAX_LIGHTS_PER_CLUSTER = 128;
+
+struct Light {
+	vec4 position; // w is the range
+	vec4 color; // w is the intensity
+	vec4 direction;
+	vec4 spot; // x cos outer angle, y one over the fade range, z is 1 for spot lights
+};
+
+layout (std430, set = 0, binding = 2) readonly buffer LightBuffer {
+	Light lights[];
+} lightBuffer;
+
+layout (std430, set = 0, binding = 3) readonly buffer ClusterBuffer {
+	uint counts[CLUSTER_COUNT];
+	uint indices[];
+} clusterBuffer;
+
+layout (set = 0, binding = 4) uniform sampler2DArrayShadow shadowMap;
+
+// must match GPUMaterialData and MATERIAL_NO_TEXTURE in materialmanager.h
+const uint MATERIAL_NO_TEXTURE = 0xFFFFFFFFu;
+
+struct Material {
+	vec4 color;
+	vec4 emissive; // w is the strength
+	vec4 scalars; // x is the ambient occlusion
+	uvec4 textures; // x indexes the texture in the bind state's set
+};
+
+layout (std430, set = 0, binding = 5) readonly buffer MaterialBuffer {
+	Material materials[];
+} materialBuffer;
+
+vec3 heatmap(float value)
+{
+	return clamp(vec3(value * 2.0 - 0.5, 1.5 - abs(value * 2.0 - 1.0) * 2.0, 1.5 - value * 2.0), 0.0, 1.0);
+}
+
+float sunShadow(vec3 worldPosition, float viewDepth)
+{
+	if (viewDepth > sceneData.cascadeSplits[SHADOW_CASCADES - 1]) {
+		return 1.0;
+	}
+
+	uint cascade = 0;
+	for (uint i = 0; i < SHADOW_CASCADES - 1; ++i) {
+		if (viewDepth > sceneData.cascadeSplits[i]) {
+			cascade = i + 1;
+		}
+	}
+
+	vec4 shadowPosition = sceneData.cascadeMatrices[cascade] * vec4(worldPosition, 1.0);
+	vec2 uv = shadowPosition.xy * 0.5 + 0.5;
+	float depth = min(shadowPosition.z, 1.0);
+
+	// 3x3 taps on top of the sampler's own bilinear comparison
+	vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	float lit = 0.0;
+	for (int y = -1; y <= 1; ++y) {
+		for (int x = -1; x <= 1; ++x) {
+			lit += texture(shadowMap, vec4(uv + vec2(x, y) * texelSize, float(cascade), depth));
+		}
+	}
+
+	return lit / 9.0;
+}
+
 void main()
 {
-	vec3 color = texture(tex1, texCoord).xyz;
-	outFragColor = vec4(color, 1.0f);
-}
\ No newline at end of file
+	uvec2 tile = min(uvec2(gl_FragCoord.xy * sceneData.clusterScale.xy), uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+	uint slice = uint(clamp(log(inViewDepth) * sceneData.clusterScale.z + sceneData.clusterScale.w, 0.0, float(CLUSTER_Z - 1)));
+	uint cluster = tile.x + tile.y * CLUSTER_X + slice * CLUSTER_X * CLUSTER_Y;
+	uint lightCount = clusterBuffer.counts[cluster];
+
+	if (sceneData.clusterOptions.x != 0) {
+		outFragColor = vec4(heatmap(float(lightCount) / float(MAX_LIGHTS_PER_CLUSTER / 4)), 1.0f);
+		return;
+	}
+
+	Material material = materialBuffer.materials[inMaterial];
+
+	vec3 normal = normalize(inNormal);
+	vec3 lighting = sceneData.ambientColor.xyz * material.scalars.x;
+
+	float sunAmount = max(dot(normal, -normalize(sceneData.sunlightDirection.xyz)), 0.0);
+	if (sunAmount > 0.0) {
+		lighting += sceneData.sunlightColor.xyz * sceneData.sunlightDirection.w * sunAmount * sunShadow(inWorldPosition, inViewDepth);
+	}
+
+	for (uint i = 0; i < lightCount; ++i) {
+		Light light = lightBuffer.lights[clusterBuffer.indices[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+
+		vec3 toLight = light.position.xyz - inWorldPosition;
+		float distanceSquared = dot(toLight, toLight);
+		vec3 direction = toLight * inversesqrt(max(distanceSquared, 0.0001));
+
+		// inverse square falloff, windowed so it reaches zero at the range
+		float ratio = distanceSquared / (light.position.w * light.position.w);
+		float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+		float attenuation = window * window / max(distanceSquared, 0.01);
+
+		if (light.spot.z > 0.0) {
+			float cone = clamp((dot(-direction, light.direction.xyz) - light.spot.x) * light.spot.y, 0.0, 1.0);
+			attenuation *= cone * cone;
+		}
+
+		lighting += light.color.xyz * light.color.w * attenuation * max(dot(normal, direction), 0.0);
+	}
+
+	// the material is the same for the whole draw, so the branch doesn't split up a quad's derivatives
+	vec3 color = material.color.xyz;
+	if (material.textures.x != MATERIAL_NO_TEXTURE) {
+		color *= texture(tex1, texCoord).xyz;
+	}
+
+	outFragColor = vec4(color * lighting + material.emissive.xyz * material.emissive.w, 1.0f);
+}
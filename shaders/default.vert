@@ -7,6 +7,10 @@ layout (location = 3) in vec3 vTexCoord;
 
 layout (location = 0) out vec3 outColor;
 layout (location = 1) out vec3 texCoord;
+layout (location = 2) out vec3 outWorldPosition;
+layout (location = 3) out vec3 outNormal;
+layout (location = 4) out float outViewDepth;
+layout (location = 5) flat out uint outMaterial;
 
 layout (set = 0, binding = 0) uniform CameraBuffer {
 	mat4 view;
@@ -16,12 +20,17 @@ layout (set = 0, binding = 0) uniform CameraBuffer {
 
 struct ObjectData{
 	mat4 model;
+	vec4 boundsMin;
+	vec4 boundsMax;
+	uint material;
 };
 
 layout(std140,set = 1, binding = 0) readonly buffer ObjectBuffer {
 	ObjectData objects[];
 } objectBuffer;
 
+invariant gl_Position;
+
 void main()
 {
 	mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model;
@@ -29,6 +38,13 @@ void main()
 	gl_Position = transformMatrix * vec4(vPosition, 1.0f);
 	outColor = vColor;
 	texCoord = vTexCoord;
+
+	vec4 worldPosition = modelMatrix * vec4(vPosition, 1.0f);
+	outWorldPosition = worldPosition.xyz;
+	outNormal = mat3(modelMatrix) * vNormal;
+	// picks the cluster's depth slice in the fragment shader
+	outViewDepth = -(cameraData.view * worldPosition).z;
+	outMaterial = objectBuffer.objects[gl_BaseInstance].material;
 }
 
 
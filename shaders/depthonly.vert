@@ -0,0 +1,30 @@
+#version 460
+
+layout (location = 0) in vec3 vPosition;
+
+layout (set = 0, binding = 0) uniform CameraBuffer {
+	mat4 view;
+	mat4 projection;
+	mat4 matrix;
+} cameraData;
+
+struct ObjectData{
+	mat4 model;
+	vec4 boundsMin;
+	vec4 boundsMax;
+	uint material;
+};
+
+layout(std140,set = 1, binding = 0) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+} objectBuffer;
+
+// must match default.vert exactly, otherwise the equal depth test in the main pass fails
+invariant gl_Position;
+
+void main()
+{
+	mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model;
+	mat4 transformMatrix = (cameraData.matrix * modelMatrix);
+	gl_Position = transformMatrix * vec4(vPosition, 1.0f);
+}
@@ -0,0 +1,25 @@
+#version 460
+
+layout (location = 0) in vec3 vPosition;
+
+struct ObjectData{
+	mat4 model;
+	vec4 boundsMin;
+	vec4 boundsMax;
+	uint material;
+};
+
+layout(std140,set = 1, binding = 0) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+} objectBuffer;
+
+// the cascade being drawn, every cascade shares the same pipeline
+layout (push_constant) uniform constants {
+	mat4 viewProjection;
+} pushConstants;
+
+void main()
+{
+	mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model;
+	gl_Position = pushConstants.viewProjection * modelMatrix * vec4(vPosition, 1.0f);
+}
@@ -7,9 +7,12 @@
 #include <iostream>
 
 void Object::init(Renderer& renderer, LoadModelInfo modelInfo) {
+	this->renderer = &renderer;
 	model = new Model();
 	renderer.loadModel(*model, modelInfo);
 	model->transformMatrix = glm::mat4{ 1.f };
+	updateTransformationMatrix();
+	renderHandle = renderer.addRenderObject(*model, isStatic);
 }
 
 void Object::update(float deltaTime, InputHandler& inputHandler) {
@@ -17,17 +20,25 @@ void Object::update(float deltaTime, InputHandler& inputHandler) {
 }
 
 void Object::updateTransformationMatrix() {
-	model->transformMatrix = glm::translate(glm::mat4{ 1.f }, position);
-	model->transformMatrix = glm::rotate(model->transformMatrix, glm::radians(rotation.x), glm::vec3{ 0, 1, 0 });
-	model->transformMatrix = glm::rotate(model->transformMatrix, glm::radians(rotation.y), glm::vec3{ 1, 0, 0 });
-	model->transformMatrix = glm::rotate(model->transformMatrix, glm::radians(rotation.z), glm::vec3{ 0, 0, 1 });
-	model->transformMatrix = glm::scale(model->transformMatrix, glm::vec3(scale, scale, scale));
+	glm::mat4 transformMatrix = glm::translate(glm::mat4{ 1.f }, position);
+	transformMatrix = glm::rotate(transformMatrix, glm::radians(rotation.x), glm::vec3{ 0, 1, 0 });
+	transformMatrix = glm::rotate(transformMatrix, glm::radians(rotation.y), glm::vec3{ 1, 0, 0 });
+	transformMatrix = glm::rotate(transformMatrix, glm::radians(rotation.z), glm::vec3{ 0, 0, 1 });
+	transformMatrix = glm::scale(transformMatrix, glm::vec3(scale, scale, scale));
+
+	// only objects that actually moved get re-uploaded to the gpu
+	if (transformMatrix != model->transformMatrix) {
+		model->transformMatrix = transformMatrix;
+		renderer->updateRenderObjectTransform(renderHandle, transformMatrix);
+	}
 }
 
 void Object::draw(Renderer& renderer) {
-	model->addToRenderQueue(renderer);
+	// render objects are retained by the renderer, so there is nothing to queue each frame
 }
 
 void Object::cleanup() {
+	renderer->removeRenderObject(renderHandle);
+	renderer->releaseModel(*model);
 	delete model;
 }
\ No newline at end of file
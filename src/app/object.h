@@ -14,8 +14,13 @@ public:
 	virtual void cleanup() override;
 
 	Model* model;
+	RenderObjectHandle renderHandle;
 	float scale{1.f};
+	// static objects are merged into the scene's static batches and ignore later transform changes
+	bool isStatic{ false };
 
 protected:
 	void updateTransformationMatrix();
+
+	Renderer* renderer;
 };
\ No newline at end of file
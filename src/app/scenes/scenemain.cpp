@@ -7,6 +7,7 @@
 #include "imgui.h"
 
 void SceneMain::init(Renderer& renderer) {
+	this->renderer = &renderer;
 	player.init(renderer.camera);
 
 	Object object;
@@ -30,8 +31,21 @@ void SceneMain::init(Renderer& renderer) {
 	object2.scale = 0.002f;
 	object2.init(renderer, model2info);
 
+	// same mesh and texture as the first, only its material parameters differ so it still draws in the same batch
+	Object object3;
+	LoadModelInfo model3info = model1info;
+	model3info.color = glm::vec4{ 1.f, 0.6f, 0.6f, 1.f };
+	model3info.emissive = glm::vec3{ 1.f, 0.3f, 0.1f };
+	model3info.emissiveStrength = 0.2f;
+	object3.position = glm::vec3{ 9, 0, -6 };
+	object3.scale = 0.03f;
+	object3.init(renderer, model3info);
+
 	objects.push_back(object);
 	objects.push_back(object2);
+	objects.push_back(object3);
+
+	renderer.buildStaticBatches();
 }
 
 void SceneMain::update(float deltaTime, InputHandler& inputHandler) {
@@ -53,6 +67,16 @@ void SceneMain::drawDebug() {
 	ImGui::Begin("Scene");
 	ImGui::SliderFloat3("Position", &objects[1].position.x, -10.f, 10.f, "% .5f");
 	ImGui::SliderFloat("Scale", &objects[1].scale, 0.002f, 0.01f, "%.7f");
+
+	MaterialId tinted = objects[2].model->material;
+	if (const MaterialParameters* current = renderer->getMaterialParameters(tinted)) {
+		MaterialParameters parameters = *current;
+		bool changed = ImGui::ColorEdit4("Tint", &parameters.color.x);
+		changed |= ImGui::SliderFloat("Emissive Strength", &parameters.emissiveStrength, 0.f, 2.f);
+		if (changed) {
+			renderer->setMaterialParameters(tinted, parameters);
+		}
+	}
 	ImGui::End();
 }
 
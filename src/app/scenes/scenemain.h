@@ -17,4 +17,5 @@ public:
 protected:
 	std::vector<Object> objects;
 	Player player;
+	Renderer* renderer;
 };
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include "allocationtracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#ifdef ALLOCATION_CALL_SITES
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <dbghelp.h>
+#pragma comment(lib, "dbghelp.lib")
+#endif
+
+// everything here is touched from inside operator new, so it is all constant initialised and never allocates itself
+
+struct FrameCounters {
+	std::atomic<uint32_t> allocations{ 0 };
+	std::atomic<uint32_t> frees{ 0 };
+	std::atomic<size_t> bytes{ 0 };
+	std::atomic<uint32_t> vulkanAllocations{ 0 };
+	std::atomic<uint32_t> vulkanFrees{ 0 };
+	std::atomic<size_t> vulkanBytes{ 0 };
+	std::atomic<uint32_t> deviceAllocations{ 0 };
+	std::atomic<uint32_t> deviceFrees{ 0 };
+	std::atomic<VkDeviceSize> deviceBytes{ 0 };
+	std::atomic<uint32_t> noAllocViolations{ 0 };
+};
+
+static FrameCounters counters;
+static AllocationFrameStats lastFrame;
+static AllocationTrackerSettings settings;
+
+static thread_local uint32_t noAllocDepth = 0;
+// set while the tracker itself is running on this thread, so an assert or stack capture that allocates doesn't recurse
+static thread_local bool tracking = false;
+
+#ifdef ALLOCATION_CALL_SITES
+static std::atomic<uint32_t> sampleCounter{ 0 };
+static std::atomic_flag callSiteLock = ATOMIC_FLAG_INIT;
+static AllocationCallSite callSites[MAX_CALL_SITES];
+
+static void captureCallSite(size_t size) {
+	// skips this function, recordAllocation and operator new, so the first frame is whatever called new
+	AllocationCallSite site;
+	site.depth = CaptureStackBackTrace(3, CALL_SITE_DEPTH, site.frames, nullptr);
+	if (site.depth == 0) {
+		return;
+	}
+
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t i = 0; i < site.depth; ++i) {
+		hash = (hash ^ (uint64_t)site.frames[i]) * 1099511628211ull;
+	}
+
+	while (callSiteLock.test_and_set(std::memory_order_acquire)) {}
+
+	// open addressing, once the table fills up for the frame new call sites are dropped
+	for (uint32_t probe = 0; probe < MAX_CALL_SITES; ++probe) {
+		AllocationCallSite& entry = callSites[(hash + probe) % MAX_CALL_SITES];
+		if (entry.depth == 0) {
+			entry = site;
+		} else if (entry.depth != site.depth || memcmp(entry.frames, site.frames, site.depth * sizeof(void*)) != 0) {
+			continue;
+		}
+
+		++entry.samples;
+		entry.bytes += size;
+		break;
+	}
+
+	callSiteLock.clear(std::memory_order_release);
+}
+#endif
+
+static void recordAllocation(size_t size) {
+	counters.allocations.fetch_add(1, std::memory_order_relaxed);
+	counters.bytes.fetch_add(size, std::memory_order_relaxed);
+
+	if (tracking) {
+		return;
+	}
+	tracking = true;
+
+	if (noAllocDepth > 0) {
+		counters.noAllocViolations.fetch_add(1, std::memory_order_relaxed);
+		assert(!settings.assertInNoAllocScope && "Heap allocation inside a NoAllocScope");
+	}
+
+#ifdef ALLOCATION_CALL_SITES
+	if (sampleCounter.fetch_add(1, std::memory_order_relaxed) % std::max(settings.sampleInterval, 1u) == 0) {
+		captureCallSite(size);
+	}
+#endif
+
+	tracking = false;
+}
+
+static void recordFree() {
+	counters.frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void* allocateAligned(size_t size, size_t alignment) {
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	return std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+}
+
+static void freeAligned(void* memory) {
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+static void* allocate(size_t size) {
+	recordAllocation(size);
+	void* memory = std::malloc(size == 0 ? 1 : size);
+	if (!memory) {
+		throw std::bad_alloc();
+	}
+
+	return memory;
+}
+
+static void* allocate(size_t size, std::align_val_t alignment) {
+	recordAllocation(size);
+	void* memory = allocateAligned(size == 0 ? 1 : size, (size_t)alignment);
+	if (!memory) {
+		throw std::bad_alloc();
+	}
+
+	return memory;
+}
+
+static void release(void* memory) {
+	if (memory) {
+		recordFree();
+		std::free(memory);
+	}
+}
+
+static void release(void* memory, std::align_val_t) {
+	if (memory) {
+		recordFree();
+		freeAligned(memory);
+	}
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocate(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocate(size, alignment); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	try { return allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	try { return allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try { return allocate(size, alignment); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try { return allocate(size, alignment); } catch (...) { return nullptr; }
+}
+
+void operator delete(void* memory) noexcept { release(memory); }
+void operator delete[](void* memory) noexcept { release(memory); }
+void operator delete(void* memory, size_t) noexcept { release(memory); }
+void operator delete[](void* memory, size_t) noexcept { release(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { release(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { release(memory); }
+void operator delete(void* memory, std::align_val_t alignment) noexcept { release(memory, alignment); }
+void operator delete[](void* memory, std::align_val_t alignment) noexcept { release(memory, alignment); }
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept { release(memory, alignment); }
+void operator delete[](void* memory, size_t, std::align_val_t alignment) noexcept { release(memory, alignment); }
+void operator delete(void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept { release(memory, alignment); }
+void operator delete[](void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept { release(memory, alignment); }
+
+// Vulkan only hands back the pointer when freeing or reallocating, so its size and padding are kept in front of it
+struct VulkanBlock {
+	size_t size;
+	size_t offset;
+};
+
+static void* VKAPI_PTR vulkanAllocation(void*, size_t size, size_t alignment, VkSystemAllocationScope) {
+	alignment = std::max(alignment, alignof(std::max_align_t));
+	const size_t offset = (sizeof(VulkanBlock) + alignment - 1) & ~(alignment - 1);
+	uint8_t* memory = (uint8_t*)allocateAligned(offset + size, alignment);
+	if (!memory) {
+		return nullptr;
+	}
+
+	VulkanBlock* block = (VulkanBlock*)(memory + offset) - 1;
+	block->size = size;
+	block->offset = offset;
+
+	counters.vulkanAllocations.fetch_add(1, std::memory_order_relaxed);
+	counters.vulkanBytes.fetch_add(size, std::memory_order_relaxed);
+	return memory + offset;
+}
+
+static void VKAPI_PTR vulkanFree(void*, void* memory) {
+	if (!memory) {
+		return;
+	}
+
+	const VulkanBlock* block = (const VulkanBlock*)memory - 1;
+	counters.vulkanFrees.fetch_add(1, std::memory_order_relaxed);
+	freeAligned((uint8_t*)memory - block->offset);
+}
+
+static void* VKAPI_PTR vulkanReallocation(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	if (!original) {
+		return vulkanAllocation(userData, size, alignment, scope);
+	}
+	if (size == 0) {
+		vulkanFree(userData, original);
+		return nullptr;
+	}
+
+	void* memory = vulkanAllocation(userData, size, alignment, scope);
+	if (memory) {
+		memcpy(memory, original, std::min(size, ((const VulkanBlock*)original - 1)->size));
+		vulkanFree(userData, original);
+	}
+
+	return memory;
+}
+
+static void VKAPI_PTR deviceAllocation(VmaAllocator, uint32_t, VkDeviceMemory, VkDeviceSize size, void*) {
+	counters.deviceAllocations.fetch_add(1, std::memory_order_relaxed);
+	counters.deviceBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+static void VKAPI_PTR deviceFree(VmaAllocator, uint32_t, VkDeviceMemory, VkDeviceSize, void*) {
+	counters.deviceFrees.fetch_add(1, std::memory_order_relaxed);
+}
+
+static const VkAllocationCallbacks vulkanCallbacks = { nullptr, vulkanAllocation, vulkanReallocation, vulkanFree, nullptr, nullptr };
+static const VmaDeviceMemoryCallbacks deviceMemoryCallbacks = { deviceAllocation, deviceFree, nullptr };
+
+void allocationtracker::beginFrame() {
+	lastFrame.allocations = counters.allocations.exchange(0, std::memory_order_relaxed);
+	lastFrame.frees = counters.frees.exchange(0, std::memory_order_relaxed);
+	lastFrame.bytes = counters.bytes.exchange(0, std::memory_order_relaxed);
+	lastFrame.vulkanAllocations = counters.vulkanAllocations.exchange(0, std::memory_order_relaxed);
+	lastFrame.vulkanFrees = counters.vulkanFrees.exchange(0, std::memory_order_relaxed);
+	lastFrame.vulkanBytes = counters.vulkanBytes.exchange(0, std::memory_order_relaxed);
+	lastFrame.deviceAllocations = counters.deviceAllocations.exchange(0, std::memory_order_relaxed);
+	lastFrame.deviceFrees = counters.deviceFrees.exchange(0, std::memory_order_relaxed);
+	lastFrame.deviceBytes = counters.deviceBytes.exchange(0, std::memory_order_relaxed);
+	lastFrame.noAllocViolations = counters.noAllocViolations.exchange(0, std::memory_order_relaxed);
+
+#ifdef ALLOCATION_CALL_SITES
+	while (callSiteLock.test_and_set(std::memory_order_acquire)) {}
+
+	lastFrame.callSiteCount = 0;
+	for (AllocationCallSite& site : callSites) {
+		if (site.depth > 0) {
+			lastFrame.callSites[lastFrame.callSiteCount++] = site;
+			site = {};
+		}
+	}
+
+	callSiteLock.clear(std::memory_order_release);
+
+	std::sort(lastFrame.callSites, lastFrame.callSites + lastFrame.callSiteCount, [](const AllocationCallSite& a, const AllocationCallSite& b) {
+		return a.samples > b.samples;
+	});
+#endif
+}
+
+const AllocationFrameStats& allocationtracker::getLastFrame() {
+	return lastFrame;
+}
+
+AllocationTrackerSettings& allocationtracker::getSettings() {
+	return settings;
+}
+
+const VkAllocationCallbacks* allocationtracker::getVulkanCallbacks() {
+	return &vulkanCallbacks;
+}
+
+const VmaDeviceMemoryCallbacks* allocationtracker::getDeviceMemoryCallbacks() {
+	return &deviceMemoryCallbacks;
+}
+
+void allocationtracker::describeAddress(void* address, char* buffer, size_t bufferSize) {
+#ifdef ALLOCATION_CALL_SITES
+	HANDLE process = GetCurrentProcess();
+	static bool symbolsLoaded = false;
+	if (!symbolsLoaded) {
+		SymSetOptions(SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES | SYMOPT_UNDNAME);
+		SymInitialize(process, nullptr, TRUE);
+		symbolsLoaded = true;
+	}
+
+	alignas(SYMBOL_INFO) char symbolBuffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+	SYMBOL_INFO* symbol = (SYMBOL_INFO*)symbolBuffer;
+	symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+	symbol->MaxNameLen = MAX_SYM_NAME;
+
+	DWORD64 displacement = 0;
+	if (SymFromAddr(process, (DWORD64)address, &displacement, symbol)) {
+		IMAGEHLP_LINE64 line = {};
+		line.SizeOfStruct = sizeof(IMAGEHLP_LINE64);
+		DWORD lineDisplacement = 0;
+		if (SymGetLineFromAddr64(process, (DWORD64)address, &lineDisplacement, &line)) {
+			snprintf(buffer, bufferSize, "%s (%s:%lu)", symbol->Name, line.FileName, line.LineNumber);
+		} else {
+			snprintf(buffer, bufferSize, "%s", symbol->Name);
+		}
+		return;
+	}
+#endif
+
+	snprintf(buffer, bufferSize, "%p", address);
+}
+
+NoAllocScope::NoAllocScope() {
+	++noAllocDepth;
+}
+
+NoAllocScope::~NoAllocScope() {
+	--noAllocDepth;
+}
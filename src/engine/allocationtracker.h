@@ -0,0 +1,75 @@
+#pragma once
+
+#include <utils/types.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// call sites are only sampled in debug builds on Windows, capturing a stack is too slow to leave on elsewhere
+#if defined(_DEBUG) && defined(_WIN32)
+#define ALLOCATION_CALL_SITES
+#endif
+
+constexpr uint32_t CALL_SITE_DEPTH = 12;
+constexpr uint32_t MAX_CALL_SITES = 128;
+
+struct AllocationTrackerSettings {
+	// asserts in debug builds when the heap is touched inside a NoAllocScope. Off by default, loading and the first frames allocate legitimately
+	bool assertInNoAllocScope{ false };
+	// one in this many heap allocations has its stack captured
+	uint32_t sampleInterval{ 64 };
+};
+
+struct AllocationCallSite {
+	void* frames[CALL_SITE_DEPTH];
+	uint32_t depth{ 0 };
+	uint32_t samples{ 0 };
+	size_t bytes{ 0 };
+};
+
+struct AllocationFrameStats {
+	// global operator new and delete
+	uint32_t allocations{ 0 };
+	uint32_t frees{ 0 };
+	size_t bytes{ 0 };
+	// host memory VMA and the driver allocate through the callbacks handed to the allocator
+	uint32_t vulkanAllocations{ 0 };
+	uint32_t vulkanFrees{ 0 };
+	size_t vulkanBytes{ 0 };
+	// vkAllocateMemory calls VMA makes for new blocks and dedicated allocations
+	uint32_t deviceAllocations{ 0 };
+	uint32_t deviceFrees{ 0 };
+	VkDeviceSize deviceBytes{ 0 };
+	// heap allocations made inside a NoAllocScope
+	uint32_t noAllocViolations{ 0 };
+
+	uint32_t callSiteCount{ 0 };
+	AllocationCallSite callSites[MAX_CALL_SITES];
+};
+
+// Counts every heap allocation through replacements of the global operator new and delete, along with the
+// host and device allocations VMA makes, and hands them out a frame at a time
+namespace allocationtracker {
+	// Closes off the last frame's counts, call once at the top of the main loop
+	void beginFrame();
+	const AllocationFrameStats& getLastFrame();
+	AllocationTrackerSettings& getSettings();
+
+	// For VmaAllocatorCreateInfo, so the allocator's own allocations show up alongside the heap's
+	const VkAllocationCallbacks* getVulkanCallbacks();
+	const VmaDeviceMemoryCallbacks* getDeviceMemoryCallbacks();
+
+	// Writes the function, and file and line where known, that the address belongs to
+	void describeAddress(void* address, char* buffer, size_t bufferSize);
+}
+
+// Marks the calling thread as not allowed to allocate while the scope is open. Only that thread is checked,
+// jobs it hands to the workers and anything the workers were already doing aren't
+class NoAllocScope {
+public:
+	NoAllocScope();
+	~NoAllocScope();
+
+	NoAllocScope(const NoAllocScope&) = delete;
+	NoAllocScope& operator=(const NoAllocScope&) = delete;
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+struct Mesh;
+struct Texture;
+
+#include <cstdint>
+#include <utility>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Refers to an asset in an AssetPool. A stale handle, whose asset was evicted and its slot reused, resolves to nothing
+template<typename T>
+struct AssetHandle {
+	uint32_t index{ UINT32_MAX };
+	uint32_t generation{ 0 };
+
+	bool isValid() const { return index != UINT32_MAX; }
+	bool operator==(const AssetHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const AssetHandle& other) const { return !(*this == other); }
+};
+
+using MeshHandle = AssetHandle<Mesh>;
+using TextureHandle = AssetHandle<Texture>;
+
+struct AssetMemory {
+	size_t cpuBytes{ 0 };
+	size_t gpuBytes{ 0 };
+};
+
+// Loaded assets in a fixed number of slots, looked up by name. Slots never move, so pointers to an asset stay valid until it is removed.
+// Assets are reference counted by whoever draws with them, and the unreferenced ones are kept around for reuse until memory is needed
+template<typename T>
+class AssetPool {
+public:
+	using Handle = AssetHandle<T>;
+
+	void init(uint32_t capacity) {
+		slots.clear();
+		slots.resize(capacity);
+		freeSlots.clear();
+		freeSlots.reserve(capacity);
+		for (uint32_t i = capacity; i > 0; --i) {
+			freeSlots.push_back(i - 1);
+		}
+		names.clear();
+		usage = {};
+		liveCount = 0;
+	}
+
+	Handle find(const std::string& name) const {
+		auto entry = names.find(name);
+		return entry == names.end() ? Handle{} : entry->second;
+	}
+
+	// Returns an invalid handle when every slot is taken
+	Handle add(const std::string& name, T&& asset, AssetMemory memory, uint64_t tick) {
+		if (freeSlots.empty()) {
+			return {};
+		}
+
+		const uint32_t index = freeSlots.back();
+		freeSlots.pop_back();
+
+		Slot& slot = slots[index];
+		slot.asset = std::move(asset);
+		slot.name = name;
+		slot.memory = memory;
+		slot.references = 0;
+		slot.lastUsed = tick;
+		slot.alive = true;
+
+		usage.cpuBytes += memory.cpuBytes;
+		usage.gpuBytes += memory.gpuBytes;
+		++liveCount;
+
+		const Handle handle = { index, slot.generation };
+		names[name] = handle;
+		return handle;
+	}
+
+	// The asset is destroyed by the caller, the pool only forgets it and hands its slot out again
+	void remove(Handle handle) {
+		Slot* slot = getSlot(handle);
+		if (!slot) {
+			return;
+		}
+
+		usage.cpuBytes -= slot->memory.cpuBytes;
+		usage.gpuBytes -= slot->memory.gpuBytes;
+		--liveCount;
+
+		names.erase(slot->name);
+		slot->asset = T{};
+		slot->name.clear();
+		slot->alive = false;
+		// the old handles stop resolving once the generation moves on
+		++slot->generation;
+		freeSlots.push_back(handle.index);
+	}
+
+	T* get(Handle handle) {
+		Slot* slot = getSlot(handle);
+		return slot ? &slot->asset : nullptr;
+	}
+
+	void acquire(Handle handle, uint64_t tick) {
+		if (Slot* slot = getSlot(handle)) {
+			++slot->references;
+			slot->lastUsed = tick;
+		}
+	}
+
+	void release(Handle handle, uint64_t tick) {
+		Slot* slot = getSlot(handle);
+		if (slot && slot->references > 0) {
+			--slot->references;
+			slot->lastUsed = tick;
+		}
+	}
+
+	// The unreferenced asset that was used longest ago, or an invalid handle if every asset is in use
+	Handle leastRecentlyUsed() const {
+		Handle oldest;
+		uint64_t oldestTick = UINT64_MAX;
+		for (uint32_t i = 0; i < (uint32_t)slots.size(); ++i) {
+			const Slot& slot = slots[i];
+			if (slot.alive && slot.references == 0 && slot.lastUsed < oldestTick) {
+				oldest = { i, slot.generation };
+				oldestTick = slot.lastUsed;
+			}
+		}
+
+		return oldest;
+	}
+
+	template<typename F>
+	void forEach(F&& function) {
+		for (Slot& slot : slots) {
+			if (slot.alive) {
+				function(slot.asset);
+			}
+		}
+	}
+
+	uint32_t getReferences(Handle handle) const {
+		const Slot* slot = getSlot(handle);
+		return slot ? slot->references : 0;
+	}
+
+	uint64_t getLastUsed(Handle handle) const {
+		const Slot* slot = getSlot(handle);
+		return slot ? slot->lastUsed : 0;
+	}
+
+	const std::string& getName(Handle handle) const {
+		static const std::string none;
+		const Slot* slot = getSlot(handle);
+		return slot ? slot->name : none;
+	}
+
+	const AssetMemory& getUsage() const { return usage; }
+	uint32_t getCount() const { return liveCount; }
+	uint32_t getCapacity() const { return (uint32_t)slots.size(); }
+
+protected:
+	struct Slot {
+		T asset{};
+		std::string name;
+		AssetMemory memory;
+		uint32_t references{ 0 };
+		uint32_t generation{ 0 };
+		// the frame the asset was last acquired or released on, eviction goes for the oldest first
+		uint64_t lastUsed{ 0 };
+		bool alive{ false };
+	};
+
+	const Slot* getSlot(Handle handle) const {
+		if (handle.index >= slots.size()) {
+			return nullptr;
+		}
+
+		const Slot& slot = slots[handle.index];
+		return slot.alive && slot.generation == handle.generation ? &slot : nullptr;
+	}
+
+	Slot* getSlot(Handle handle) {
+		return const_cast<Slot*>(static_cast<const AssetPool*>(this)->getSlot(handle));
+	}
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	std::unordered_map<std::string, Handle> names;
+	AssetMemory usage;
+	uint32_t liveCount{ 0 };
+};
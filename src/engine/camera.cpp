@@ -30,7 +30,7 @@ void Camera::yaw(float angle) {
 }
 
 glm::mat4 Camera::projection() const {
-	glm::mat4 projection = glm::perspective(glm::radians(fov), aspect, 0.1f, 200.f);
+	glm::mat4 projection = glm::perspective(glm::radians(fov), aspect, nearPlane, farPlane);
 	projection[1][1] *= -1;
 
 	return projection;
@@ -49,4 +49,40 @@ glm::mat4 Camera::view() const {
 
 glm::mat4 Camera::matrix() const {
 	return projection() * view();
+}
+
+Frustum Camera::frustum() const {
+	glm::mat4 m = matrix();
+	glm::vec4 rows[4] = { glm::row(m, 0), glm::row(m, 1), glm::row(m, 2), glm::row(m, 3) };
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0]; // left
+	frustum.planes[1] = rows[3] - rows[0]; // right
+	frustum.planes[2] = rows[3] + rows[1]; // bottom
+	frustum.planes[3] = rows[3] - rows[1]; // top
+	frustum.planes[4] = rows[3] + rows[2]; // near
+	frustum.planes[5] = rows[3] - rows[2]; // far
+
+	for (glm::vec4& plane : frustum.planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+bool Frustum::intersects(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const {
+	for (const glm::vec4& plane : planes) {
+		// test the corner of the box furthest along the plane normal, if that is behind the plane the whole box is
+		glm::vec3 positive{
+			plane.x > 0.f ? boundsMax.x : boundsMin.x,
+			plane.y > 0.f ? boundsMax.y : boundsMin.y,
+			plane.z > 0.f ? boundsMax.z : boundsMin.z,
+		};
+
+		if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.f) {
+			return false;
+		}
+	}
+
+	return true;
 }
\ No newline at end of file
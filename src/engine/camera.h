@@ -6,6 +6,13 @@
 constexpr float MIN_PITCH = -90.f;
 constexpr float MAX_PITCH = 90.f;
 
+struct Frustum {
+	// xyz is the plane normal pointing into the frustum, w the distance
+	glm::vec4 planes[6];
+
+	bool intersects(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+};
+
 class Camera {
 public:
 	void init();
@@ -16,10 +23,13 @@ public:
 	glm::mat4 projection() const;
 	glm::mat4 view() const;
 	glm::mat4 matrix() const;
+	Frustum frustum() const;
 
 	glm::vec3 position{ 0.f };
 	glm::vec3 rotation{ 0.f };
 	float fov{ 70.f };
 	float aspect{ 1920.f / 1080.f };
+	float nearPlane{ 0.1f };
+	float farPlane{ 200.f };
 
 };
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "descriptorallocator.h"
+
+#include <algorithm>
+#include <functional>
+
+constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+template<typename T>
+static void hashCombine(size_t& seed, const T& value) {
+	seed ^= std::hash<T>{}(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+void DescriptorAllocator::init(VkDevice device, uint32_t initialSets, const std::vector<DescriptorPoolRatio>& ratios) {
+	this->device = device;
+	this->ratios = ratios;
+	setsPerPool = initialSets;
+}
+
+void DescriptorAllocator::cleanup() {
+	for (VkDescriptorPool pool : usedPools) {
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+	for (VkDescriptorPool pool : freePools) {
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+
+	usedPools.clear();
+	freePools.clear();
+	currentPool = VK_NULL_HANDLE;
+	stats = {};
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+	if (currentPool == VK_NULL_HANDLE) {
+		currentPool = grabPool();
+	}
+
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.pNext = nullptr;
+	allocateInfo.descriptorPool = currentPool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	VkResult result = currentPool != VK_NULL_HANDLE ? vkAllocateDescriptorSets(device, &allocateInfo, &set) : VK_ERROR_OUT_OF_POOL_MEMORY;
+
+	// the pool is full, or too fragmented for this layout, so the set goes into a fresh one
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+		currentPool = grabPool();
+		if (currentPool == VK_NULL_HANDLE) {
+			return VK_NULL_HANDLE;
+		}
+
+		allocateInfo.descriptorPool = currentPool;
+		result = vkAllocateDescriptorSets(device, &allocateInfo, &set);
+	}
+
+	if (result != VK_SUCCESS) {
+		return VK_NULL_HANDLE;
+	}
+
+	++stats.sets;
+	return set;
+}
+
+void DescriptorAllocator::reset() {
+	for (VkDescriptorPool pool : usedPools) {
+		vkResetDescriptorPool(device, pool, 0);
+		freePools.push_back(pool);
+	}
+
+	usedPools.clear();
+	currentPool = VK_NULL_HANDLE;
+	stats.sets = 0;
+}
+
+VkDescriptorPool DescriptorAllocator::grabPool() {
+	if (!freePools.empty()) {
+		VkDescriptorPool pool = freePools.back();
+		freePools.pop_back();
+		usedPools.push_back(pool);
+		return pool;
+	}
+
+	std::vector<VkDescriptorPoolSize> sizes;
+	sizes.reserve(ratios.size());
+	for (const DescriptorPoolRatio& ratio : ratios) {
+		sizes.push_back({ ratio.type, std::max((uint32_t)(ratio.ratio * setsPerPool), 1u) });
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.pNext = nullptr;
+	poolInfo.flags = 0;
+	poolInfo.maxSets = setsPerPool;
+	poolInfo.poolSizeCount = (uint32_t)sizes.size();
+	poolInfo.pPoolSizes = sizes.data();
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		return VK_NULL_HANDLE;
+	}
+
+	if (stats.pools > 0) {
+		++stats.grows;
+	}
+	++stats.pools;
+	setsPerPool = std::min(setsPerPool * 2, MAX_SETS_PER_POOL);
+
+	usedPools.push_back(pool);
+	return pool;
+}
+
+void DescriptorLayoutCache::init(VkDevice device) {
+	this->device = device;
+}
+
+void DescriptorLayoutCache::cleanup() {
+	for (auto& [info, layout] : layouts) {
+		vkDestroyDescriptorSetLayout(device, layout, nullptr);
+	}
+
+	layouts.clear();
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::createLayout(const VkDescriptorSetLayoutCreateInfo& createInfo) {
+	LayoutInfo info;
+	info.flags = createInfo.flags;
+	info.bindings.assign(createInfo.pBindings, createInfo.pBindings + createInfo.bindingCount);
+	std::sort(info.bindings.begin(), info.bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+		return a.binding < b.binding;
+	});
+
+	auto cached = layouts.find(info);
+	if (cached != layouts.end()) {
+		return cached->second;
+	}
+
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	if (vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &layout) != VK_SUCCESS) {
+		return VK_NULL_HANDLE;
+	}
+
+	layouts[std::move(info)] = layout;
+	return layout;
+}
+
+bool DescriptorLayoutCache::LayoutInfo::operator==(const LayoutInfo& other) const {
+	if (flags != other.flags || bindings.size() != other.bindings.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < bindings.size(); ++i) {
+		const VkDescriptorSetLayoutBinding& a = bindings[i];
+		const VkDescriptorSetLayoutBinding& b = other.bindings[i];
+		if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+size_t DescriptorLayoutCache::LayoutHash::operator()(const LayoutInfo& info) const {
+	size_t seed = info.bindings.size();
+	hashCombine(seed, info.flags);
+	for (const VkDescriptorSetLayoutBinding& binding : info.bindings) {
+		hashCombine(seed, binding.binding);
+		hashCombine(seed, (uint32_t)binding.descriptorType);
+		hashCombine(seed, binding.descriptorCount);
+		hashCombine(seed, binding.stageFlags);
+	}
+
+	return seed;
+}
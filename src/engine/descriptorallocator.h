@@ -0,0 +1,76 @@
+#pragma once
+
+#include <utils/types.h>
+
+#include <unordered_map>
+#include <vector>
+
+// How many descriptors of a type a pool holds for each set it is sized for
+struct DescriptorPoolRatio {
+	VkDescriptorType type;
+	float ratio;
+};
+
+struct DescriptorAllocatorStats {
+	uint32_t pools{ 0 };
+	// sets handed out since the last reset
+	uint32_t sets{ 0 };
+	// pools created because every existing one had run out
+	uint32_t grows{ 0 };
+};
+
+// Hands out sets from a chain of pools, starting a new one whenever the current one runs out, so callers never size pools themselves.
+// Sets can't be freed one at a time, reset hands every pool back at once for the next round of allocations
+class DescriptorAllocator {
+public:
+	void init(VkDevice device, uint32_t initialSets, const std::vector<DescriptorPoolRatio>& ratios);
+	void cleanup();
+
+	// Only returns VK_NULL_HANDLE when a new pool can't be created either
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+	// Every set allocated so far is invalid afterwards, the caller makes sure the GPU is done with them
+	void reset();
+
+	const DescriptorAllocatorStats& getStats() const { return stats; }
+
+protected:
+	VkDescriptorPool grabPool();
+
+	VkDevice device;
+	std::vector<DescriptorPoolRatio> ratios;
+	// each new pool is sized for twice as many sets as the last, up to MAX_SETS_PER_POOL
+	uint32_t setsPerPool{ 0 };
+
+	VkDescriptorPool currentPool{ VK_NULL_HANDLE };
+	std::vector<VkDescriptorPool> usedPools;
+	std::vector<VkDescriptorPool> freePools;
+
+	DescriptorAllocatorStats stats;
+};
+
+// Creates each distinct set layout once. Layouts are matched on their flags and bindings in any order,
+// pNext chains and immutable samplers aren't part of the match
+class DescriptorLayoutCache {
+public:
+	void init(VkDevice device);
+	void cleanup();
+
+	VkDescriptorSetLayout createLayout(const VkDescriptorSetLayoutCreateInfo& info);
+
+	uint32_t getCount() const { return (uint32_t)layouts.size(); }
+
+protected:
+	struct LayoutInfo {
+		VkDescriptorSetLayoutCreateFlags flags;
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+		bool operator==(const LayoutInfo& other) const;
+	};
+
+	struct LayoutHash {
+		size_t operator()(const LayoutInfo& info) const;
+	};
+
+	VkDevice device;
+	std::unordered_map<LayoutInfo, VkDescriptorSetLayout, LayoutHash> layouts;
+};
@@ -0,0 +1,117 @@
+#include "descriptorwriter.h"
+
+#include <chrono>
+
+#include "console.h"
+
+void DescriptorWriter::init(VkDevice device, Console& console) {
+	this->device = device;
+	this->console = &console;
+}
+
+void DescriptorWriter::cleanup() {
+	for (VkDescriptorUpdateTemplate updateTemplate : templates) {
+		vkDestroyDescriptorUpdateTemplate(device, updateTemplate, nullptr);
+	}
+
+	templates.clear();
+}
+
+void DescriptorWriter::writeBuffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+
+	writes.push_back(write);
+	pendingWrites.push_back({ (uint32_t)bufferInfos.size(), false });
+	bufferInfos.push_back({ buffer, offset, range });
+}
+
+void DescriptorWriter::writeImage(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView view, VkImageLayout layout) {
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+
+	writes.push_back(write);
+	pendingWrites.push_back({ (uint32_t)imageInfos.size(), true });
+	imageInfos.push_back({ sampler, view, layout });
+}
+
+VkDescriptorUpdateTemplate DescriptorWriter::createTemplate(VkDescriptorSetLayout layout, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount) {
+	std::vector<VkDescriptorUpdateTemplateEntry> entries(bindingCount);
+	size_t offset = 0;
+	for (uint32_t i = 0; i < bindingCount; ++i) {
+		VkDescriptorUpdateTemplateEntry& entry = entries[i];
+		entry.dstBinding = bindings[i].binding;
+		entry.dstArrayElement = 0;
+		entry.descriptorCount = bindings[i].descriptorCount;
+		entry.descriptorType = bindings[i].descriptorType;
+		entry.offset = offset;
+		entry.stride = sizeof(DescriptorData);
+		offset += bindings[i].descriptorCount * sizeof(DescriptorData);
+	}
+
+	VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+	templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+	templateInfo.pNext = nullptr;
+	templateInfo.descriptorUpdateEntryCount = bindingCount;
+	templateInfo.pDescriptorUpdateEntries = entries.data();
+	templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+	templateInfo.descriptorSetLayout = layout;
+
+	VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
+	VK_CHECK(vkCreateDescriptorUpdateTemplate(device, &templateInfo, nullptr, &updateTemplate), *console);
+
+	templates.push_back(updateTemplate);
+	return updateTemplate;
+}
+
+void DescriptorWriter::writeTemplate(VkDescriptorSet set, VkDescriptorUpdateTemplate updateTemplate, const DescriptorData* data, uint32_t count) {
+	templatedWrites.push_back({ set, updateTemplate, (uint32_t)templateData.size() });
+	templateData.insert(templateData.end(), data, data + count);
+}
+
+void DescriptorWriter::flush() {
+	if (isEmpty()) {
+		return;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (size_t i = 0; i < writes.size(); ++i) {
+		const PendingWrite& pending = pendingWrites[i];
+		if (pending.image) {
+			writes[i].pImageInfo = &imageInfos[pending.info];
+		} else {
+			writes[i].pBufferInfo = &bufferInfos[pending.info];
+		}
+	}
+
+	if (!writes.empty()) {
+		vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+	}
+
+	for (const TemplatedWrite& write : templatedWrites) {
+		vkUpdateDescriptorSetWithTemplate(device, write.set, write.updateTemplate, &templateData[write.data]);
+	}
+
+	stats.writes = (uint32_t)writes.size();
+	stats.templatedWrites = (uint32_t)templatedWrites.size();
+	stats.totalWrites += writes.size() + templatedWrites.size();
+	stats.flushTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	writes.clear();
+	pendingWrites.clear();
+	imageInfos.clear();
+	bufferInfos.clear();
+	templatedWrites.clear();
+	templateData.clear();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+class Console;
+
+#include <utils/types.h>
+
+#include <vector>
+
+// One descriptor's worth of template data, so image and buffer bindings can share a stride
+union DescriptorData {
+	VkDescriptorImageInfo image;
+	VkDescriptorBufferInfo buffer;
+};
+
+struct DescriptorWriterStats {
+	// what the last flush wrote, and how long it took in ms
+	uint32_t writes{ 0 };
+	uint32_t templatedWrites{ 0 };
+	float flushTime{ 0.f };
+	uint64_t totalWrites{ 0 };
+};
+
+// Queues descriptor writes and hands them to the driver together in flush, one vkUpdateDescriptorSets call for all of them.
+// Layouts that are rewritten all the time can be given an update template instead, which skips building a VkWriteDescriptorSet per binding.
+// Nothing is written until flush, which has to come before the sets are bound and while the GPU isn't reading them
+class DescriptorWriter {
+public:
+	void init(VkDevice device, Console& console);
+	// Destroys the templates
+	void cleanup();
+
+	void writeBuffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+	void writeImage(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView view, VkImageLayout layout);
+
+	// The template covers the given bindings in order, each reading its descriptors from consecutive DescriptorData
+	VkDescriptorUpdateTemplate createTemplate(VkDescriptorSetLayout layout, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount);
+	// The data is copied, so it only has to live until the call returns
+	void writeTemplate(VkDescriptorSet set, VkDescriptorUpdateTemplate updateTemplate, const DescriptorData* data, uint32_t count);
+
+	void flush();
+	bool isEmpty() const { return writes.empty() && templatedWrites.empty(); }
+
+	const DescriptorWriterStats& getStats() const { return stats; }
+
+protected:
+	struct PendingWrite {
+		uint32_t info;
+		bool image;
+	};
+
+	struct TemplatedWrite {
+		VkDescriptorSet set;
+		VkDescriptorUpdateTemplate updateTemplate;
+		uint32_t data;
+	};
+
+	VkDevice device;
+	Console* console;
+
+	// the write's info pointers are only filled in by flush, the info vectors may still move until then
+	std::vector<VkWriteDescriptorSet> writes;
+	std::vector<PendingWrite> pendingWrites;
+	std::vector<VkDescriptorImageInfo> imageInfos;
+	std::vector<VkDescriptorBufferInfo> bufferInfos;
+
+	std::vector<TemplatedWrite> templatedWrites;
+	std::vector<DescriptorData> templateData;
+	std::vector<VkDescriptorUpdateTemplate> templates;
+
+	DescriptorWriterStats stats;
+};
@@ -0,0 +1,44 @@
+#include "dynamicresolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::init(uint32_t measurementLatency) {
+	this->measurementLatency = measurementLatency;
+	framesSinceChange = measurementLatency;
+	scale = settings.maxScale;
+}
+
+float DynamicResolution::update(float gpuFrameTime) {
+	const float minScale = std::min(settings.minScale, settings.maxScale);
+	const float maxScale = settings.maxScale;
+
+	if (!settings.enabled) {
+		scale = maxScale;
+		return scale;
+	}
+
+	// the limits might have been moved from the debug window
+	scale = std::clamp(scale, minScale, maxScale);
+
+	if (gpuFrameTime <= 0.f || ++framesSinceChange <= measurementLatency) {
+		return scale;
+	}
+
+	const float upper = settings.targetFrameTime * (1.f + settings.hysteresis);
+	const float lower = settings.targetFrameTime * (1.f - settings.hysteresis);
+	if (gpuFrameTime <= upper && gpuFrameTime >= lower) {
+		return scale;
+	}
+
+	float newScale = scale * std::sqrt(settings.targetFrameTime / gpuFrameTime);
+	newScale = std::min(newScale, scale + settings.maxIncrease);
+	newScale = std::clamp(newScale, minScale, maxScale);
+
+	if (newScale != scale) {
+		scale = newScale;
+		framesSinceChange = 0;
+	}
+
+	return scale;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+struct DynamicResolutionSettings {
+	bool enabled{ true };
+	float targetFrameTime{ 16.6f };
+	float minScale{ 0.5f };
+	float maxScale{ 1.f };
+	// how far either side of the target the GPU time can drift before the scale moves, as a fraction of the target
+	float hysteresis{ 0.1f };
+	// the largest step up per adjustment, dropping is never limited so a spike gets handled straight away
+	float maxIncrease{ 0.05f };
+};
+
+// Picks the render scale from measured GPU frame times so the frame stays inside its budget.
+// The cost of a frame mostly follows its pixel count, so the scale moves with the square root of the time ratio
+class DynamicResolution {
+public:
+	// Timestamps come back a few frames late, so after every change the controller waits that long before trusting a measurement again
+	void init(uint32_t measurementLatency);
+
+	// Feeds in the newest GPU frame time and returns the scale for the next frame
+	float update(float gpuFrameTime);
+	float getScale() const { return scale; }
+
+	DynamicResolutionSettings settings;
+
+protected:
+	uint32_t measurementLatency{ 0 };
+	uint32_t framesSinceChange{ 0 };
+	float scale{ 1.f };
+};
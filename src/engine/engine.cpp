@@ -7,14 +7,21 @@
 
 #include "camera.h"
 #include "scene.h"
+#include "allocationtracker.h"
 
 void Engine::init(std::vector<std::shared_ptr<Scene>>& scenes) {
 	console.init();
 	window.init();
-	renderer.init(window, &frameNumber, console);
+	jobSystem.init();
+	renderer.init(window, &frameNumber, console, jobSystem);
 	camera = &renderer.camera;
 	inputHandler.init(window);
 
+	//the limiter targets the display's refresh rate until told otherwise
+	SDL_DisplayMode displayMode;
+	const bool hasDisplayMode = SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window.SDL_window), &displayMode) == 0;
+	framePacer.init(hasDisplayMode ? (float)displayMode.refresh_rate : 0.f);
+
 	window.showCursor(!relativeMode);
 
 	this->scenes = &scenes;
@@ -31,6 +38,11 @@ void Engine::run() {
 	bool quit = false;
 
 	while (!quit) {
+		// in just in time mode this holds off until the last moment, so the input polled below is as fresh as it can be
+		framePacer.beginFrame();
+		allocationtracker::beginFrame();
+		renderer.beginFrame();
+
 		while (SDL_PollEvent(&event) != 0)
 		{
 			if (event.type == SDL_QUIT) {
@@ -59,6 +71,7 @@ void Engine::run() {
 		if (!(SDL_GetWindowFlags(window.SDL_window) & SDL_WINDOW_MINIMIZED)) {
 			draw();
 		}
+		framePacer.endFrame();
 
 		inputHandler.update();
 		++frameNumber;
@@ -96,14 +109,66 @@ void Engine::draw() {
 	}
 	ImGui::Render();
 	
-
-	renderer.draw();
+	{
+		// steady state frames shouldn't touch the heap while recording, the count shows up in the statistics window
+		NoAllocScope noAlloc;
+		renderer.draw();
+	}
 }
 
 void Engine::drawDebug() {
 	ImGui::Begin("Statistics");
 	ImGui::Text("FPS: %d", fps);
 	ImGui::Text("Frame Time: %.4fms", frameTime);
+	const AllocationFrameStats& allocationStats = allocationtracker::getLastFrame();
+	ImGui::Text("Heap Allocations: %u (%zuKB, %u frees)", allocationStats.allocations, allocationStats.bytes / 1024, allocationStats.frees);
+	ImGui::Text("Vulkan Host Allocations: %u (%zuKB, %u frees)", allocationStats.vulkanAllocations, allocationStats.vulkanBytes / 1024, allocationStats.vulkanFrees);
+	ImGui::Text("Device Memory Allocations: %u (%lluKB, %u frees)", allocationStats.deviceAllocations, (unsigned long long)(allocationStats.deviceBytes / 1024), allocationStats.deviceFrees);
+	ImGui::Text("Allocations While Drawing: %u", allocationStats.noAllocViolations);
+	ImGui::Checkbox("Assert On Allocation While Drawing", &allocationtracker::getSettings().assertInNoAllocScope);
+#ifdef ALLOCATION_CALL_SITES
+	if (ImGui::TreeNode("Allocation Call Sites")) {
+		char description[512];
+		for (uint32_t i = 0; i < allocationStats.callSiteCount; ++i) {
+			const AllocationCallSite& site = allocationStats.callSites[i];
+			allocationtracker::describeAddress(site.frames[0], description, sizeof(description));
+			if (ImGui::TreeNode((void*)(intptr_t)i, "%u samples, %zuB: %s", site.samples, site.bytes, description)) {
+				for (uint32_t frame = 1; frame < site.depth; ++frame) {
+					allocationtracker::describeAddress(site.frames[frame], description, sizeof(description));
+					ImGui::Text("%s", description);
+				}
+				ImGui::TreePop();
+			}
+		}
+		ImGui::TreePop();
+	}
+#endif // ALLOCATION_CALL_SITES
+	ImGui::Separator();
+
+	const VkPresentModeKHR presentModes[] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+	if (ImGui::BeginCombo("Present Mode", Renderer::presentModeName(renderer.getRequestedPresentMode()))) {
+		for (VkPresentModeKHR mode : presentModes) {
+			if (ImGui::Selectable(Renderer::presentModeName(mode), mode == renderer.getRequestedPresentMode())) {
+				renderer.setPresentMode(mode);
+			}
+		}
+		ImGui::EndCombo();
+	}
+	ImGui::Text("Active Present Mode: %s", Renderer::presentModeName(renderer.getPresentMode()));
+
+	FramePacerSettings& pacerSettings = framePacer.settings;
+	const char* limiterModes[] = { "Off", "Cap", "Just In Time" };
+	int limiterMode = (int)pacerSettings.mode;
+	if (ImGui::Combo("Frame Limiter", &limiterMode, limiterModes, (int)std::size(limiterModes))) {
+		pacerSettings.mode = (FrameLimiterMode)limiterMode;
+	}
+	ImGui::SliderFloat("Target FPS", &pacerSettings.targetFrameRate, 10.f, 360.f, "%.0f");
+	ImGui::SliderFloat("Safety Margin (ms)", &pacerSettings.safetyMargin, 0.f, 5.f, "%.2f");
+	const FramePacerStats& pacerStats = framePacer.getStats();
+	ImGui::Text("Limiter Wait: %.3fms (%.3fms spinning)", pacerStats.waitTime, pacerStats.spinTime);
+	ImGui::Text("Spin Threshold: %.3fms", pacerStats.spinThreshold);
+	ImGui::Text("Predicted Work: %.3fms", pacerStats.predictedWork);
+	ImGui::Text("Missed Deadlines: %u", pacerStats.missedDeadlines);
 	ImGui::End();
 
 	console.draw();
@@ -111,5 +176,6 @@ void Engine::drawDebug() {
 
 void Engine::cleanup() {
 	renderer.cleanup();
+	jobSystem.cleanup();
 	console.cleanup();
 }
\ No newline at end of file
@@ -11,6 +11,8 @@ class Scene;
 #include "console.h"
 #include "inputhandler.h"
 #include "model.h"
+#include "jobsystem.h"
+#include "framepacer.h"
 
 class Engine {
 public:
@@ -27,6 +29,8 @@ protected:
 	Camera* camera;
 	InputHandler inputHandler;
 	Console console;
+	JobSystem jobSystem;
+	FramePacer framePacer;
 	std::vector<std::shared_ptr<Scene>>* scenes;
 
 	bool isInitialised{ false };
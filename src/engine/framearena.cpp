@@ -0,0 +1,53 @@
+#include "framearena.h"
+
+#include <algorithm>
+#include <new>
+
+void LinearArena::init(size_t capacity) {
+	cleanup();
+	block = static_cast<uint8_t*>(::operator new(capacity));
+	this->capacity = capacity;
+}
+
+void LinearArena::cleanup() {
+	reset();
+	::operator delete(block);
+	block = nullptr;
+	capacity = 0;
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment) {
+	const uintptr_t start = ((uintptr_t)block + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	const size_t end = (size_t)(start - (uintptr_t)block) + size;
+	if (block && end <= capacity) {
+		offset = end;
+		return (void*)start;
+	}
+
+	// padded so the allocation can be aligned inside it
+	uint8_t* overflow = static_cast<uint8_t*>(::operator new(size + alignment));
+	overflows.push_back(overflow);
+	overflowBytes += size + alignment;
+	return (void*)(((uintptr_t)overflow + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+void LinearArena::reset() {
+	peak = std::max(peak, offset + overflowBytes);
+	offset = 0;
+
+	if (overflows.empty()) {
+		return;
+	}
+
+	for (uint8_t* overflow : overflows) {
+		::operator delete(overflow);
+	}
+	overflows.clear();
+	overflowBytes = 0;
+
+	// some headroom on top, so a frame that keeps growing a little doesn't reallocate every time
+	::operator delete(block);
+	capacity = peak + peak / 2;
+	block = static_cast<uint8_t*>(::operator new(capacity));
+	++growCount;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// A bump allocator for data that only lives for a frame. Nothing is freed on its own, reset drops everything at once.
+// Allocations that don't fit are served from the heap for the rest of the frame, and the next reset grows the block
+// to cover them, so once a workload has been seen its frames never touch the heap again
+class LinearArena {
+public:
+	void init(size_t capacity);
+	void cleanup();
+
+	void* allocate(size_t size, size_t alignment);
+	void reset();
+
+	size_t getUsed() const { return offset + overflowBytes; }
+	size_t getCapacity() const { return capacity; }
+	// the most a single frame has needed so far
+	size_t getPeak() const { return peak; }
+	uint32_t getGrowCount() const { return growCount; }
+
+protected:
+	uint8_t* block{ nullptr };
+	size_t capacity{ 0 };
+	size_t offset{ 0 };
+
+	std::vector<uint8_t*> overflows;
+	size_t overflowBytes{ 0 };
+	size_t peak{ 0 };
+	uint32_t growCount{ 0 };
+};
+
+// Lets standard containers allocate from a LinearArena. Freeing is a no-op, the memory comes back when the arena is reset,
+// so a container has to be emptied or rebound to a new arena before then
+template<typename T>
+class ArenaAllocator {
+public:
+	using value_type = T;
+	// assigning a container bound to another arena moves it over to that arena, rather than copying into the old one
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	ArenaAllocator() = default;
+	ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+	LinearArena* arena{ nullptr };
+};
+
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,117 @@
+#include "framedeletionqueue.h"
+
+#include <utility>
+
+void FrameDeletionQueue::init(VkDevice device, VmaAllocator allocator) {
+	this->device = device;
+	this->allocator = allocator;
+}
+
+void FrameDeletionQueue::push(uint64_t timelineValue, const AllocatedBuffer& buffer) {
+	push(timelineValue, VK_OBJECT_TYPE_BUFFER, (uint64_t)buffer.buffer, buffer.allocation);
+}
+
+void FrameDeletionQueue::push(uint64_t timelineValue, const AllocatedImage& image) {
+	push(timelineValue, VK_OBJECT_TYPE_IMAGE, (uint64_t)image.image, image.allocation);
+}
+
+void FrameDeletionQueue::push(uint64_t timelineValue, VkImageView imageView) {
+	push(timelineValue, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)imageView, VK_NULL_HANDLE);
+}
+
+void FrameDeletionQueue::push(uint64_t timelineValue, VkSampler sampler) {
+	push(timelineValue, VK_OBJECT_TYPE_SAMPLER, (uint64_t)sampler, VK_NULL_HANDLE);
+}
+
+void FrameDeletionQueue::push(uint64_t timelineValue, VkFramebuffer framebuffer) {
+	push(timelineValue, VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)framebuffer, VK_NULL_HANDLE);
+}
+
+void FrameDeletionQueue::push(uint64_t timelineValue, VkDescriptorPool descriptorPool) {
+	push(timelineValue, VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t)descriptorPool, VK_NULL_HANDLE);
+}
+
+void FrameDeletionQueue::push(uint64_t timelineValue, VkSwapchainKHR swapchain) {
+	push(timelineValue, VK_OBJECT_TYPE_SWAPCHAIN_KHR, (uint64_t)swapchain, VK_NULL_HANDLE);
+}
+
+void FrameDeletionQueue::push(uint64_t timelineValue, VmaAllocation allocation) {
+	push(timelineValue, VK_OBJECT_TYPE_DEVICE_MEMORY, (uint64_t)allocation, allocation);
+}
+
+void FrameDeletionQueue::push(uint64_t timelineValue, VkObjectType type, uint64_t handle, VmaAllocation allocation) {
+	if (handle == 0) {
+		return;
+	}
+
+	if (buckets.empty() || buckets.back().timelineValue < timelineValue) {
+		Bucket bucket;
+		bucket.timelineValue = timelineValue;
+		if (!spareDeletions.empty()) {
+			bucket.deletions = std::move(spareDeletions.back());
+			spareDeletions.pop_back();
+		}
+		buckets.push_back(std::move(bucket));
+	}
+
+	// a value older than the newest bucket has retired no later than it, so waiting for the newest one is still safe
+	buckets.back().deletions.push_back({ type, handle, allocation });
+	++stats.pending;
+}
+
+void FrameDeletionQueue::collect(uint64_t completedValue) {
+	while (!buckets.empty() && buckets.front().timelineValue <= completedValue) {
+		retireFront();
+	}
+}
+
+void FrameDeletionQueue::flush() {
+	while (!buckets.empty()) {
+		retireFront();
+	}
+}
+
+void FrameDeletionQueue::retireFront() {
+	Bucket& bucket = buckets.front();
+	for (const Deletion& deletion : bucket.deletions) {
+		destroy(deletion);
+	}
+
+	stats.pending -= (uint32_t)bucket.deletions.size();
+	stats.destroyed += (uint32_t)bucket.deletions.size();
+
+	bucket.deletions.clear();
+	spareDeletions.push_back(std::move(bucket.deletions));
+	buckets.pop_front();
+}
+
+void FrameDeletionQueue::destroy(const Deletion& deletion) {
+	switch (deletion.type) {
+	case VK_OBJECT_TYPE_BUFFER:
+		vmaDestroyBuffer(allocator, (VkBuffer)deletion.handle, deletion.allocation);
+		break;
+	case VK_OBJECT_TYPE_IMAGE:
+		vmaDestroyImage(allocator, (VkImage)deletion.handle, deletion.allocation);
+		break;
+	case VK_OBJECT_TYPE_IMAGE_VIEW:
+		vkDestroyImageView(device, (VkImageView)deletion.handle, nullptr);
+		break;
+	case VK_OBJECT_TYPE_SAMPLER:
+		vkDestroySampler(device, (VkSampler)deletion.handle, nullptr);
+		break;
+	case VK_OBJECT_TYPE_FRAMEBUFFER:
+		vkDestroyFramebuffer(device, (VkFramebuffer)deletion.handle, nullptr);
+		break;
+	case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+		vkDestroyDescriptorPool(device, (VkDescriptorPool)deletion.handle, nullptr);
+		break;
+	case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+		vkDestroySwapchainKHR(device, (VkSwapchainKHR)deletion.handle, nullptr);
+		break;
+	case VK_OBJECT_TYPE_DEVICE_MEMORY:
+		vmaFreeMemory(allocator, deletion.allocation);
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <utils/types.h>
+
+#include <deque>
+#include <vector>
+
+struct FrameDeletionStats {
+	uint32_t pending{ 0 };
+	uint32_t destroyed{ 0 };
+};
+
+// Destroys resources once the GPU is done with them, for anything that may still be referenced by submitted frames.
+// Every resource is a plain record of its type, handle and allocation, bucketed by the frame timeline value it retires at,
+// so pushing one never allocates once the buckets have grown to fit.
+// Within a bucket resources are destroyed in the order they were pushed, so push views before their images
+class FrameDeletionQueue {
+public:
+	void init(VkDevice device, VmaAllocator allocator);
+
+	void push(uint64_t timelineValue, const AllocatedBuffer& buffer);
+	void push(uint64_t timelineValue, const AllocatedImage& image);
+	void push(uint64_t timelineValue, VkImageView imageView);
+	void push(uint64_t timelineValue, VkSampler sampler);
+	void push(uint64_t timelineValue, VkFramebuffer framebuffer);
+	void push(uint64_t timelineValue, VkDescriptorPool descriptorPool);
+	void push(uint64_t timelineValue, VkSwapchainKHR swapchain);
+	// Memory allocated on its own and bound to resources by hand, push the resources first
+	void push(uint64_t timelineValue, VmaAllocation allocation);
+
+	// Destroys everything retiring at or before the completed value
+	void collect(uint64_t completedValue);
+	// Destroys everything, the GPU has to be idle
+	void flush();
+
+	const FrameDeletionStats& getStats() const { return stats; }
+
+protected:
+	struct Deletion {
+		VkObjectType type;
+		uint64_t handle;
+		VmaAllocation allocation;
+	};
+
+	struct Bucket {
+		uint64_t timelineValue;
+		std::vector<Deletion> deletions;
+	};
+
+	void push(uint64_t timelineValue, VkObjectType type, uint64_t handle, VmaAllocation allocation);
+	void destroy(const Deletion& deletion);
+	void retireFront();
+
+	VkDevice device;
+	VmaAllocator allocator;
+
+	// timeline values only grow, so the buckets are in retire order and new resources always go to the back
+	std::deque<Bucket> buckets;
+	// emptied bucket vectors keep their capacity for the next frame's bucket
+	std::vector<std::vector<Deletion>> spareDeletions;
+
+	FrameDeletionStats stats;
+};
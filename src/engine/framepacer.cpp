@@ -0,0 +1,105 @@
+#include "framepacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// how many sleeps the overshoot estimate averages over, it keeps following the system's timer after that
+constexpr uint32_t MAX_SLEEP_SAMPLES = 500;
+
+void FramePacer::init(float refreshRate) {
+	if (refreshRate > 0.f) {
+		settings.targetFrameRate = refreshRate;
+	}
+
+	deadlineValid = false;
+}
+
+void FramePacer::beginFrame() {
+	const Clock::time_point now = Clock::now();
+	stats.waitTime = 0.f;
+	stats.spinTime = 0.f;
+
+	if (settings.mode == LIMITER_OFF || settings.targetFrameRate <= 0.f) {
+		deadlineValid = false;
+		frameStart = now;
+		return;
+	}
+
+	if (!deadlineValid) {
+		deadline = now + period();
+		deadlineValid = true;
+	}
+
+	// capped frames start when the previous deadline passes, just in time frames wait until only their predicted work is left
+	Clock::time_point wake = deadline - period();
+	if (settings.mode == LIMITER_JUST_IN_TIME) {
+		const auto lead = std::chrono::duration<float, std::milli>(stats.predictedWork + settings.safetyMargin);
+		wake = std::max(wake, deadline - std::chrono::duration_cast<Clock::duration>(lead));
+	}
+
+	waitUntil(wake);
+
+	frameStart = Clock::now();
+	stats.waitTime = std::chrono::duration<float, std::milli>(frameStart - now).count();
+}
+
+void FramePacer::endFrame() {
+	const Clock::time_point now = Clock::now();
+
+	// rises straight away so a heavier frame gets planned for, and falls slowly so one light frame doesn't leave the next cutting it close
+	const float work = std::chrono::duration<float, std::milli>(now - frameStart).count();
+	if (work > stats.predictedWork) {
+		stats.predictedWork = work;
+	} else {
+		stats.predictedWork += (work - stats.predictedWork) * 0.05f;
+	}
+
+	if (!deadlineValid) {
+		return;
+	}
+
+	if (now > deadline) {
+		// start the schedule over from here, rushing the next frames to catch up would only miss more of them
+		++stats.missedDeadlines;
+		deadline = now + period();
+	} else {
+		deadline += period();
+	}
+}
+
+FramePacer::Clock::duration FramePacer::period() const {
+	return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / settings.targetFrameRate));
+}
+
+void FramePacer::waitUntil(Clock::time_point time) {
+	// assume the worst until there are enough samples to go on
+	auto expectedSleep = [&]() {
+		if (sleepSamples < 2) {
+			return 2.0;
+		}
+		return sleepMean + 2.0 * std::sqrt(sleepM2 / (sleepSamples - 1));
+	};
+
+	while (std::chrono::duration<double, std::milli>(time - Clock::now()).count() > expectedSleep()) {
+		const Clock::time_point sleepStart = Clock::now();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		const double slept = std::chrono::duration<double, std::milli>(Clock::now() - sleepStart).count();
+
+		// Welford's running variance, with the count capped so old samples keep fading out
+		sleepSamples = std::min(sleepSamples + 1, MAX_SLEEP_SAMPLES);
+		const double delta = slept - sleepMean;
+		sleepMean += delta / sleepSamples;
+		sleepM2 += delta * (slept - sleepMean);
+		if (sleepSamples == MAX_SLEEP_SAMPLES) {
+			sleepM2 *= (double)(MAX_SLEEP_SAMPLES - 1) / MAX_SLEEP_SAMPLES;
+		}
+	}
+	stats.spinThreshold = (float)expectedSleep();
+
+	const Clock::time_point spinStart = Clock::now();
+	while (Clock::now() < time) {
+		std::this_thread::yield();
+	}
+	stats.spinTime = std::chrono::duration<float, std::milli>(Clock::now() - spinStart).count();
+}
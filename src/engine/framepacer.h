@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+enum FrameLimiterMode
+{
+	LIMITER_OFF,
+	LIMITER_CAP,
+	LIMITER_JUST_IN_TIME
+};
+
+struct FramePacerSettings {
+	FrameLimiterMode mode{ LIMITER_OFF };
+	float targetFrameRate{ 60.f };
+	// just in time frames start this much earlier than their predicted work needs, in ms, so a slightly slower frame still makes it
+	float safetyMargin{ 1.f };
+};
+
+struct FramePacerStats {
+	// how long the last frame was held back, and how much of that was spent spinning rather than sleeping
+	float waitTime{ 0.f };
+	float spinTime{ 0.f };
+	// sleeping stops once less than this is left, how long a 1ms sleep really takes with some room for the slow ones
+	float spinThreshold{ 0.f };
+	// the CPU time a frame is expected to take, just in time frames start this far ahead of their deadline
+	float predictedWork{ 0.f };
+	uint32_t missedDeadlines{ 0 };
+};
+
+// Holds the main loop to a target frame rate. Sleeps are cheap but can wake up late by more than a frame can spare,
+// so it sleeps in short steps while the deadline is far off and spins the rest.
+// Just in time mode starts each frame as late as it can and still finish by its deadline, so input is sampled as close to display as possible
+class FramePacer {
+public:
+	// A refresh rate above zero becomes the target frame rate
+	void init(float refreshRate);
+
+	// Blocks until the next frame should start, call before input is polled
+	void beginFrame();
+	// Call once the frame has been submitted
+	void endFrame();
+
+	const FramePacerStats& getStats() const { return stats; }
+
+	FramePacerSettings settings;
+
+protected:
+	using Clock = std::chrono::high_resolution_clock;
+
+	Clock::duration period() const;
+	void waitUntil(Clock::time_point time);
+
+	Clock::time_point deadline;
+	Clock::time_point frameStart;
+	bool deadlineValid{ false };
+
+	// running mean and variance of how long a 1ms sleep really takes, in ms
+	double sleepMean{ 0.0 };
+	double sleepM2{ 0.0 };
+	uint32_t sleepSamples{ 0 };
+
+	FramePacerStats stats;
+};
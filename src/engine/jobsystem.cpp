@@ -0,0 +1,95 @@
+#include "jobsystem.h"
+
+#include <algorithm>
+
+void JobSystem::init(uint32_t threadCount) {
+	if (threadCount == 0) {
+		threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	}
+
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		workers.emplace_back([this]() { workerLoop(); });
+	}
+}
+
+void JobSystem::cleanup() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+
+	wakeCondition.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	workers.clear();
+}
+
+void JobSystem::parallelFor(uint32_t count, const std::function<void(uint32_t)>& job) {
+	if (count == 0) {
+		return;
+	}
+
+	if (workers.empty() || count == 1) {
+		for (uint32_t i = 0; i < count; ++i) {
+			job(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		currentJob = &job;
+		jobCount = count;
+		nextIndex = 0;
+		++jobGeneration;
+	}
+
+	wakeCondition.notify_all();
+	runJobs(job, count);
+
+	// wait for the workers to let go of the job too, so none of them can pick up indices of the next one with this job
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCondition.wait(lock, [&]() { return activeWorkers == 0; });
+	currentJob = nullptr;
+}
+
+void JobSystem::workerLoop() {
+	uint64_t lastGeneration = 0;
+
+	while (true) {
+		const std::function<void(uint32_t)>* job;
+		uint32_t count;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeCondition.wait(lock, [&]() { return quit || (currentJob && jobGeneration != lastGeneration); });
+
+			if (quit) {
+				return;
+			}
+
+			lastGeneration = jobGeneration;
+			job = currentJob;
+			count = jobCount;
+			++activeWorkers;
+		}
+
+		runJobs(*job, count);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--activeWorkers;
+		}
+
+		doneCondition.notify_one();
+	}
+}
+
+void JobSystem::runJobs(const std::function<void(uint32_t)>& job, uint32_t count) {
+	uint32_t index;
+	while ((index = nextIndex.fetch_add(1)) < count) {
+		job(index);
+	}
+}
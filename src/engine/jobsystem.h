@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for splitting per-frame work into parallel chunks.
+class JobSystem {
+public:
+	// A thread count of 0 uses one worker per hardware thread, minus the calling thread
+	void init(uint32_t threadCount = 0);
+	void cleanup();
+
+	// Calls job(index) for every index in [0, count), spread over the workers and the calling thread.
+	// Blocks until every index has been processed
+	void parallelFor(uint32_t count, const std::function<void(uint32_t)>& job);
+
+	// Workers plus the calling thread
+	uint32_t getThreadCount() const { return (uint32_t)workers.size() + 1; }
+
+protected:
+	void workerLoop();
+	void runJobs(const std::function<void(uint32_t)>& job, uint32_t count);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+
+	const std::function<void(uint32_t)>* currentJob{ nullptr };
+	uint32_t jobCount{ 0 };
+	uint64_t jobGeneration{ 0 };
+	uint32_t activeWorkers{ 0 };
+	std::atomic<uint32_t> nextIndex{ 0 };
+	bool quit{ false };
+};
@@ -0,0 +1,88 @@
+#include "lightmanager.h"
+
+#include <algorithm>
+#include <cmath>
+
+void LightManager::init(uint32_t capacity) {
+	this->capacity = capacity;
+	packed.reserve(capacity);
+	packedIds.reserve(capacity);
+}
+
+uint32_t LightManager::add(const Light& light) {
+	if (packed.size() >= capacity) {
+		return UINT32_MAX;
+	}
+
+	uint32_t id;
+	if (!freeIds.empty()) {
+		id = freeIds.back();
+		freeIds.pop_back();
+	} else {
+		id = (uint32_t)lights.size();
+		lights.emplace_back();
+		packedIndices.push_back(UINT32_MAX);
+	}
+
+	lights[id] = light;
+	packedIndices[id] = (uint32_t)packed.size();
+	packed.push_back(pack(light));
+	packedIds.push_back(id);
+
+	++version;
+	return id;
+}
+
+void LightManager::set(uint32_t id, const Light& light) {
+	if (id >= lights.size() || packedIndices[id] == UINT32_MAX) {
+		return;
+	}
+
+	lights[id] = light;
+	packed[packedIndices[id]] = pack(light);
+	++version;
+}
+
+void LightManager::remove(uint32_t id) {
+	if (id >= lights.size() || packedIndices[id] == UINT32_MAX) {
+		return;
+	}
+
+	// fill the hole with the last packed light so the GPU never has to skip over dead ones
+	const uint32_t index = packedIndices[id];
+	const uint32_t lastId = packedIds.back();
+	packed[index] = packed.back();
+	packedIds[index] = lastId;
+	packedIndices[lastId] = index;
+
+	packed.pop_back();
+	packedIds.pop_back();
+	packedIndices[id] = UINT32_MAX;
+	freeIds.push_back(id);
+	++version;
+}
+
+const Light* LightManager::get(uint32_t id) const {
+	if (id >= lights.size() || packedIndices[id] == UINT32_MAX) {
+		return nullptr;
+	}
+
+	return &lights[id];
+}
+
+GPULight LightManager::pack(const Light& light) const {
+	GPULight gpuLight;
+	gpuLight.position = glm::vec4(light.position, light.range);
+	gpuLight.color = glm::vec4(light.color, light.intensity);
+	gpuLight.direction = glm::vec4(glm::normalize(light.direction), 0.f);
+
+	if (light.type == LIGHT_SPOT) {
+		const float cosInner = std::cos(glm::radians(light.innerAngle));
+		const float cosOuter = std::cos(glm::radians(light.outerAngle));
+		gpuLight.spot = glm::vec4(cosOuter, 1.f / std::max(cosInner - cosOuter, 0.0001f), 1.f, 0.f);
+	} else {
+		gpuLight.spot = glm::vec4(0.f);
+	}
+
+	return gpuLight;
+}
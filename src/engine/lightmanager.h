@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+enum LightType
+{
+	LIGHT_POINT,
+	LIGHT_SPOT
+};
+
+struct Light {
+	LightType type{ LIGHT_POINT };
+	glm::vec3 position{ 0.f };
+	// spot lights only, the direction the cone points in
+	glm::vec3 direction{ 0.f, -1.f, 0.f };
+	glm::vec3 color{ 1.f };
+	float intensity{ 1.f };
+	// the light falls off to nothing at this distance, which is also what it gets binned by
+	float range{ 10.f };
+	// spot cone half angles in degrees, the light fades out between the two
+	float innerAngle{ 20.f };
+	float outerAngle{ 30.f };
+};
+
+// Matches Light in lightcull.comp and default.frag
+struct GPULight {
+	// w is the range
+	glm::vec4 position;
+	// w is the intensity
+	glm::vec4 color;
+	glm::vec4 direction;
+	// x is the cosine of the outer angle, y one over the cosine range of the fade, z is 1 for spot lights
+	glm::vec4 spot;
+};
+
+// Keeps the scene's lights packed tightly for the GPU. Each light keeps its id for its whole lifetime,
+// removing one moves the last packed light into its place
+class LightManager {
+public:
+	void init(uint32_t capacity);
+
+	// Returns UINT32_MAX once the capacity is reached
+	uint32_t add(const Light& light);
+	void set(uint32_t id, const Light& light);
+	void remove(uint32_t id);
+	const Light* get(uint32_t id) const;
+
+	const std::vector<GPULight>& getPacked() const { return packed; }
+	uint32_t getCount() const { return (uint32_t)packed.size(); }
+	uint32_t getCapacity() const { return capacity; }
+	// Bumped on every change, so each frame's light buffer only gets rewritten when it is out of date
+	uint64_t getVersion() const { return version; }
+
+protected:
+	GPULight pack(const Light& light) const;
+
+	// indexed by id, packedIndices is UINT32_MAX for ids not in use
+	std::vector<Light> lights;
+	std::vector<uint32_t> packedIndices;
+	std::vector<uint32_t> freeIds;
+
+	// packedIds maps each packed light back to its id, for when it has to move
+	std::vector<GPULight> packed;
+	std::vector<uint32_t> packedIds;
+
+	uint32_t capacity{ 0 };
+	uint64_t version{ 0 };
+};
@@ -0,0 +1,113 @@
+#include "materialmanager.h"
+
+void MaterialManager::init(uint32_t capacity) {
+	this->capacity = capacity;
+	materials.reserve(capacity);
+	gpuData.reserve(capacity);
+}
+
+MaterialBindState* MaterialManager::loadBindState(const CreateBindStateInfo& info, const MaterialParameters& baseParameters) {
+	auto existing = bindStates.find(info.name);
+	if (existing != bindStates.end()) {
+		return &existing->second;
+	}
+
+	MaterialBindState& bindState = bindStates[info.name];
+	bindState.pipeline = info.pipeline;
+	bindState.pipelineLayout = info.layout;
+	bindState.depthEqualPipeline = info.depthEqualPipeline;
+	bindState.textureSet = info.textureSet;
+	bindState.baseMaterial = create(&bindState, baseParameters);
+	return &bindState;
+}
+
+MaterialBindState* MaterialManager::findBindState(const std::string& name) {
+	auto existing = bindStates.find(name);
+	return existing != bindStates.end() ? &existing->second : nullptr;
+}
+
+void MaterialManager::removeBindState(const std::string& name) {
+	auto existing = bindStates.find(name);
+	if (existing == bindStates.end()) {
+		return;
+	}
+
+	for (uint32_t id = 0; id < materials.size(); ++id) {
+		if (materials[id].bindState == &existing->second) {
+			materials[id].bindState = nullptr;
+			freeIds.push_back(id);
+			--liveCount;
+		}
+	}
+
+	bindStates.erase(existing);
+}
+
+MaterialId MaterialManager::create(MaterialBindState* bindState, const MaterialParameters& parameters) {
+	if (liveCount >= capacity) {
+		return INVALID_MATERIAL;
+	}
+
+	MaterialId id;
+	if (!freeIds.empty()) {
+		id = freeIds.back();
+		freeIds.pop_back();
+	} else {
+		id = (MaterialId)materials.size();
+		materials.emplace_back();
+		gpuData.emplace_back();
+	}
+
+	materials[id] = { bindState, parameters, 1 };
+	gpuData[id] = pack(parameters);
+
+	++liveCount;
+	++version;
+	return id;
+}
+
+void MaterialManager::setParameters(MaterialId id, const MaterialParameters& parameters) {
+	if (!getBindState(id)) {
+		return;
+	}
+
+	materials[id].parameters = parameters;
+	gpuData[id] = pack(parameters);
+	++version;
+}
+
+void MaterialManager::acquire(MaterialId id) {
+	if (getBindState(id)) {
+		++materials[id].references;
+	}
+}
+
+bool MaterialManager::release(MaterialId id) {
+	MaterialBindState* bindState = getBindState(id);
+	if (!bindState || bindState->baseMaterial == id || --materials[id].references > 0) {
+		return false;
+	}
+
+	materials[id].bindState = nullptr;
+	freeIds.push_back(id);
+	--liveCount;
+	return true;
+}
+
+MaterialBindState* MaterialManager::getBindState(MaterialId id) const {
+	return id < materials.size() ? materials[id].bindState : nullptr;
+}
+
+const MaterialParameters* MaterialManager::getParameters(MaterialId id) const {
+	return getBindState(id) ? &materials[id].parameters : nullptr;
+}
+
+GPUMaterialData MaterialManager::pack(const MaterialParameters& parameters) const {
+	GPUMaterialData data;
+	data.color = parameters.color;
+	data.emissive = glm::vec4(parameters.emissive, parameters.emissiveStrength);
+	data.scalars = glm::vec4(parameters.ambientOcclusion, 0.f, 0.f, 0.f);
+	// every bind state has a single texture for now, so textured materials always sample the first one
+	data.textures = glm::uvec4(parameters.textured ? 0 : MATERIAL_NO_TEXTURE, 0, 0, 0);
+	return data;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <utils/types.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// textures.x of a material that doesn't sample its bind state's texture set, must match default.frag
+constexpr uint32_t MATERIAL_NO_TEXTURE = UINT32_MAX;
+
+struct CreateBindStateInfo {
+	std::string name;
+	VkPipeline pipeline;
+	VkPipelineLayout layout;
+	VkPipeline depthEqualPipeline;
+	VkDescriptorSet textureSet;
+};
+
+// What can change between materials without them needing pipelines or sets of their own
+struct MaterialParameters {
+	// multiplies the texture, or stands in for it when there isn't one
+	glm::vec4 color{ 1.f };
+	glm::vec3 emissive{ 0.f };
+	float emissiveStrength{ 0.f };
+	// scales the ambient light the surface receives
+	float ambientOcclusion{ 1.f };
+	// samples the bind state's texture, has to be off for bind states without a texture set
+	bool textured{ true };
+};
+
+// Matches Material in default.frag
+struct GPUMaterialData {
+	glm::vec4 color;
+	// w is the strength
+	glm::vec4 emissive;
+	// x is the ambient occlusion, yzw unused
+	glm::vec4 scalars;
+	// x indexes the texture in the bind state's set, MATERIAL_NO_TEXTURE for untextured materials
+	glm::uvec4 textures;
+};
+
+// Keeps every material's parameters in one array indexed by its id, which is what the object buffer refers to.
+// Bind states are shared by name, each comes with a base material and can have any number of others differing only in parameters
+class MaterialManager {
+public:
+	void init(uint32_t capacity);
+
+	// Returns the bind state already loaded under the name if there is one, the info and parameters are ignored then
+	MaterialBindState* loadBindState(const CreateBindStateInfo& info, const MaterialParameters& baseParameters = {});
+	MaterialBindState* findBindState(const std::string& name);
+	// Releases every material created from the bind state along with it, nothing may still draw with them
+	void removeBindState(const std::string& name);
+
+	// Returns INVALID_MATERIAL once the capacity is reached, the material starts out with one reference
+	MaterialId create(MaterialBindState* bindState, const MaterialParameters& parameters);
+	void setParameters(MaterialId id, const MaterialParameters& parameters);
+	void acquire(MaterialId id);
+	// Returns true when the last reference went and the id was freed. Base materials are only released with their bind state
+	bool release(MaterialId id);
+
+	MaterialBindState* getBindState(MaterialId id) const;
+	const MaterialParameters* getParameters(MaterialId id) const;
+
+	// Indexed by id, released ids keep their old data until they are handed out again
+	const std::vector<GPUMaterialData>& getGPUData() const { return gpuData; }
+	uint32_t getCount() const { return liveCount; }
+	uint32_t getCapacity() const { return capacity; }
+	uint32_t getBindStateCount() const { return (uint32_t)bindStates.size(); }
+	// Bumped on every change, so each frame's material buffer only gets rewritten when it is out of date
+	uint64_t getVersion() const { return version; }
+
+protected:
+	struct Slot {
+		// null for ids not in use
+		MaterialBindState* bindState{ nullptr };
+		MaterialParameters parameters;
+		uint32_t references{ 0 };
+	};
+
+	GPUMaterialData pack(const MaterialParameters& parameters) const;
+
+	// node based, so the pointers materials and render objects hold stay valid as more are loaded
+	std::unordered_map<std::string, MaterialBindState> bindStates;
+
+	std::vector<Slot> materials;
+	std::vector<GPUMaterialData> gpuData;
+	std::vector<uint32_t> freeIds;
+
+	uint32_t liveCount{ 0 };
+	uint32_t capacity{ 0 };
+	uint64_t version{ 0 };
+};
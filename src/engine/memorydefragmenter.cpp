@@ -0,0 +1,100 @@
+#include "memorydefragmenter.h"
+
+#include <string>
+
+#include "console.h"
+
+void MemoryDefragmenter::init(VmaAllocator allocator, Console& console) {
+	this->allocator = allocator;
+	this->console = &console;
+}
+
+void MemoryDefragmenter::start() {
+	if (isActive()) {
+		return;
+	}
+
+	VmaDefragmentationInfo info = {};
+	info.maxBytesPerPass = (VkDeviceSize)settings.maxMegabytesPerPass * 1048576;
+
+	if (vmaBeginDefragmentation(allocator, &info, &context) != VK_SUCCESS) {
+		console->log("[WARN]: Failed to start defragmentation");
+		context = VK_NULL_HANDLE;
+		return;
+	}
+
+	++stats.runs;
+}
+
+void MemoryDefragmenter::stop() {
+	if (!isActive()) {
+		return;
+	}
+
+	if (passPending) {
+		passPending = false;
+		vmaEndDefragmentationPass(allocator, context, &pass);
+	}
+
+	finish();
+}
+
+VmaDefragmentationPassMoveInfo* MemoryDefragmenter::beginPass(uint64_t completedValue) {
+	if (!isActive()) {
+		return nullptr;
+	}
+
+	if (passPending) {
+		if (completedValue < retireValue) {
+			return nullptr;
+		}
+
+		passPending = false;
+		if (vmaEndDefragmentationPass(allocator, context, &pass) == VK_SUCCESS) {
+			finish();
+			return nullptr;
+		}
+	}
+
+	// VK_SUCCESS means there is nothing left worth moving
+	if (vmaBeginDefragmentationPass(allocator, context, &pass) == VK_SUCCESS) {
+		finish();
+		return nullptr;
+	}
+
+	//the pass stays pending from here, its moves are copied by a frame and only retire after endPass
+	passPending = true;
+	retireValue = UINT64_MAX;
+	++stats.passes;
+	return &pass;
+}
+
+void MemoryDefragmenter::endPass(uint64_t retireValue) {
+	for (uint32_t i = 0; i < pass.moveCount; ++i) {
+		const VmaDefragmentationMove& move = pass.pMoves[i];
+		if (move.operation != VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY) {
+			++stats.skippedMoves;
+			continue;
+		}
+
+		VmaAllocationInfo allocationInfo;
+		vmaGetAllocationInfo(allocator, move.srcAllocation, &allocationInfo);
+		stats.bytesMoved += allocationInfo.size;
+		++stats.moves;
+	}
+
+	this->retireValue = retireValue;
+}
+
+void MemoryDefragmenter::finish() {
+	VmaDefragmentationStats result = {};
+	vmaEndDefragmentation(allocator, context, &result);
+	context = VK_NULL_HANDLE;
+	pass = {};
+
+	stats.bytesFreed += result.bytesFreed;
+	console->log(
+		"Defragmentation moved " + std::to_string(result.allocationsMoved) + " allocations and freed " +
+		std::to_string(result.bytesFreed / 1024) + "KB in " + std::to_string(result.deviceMemoryBlocksFreed) + " blocks"
+	);
+}
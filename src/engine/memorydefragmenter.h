@@ -0,0 +1,62 @@
+#pragma once
+
+class Console;
+
+#include <utils/types.h>
+
+struct DefragmentationSettings {
+	// starts a run whenever assets have been evicted, the holes they leave behind are what it cleans up
+	bool automatic{ true };
+	// how long a frame may spend creating and recording moves, in ms
+	float timeBudget{ 0.5f };
+	// caps how much a single pass copies on the GPU
+	uint32_t maxMegabytesPerPass{ 16 };
+};
+
+struct DefragmentationStats {
+	uint32_t runs{ 0 };
+	uint32_t passes{ 0 };
+	uint32_t moves{ 0 };
+	// moves left where they were, because they weren't a mesh or texture or the frame's time budget ran out
+	uint32_t skippedMoves{ 0 };
+	VkDeviceSize bytesMoved{ 0 };
+	VkDeviceSize bytesFreed{ 0 };
+};
+
+// Runs VMA's defragmentation a pass at a time. The caller moves each pass's resources into their new memory, which may take a few frames,
+// and the pass is only ended, which frees the memory they moved out of, once every frame that could still read it has retired
+class MemoryDefragmenter {
+public:
+	void init(VmaAllocator allocator, Console& console);
+
+	// Does nothing if a run is already going
+	void start();
+	// Ends the run straight away, the GPU has to be idle
+	void stop();
+	bool isActive() const { return context != VK_NULL_HANDLE; }
+	// Allocations mustn't be freed while they may be part of a pass, from beginPass until the pass has retired
+	bool isPassPending() const { return passPending; }
+
+	// The moves of the next pass once the last one has retired, or nullptr when there is nothing to do this frame.
+	// Every move has to be carried out or have its operation set to ignore before endPass
+	VmaDefragmentationPassMoveInfo* beginPass(uint64_t completedValue);
+	// Called once the moves have been carried out, the memory moved out of is still read until the frame timeline reaches retireValue
+	void endPass(uint64_t retireValue);
+
+	const DefragmentationStats& getStats() const { return stats; }
+
+	DefragmentationSettings settings;
+
+protected:
+	void finish();
+
+	VmaAllocator allocator;
+	Console* console;
+
+	VmaDefragmentationContext context{ VK_NULL_HANDLE };
+	VmaDefragmentationPassMoveInfo pass{};
+	bool passPending{ false };
+	uint64_t retireValue{ 0 };
+
+	DefragmentationStats stats;
+};
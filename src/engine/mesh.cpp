@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <tiny_obj_loader.h>
+#include <glm/common.hpp>
 
 VertexInputDescription Vertex::getVertexDescription() {
 	VertexInputDescription description;
@@ -50,6 +51,28 @@ VertexInputDescription Vertex::getVertexDescription() {
 	return description;
 }
 
+VertexInputDescription Vertex::getPositionOnlyDescription() {
+	VertexInputDescription description;
+
+	VkVertexInputBindingDescription positionBinding = {};
+	positionBinding.binding = 0;
+	positionBinding.stride = sizeof(glm::vec3);
+	positionBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	description.bindings.push_back(positionBinding);
+
+	//Position will be stored at Location 0, same as the full vertex
+	VkVertexInputAttributeDescription positionAttribute = {};
+	positionAttribute.binding = 0;
+	positionAttribute.location = 0;
+	positionAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+	positionAttribute.offset = 0;
+
+	description.attributes.push_back(positionAttribute);
+
+	return description;
+}
+
 bool Mesh::loadFromOBJ(const char* filename, std::string* warn, std::string* err) {
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
@@ -111,5 +134,19 @@ bool Mesh::loadFromOBJ(const char* filename, std::string* warn, std::string* err
 		}
 	}
 
+	calculateBounds();
 	return true;
 }
+
+void Mesh::calculateBounds() {
+	if (vertices.empty()) {
+		boundsMin = boundsMax = glm::vec3{ 0.f };
+		return;
+	}
+
+	boundsMin = boundsMax = vertices[0].position;
+	for (const Vertex& vertex : vertices) {
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+	}
+}
@@ -19,11 +19,22 @@ struct Vertex {
 	glm::vec2 uv;
 
 	static VertexInputDescription getVertexDescription();
+	// a single tightly packed position stream, used by the depth only passes
+	static VertexInputDescription getPositionOnlyDescription();
 };
 
 struct Mesh {
 	std::vector<Vertex> vertices;
+	// optional, meshes loaded from OBJ files are unindexed
+	std::vector<uint32_t> indices;
 	AllocatedBuffer vertexBuffer;
+	AllocatedBuffer positionBuffer;
+	AllocatedBuffer indexBuffer;
+
+	// object space bounding box
+	glm::vec3 boundsMin{ 0.f };
+	glm::vec3 boundsMax{ 0.f };
 
 	bool loadFromOBJ(const char* filename, std::string* warn, std::string* err);
+	void calculateBounds();
 };
\ No newline at end of file
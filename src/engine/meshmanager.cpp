@@ -6,48 +6,41 @@
 #include "texturemanager.h"
 #include "mesh.h"
 
-void MeshManager::init(Console& console) {
+void MeshManager::init(Console& console, uint32_t meshCapacity) {
 	this->console = &console;
+	meshes.init(meshCapacity);
 }
 
-Material* MeshManager::createMaterial(CreateMaterialInfo info) {
-	Material newMaterial;
-	newMaterial.pipeline = info.pipeline;
-	newMaterial.pipelineLayout = info.layout;
-	newMaterial.textureSet = info.textureSet;
-	materials[info.name] = newMaterial;
-	return &materials[info.name];
-}
+MeshHandle MeshManager::loadMesh(const std::string& name, uint64_t tick) {
+	MeshHandle handle = meshes.find(name);
+	if (handle.isValid()) {
+		return handle;
+	}
 
-Material* MeshManager::loadMaterial(CreateMaterialInfo info) {
-	auto pair = materials.find(info.name);
-	if (pair == materials.end()) {
-		return createMaterial(info);
-	} else {
-		return &(*pair).second;
+	Mesh newMesh;
+	std::string warn, err;
+	const bool result = newMesh.loadFromOBJ(name.c_str(), &warn, &err);
+
+	if (!warn.empty()) {
+		console->log("[WARN]: " + warn);
 	}
-}
 
-Mesh* MeshManager::loadMesh(const std::string& name) {
-	auto pair = meshes.find(name);
-	if (pair == meshes.end()) {
-		Mesh newMesh;
-		std::string warn, err;
-		const bool result = newMesh.loadFromOBJ(name.c_str(), &warn, &err);
-
-		if (!warn.empty()) {
-			console->log("[WARN]: " + warn);
-		}
-
-		if (!result) {
-			console->log("[ERROR]: Failed to load mesh " + name + '\n' + err);
-			return nullptr;
-		}
-
-		console->log("Loaded mesh " + name + " successfully");
-		meshes[name] = newMesh;
-		return &meshes[name];
+	if (!result) {
+		console->log("[ERROR]: Failed to load mesh " + name + '\n' + err);
+		return {};
+	}
+
+	//the gpu copy is the interleaved vertices, the position only stream and the indices
+	AssetMemory memory;
+	memory.cpuBytes = newMesh.vertices.size() * sizeof(Vertex) + newMesh.indices.size() * sizeof(uint32_t);
+	memory.gpuBytes = memory.cpuBytes + newMesh.vertices.size() * sizeof(glm::vec3);
+
+	handle = meshes.add(name, std::move(newMesh), memory, tick);
+	if (!handle.isValid()) {
+		console->log("[ERROR]: Mesh limit of " + std::to_string(meshes.getCapacity()) + " reached, failed to load " + name);
+		return {};
 	}
 
-	return &(*pair).second;
+	console->log("Loaded mesh " + name + " successfully");
+	return handle;
 }
\ No newline at end of file
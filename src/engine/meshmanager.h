@@ -7,25 +7,17 @@ class Console;
 
 #include "mesh.h"
 #include "model.h"
-
-struct CreateMaterialInfo {
-	std::string name;
-	VkPipeline pipeline;
-	VkPipelineLayout layout;
-	VkDescriptorSet textureSet;
-};
+#include "assetpool.h"
 
 class MeshManager {
 public:
-	void init(Console& console);
-	Mesh* loadMesh(const std::string& name);
-	Material* loadMaterial(CreateMaterialInfo info);
+	void init(Console& console, uint32_t meshCapacity);
+	// Loaded meshes stay in the pool after their last reference is released, so loading the same file again is free until it gets evicted
+	MeshHandle loadMesh(const std::string& name, uint64_t tick);
+	Mesh* getMesh(MeshHandle handle) { return meshes.get(handle); }
 
-	std::unordered_map<std::string, Material> materials;
-	std::unordered_map<std::string, Mesh> meshes;
+	AssetPool<Mesh> meshes;
 
 protected:
-	Material* createMaterial(CreateMaterialInfo info);
-
 	Console* console;
 };
\ No newline at end of file
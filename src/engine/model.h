@@ -6,9 +6,14 @@ struct Mesh;
 #include <utils/types.h>
 #include <glm/glm.hpp>
 
+#include "assetpool.h"
+
 struct Model {
 	Mesh* mesh;
-	Material* material;
+	MaterialId material{ INVALID_MATERIAL };
+	// the references the model holds on its assets, given back by Renderer::releaseModel
+	MeshHandle meshHandle;
+	TextureHandle textureHandle;
 	glm::mat4 transformMatrix;
 
 	void addToRenderQueue(Renderer& renderer);
@@ -0,0 +1,346 @@
+#include "occlusionculler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif // __AVX2__
+
+#include "jobsystem.h"
+
+// anything closer than the camera's near plane is skipped rather than clipped, which only ever loses occlusion
+constexpr float NEAR_CLIP_W = 0.1f;
+
+void OcclusionCuller::init(JobSystem& jobSystem) {
+	this->jobSystem = &jobSystem;
+	depthBuffer.resize(WIDTH * HEIGHT, 0.f);
+
+	uint32_t width = WIDTH;
+	uint32_t height = HEIGHT;
+	while (true) {
+		DepthLevel level;
+		level.width = width;
+		level.height = height;
+		level.minDepth.resize(width * height, 0.f);
+		levels.push_back(std::move(level));
+
+		if (width == 1 && height == 1) {
+			break;
+		}
+
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+}
+
+uint32_t OcclusionCuller::addOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4& transform) {
+	uint32_t index;
+	if (!freeOccluders.empty()) {
+		index = freeOccluders.back();
+		freeOccluders.pop_back();
+	} else {
+		index = (uint32_t)occluders.size();
+		occluders.emplace_back();
+	}
+
+	Occluder& occluder = occluders[index];
+	occluder.positions = positions;
+	occluder.indices = indices;
+	occluder.transform = transform;
+	occluder.alive = true;
+
+	++occluderCount;
+	return index;
+}
+
+void OcclusionCuller::setOccluderTransform(uint32_t occluder, const glm::mat4& transform) {
+	if (occluder < occluders.size() && occluders[occluder].alive) {
+		occluders[occluder].transform = transform;
+	}
+}
+
+void OcclusionCuller::removeOccluder(uint32_t occluder) {
+	if (occluder >= occluders.size() || !occluders[occluder].alive) {
+		return;
+	}
+
+	occluders[occluder].alive = false;
+	occluders[occluder].positions.clear();
+	occluders[occluder].indices.clear();
+	freeOccluders.push_back(occluder);
+	--occluderCount;
+}
+
+void OcclusionCuller::render(const glm::mat4& viewProjection) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	this->viewProjection = viewProjection;
+	testedCount = 0;
+	occludedCount = 0;
+
+	setupTriangles();
+
+	// split the buffer into bands of rows, each worker owns its rows outright so no synchronisation is needed while rasterizing
+	const uint32_t bandCount = std::min(jobSystem->getThreadCount() * 2, HEIGHT / 8);
+	const uint32_t rowsPerBand = (HEIGHT + bandCount - 1) / bandCount;
+
+	jobSystem->parallelFor(bandCount, [&](uint32_t band) {
+		const uint32_t rowStart = band * rowsPerBand;
+		rasterizeBand(rowStart, std::min(rowStart + rowsPerBand, HEIGHT));
+	});
+
+	buildHierarchy();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	rasterTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+bool OcclusionCuller::isOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const {
+	testedCount.fetch_add(1, std::memory_order_relaxed);
+
+	const glm::vec3 corners[2] = { boundsMin, boundsMax };
+	float minX = FLT_MAX, minY = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearestDepth = 0.f;
+
+	for (uint32_t i = 0; i < 8; ++i) {
+		glm::vec4 clip = viewProjection * glm::vec4(corners[i & 1].x, corners[(i >> 1) & 1].y, corners[(i >> 2) & 1].z, 1.f);
+
+		// the box reaches past the near plane, treat it as visible
+		if (clip.w < NEAR_CLIP_W) {
+			return false;
+		}
+
+		const float invW = 1.f / clip.w;
+		const float x = (clip.x * invW * 0.5f + 0.5f) * WIDTH;
+		const float y = (clip.y * invW * 0.5f + 0.5f) * HEIGHT;
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearestDepth = std::max(nearestDepth, invW);
+	}
+
+	const int32_t x0 = std::max((int32_t)std::floor(minX), 0);
+	const int32_t x1 = std::min((int32_t)std::floor(maxX), (int32_t)WIDTH - 1);
+	const int32_t y0 = std::max((int32_t)std::floor(minY), 0);
+	const int32_t y1 = std::min((int32_t)std::floor(maxY), (int32_t)HEIGHT - 1);
+
+	if (x0 > x1 || y0 > y1) {
+		return false;
+	}
+
+	// pick the level where the rectangle only covers a handful of texels
+	const uint32_t extent = (uint32_t)std::max(x1 - x0, y1 - y0);
+	uint32_t levelIndex = 0;
+	while ((extent >> levelIndex) > 2 && levelIndex + 1 < levels.size()) {
+		++levelIndex;
+	}
+
+	const DepthLevel& level = levels[levelIndex];
+	for (int32_t y = y0 >> levelIndex; y <= (y1 >> levelIndex); ++y) {
+		for (int32_t x = x0 >> levelIndex; x <= (x1 >> levelIndex); ++x) {
+			// some part of this texel has occluder depth further away than the box, or no occluder at all
+			if (nearestDepth >= level.minDepth[y * level.width + x]) {
+				return false;
+			}
+		}
+	}
+
+	occludedCount.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+OcclusionStats OcclusionCuller::getStats() const {
+	OcclusionStats stats;
+	stats.tested = testedCount.load();
+	stats.occluded = occludedCount.load();
+	stats.occluderTriangles = (uint32_t)triangles.size();
+	stats.rasterTime = rasterTime;
+	return stats;
+}
+
+void OcclusionCuller::setupTriangles() {
+	triangles.clear();
+
+	std::vector<glm::vec4> clipPositions;
+	for (const Occluder& occluder : occluders) {
+		if (!occluder.alive) {
+			continue;
+		}
+
+		const glm::mat4 mvp = viewProjection * occluder.transform;
+		clipPositions.resize(occluder.positions.size());
+		for (size_t i = 0; i < occluder.positions.size(); ++i) {
+			clipPositions[i] = mvp * glm::vec4(occluder.positions[i], 1.f);
+		}
+
+		for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+			float x[3], y[3], z[3];
+			bool behindNearPlane = false;
+
+			for (uint32_t v = 0; v < 3; ++v) {
+				const glm::vec4& clip = clipPositions[occluder.indices[i + v]];
+				if (clip.w < NEAR_CLIP_W) {
+					behindNearPlane = true;
+					break;
+				}
+
+				z[v] = 1.f / clip.w;
+				x[v] = (clip.x * z[v] * 0.5f + 0.5f) * WIDTH;
+				y[v] = (clip.y * z[v] * 0.5f + 0.5f) * HEIGHT;
+			}
+
+			if (behindNearPlane) {
+				continue;
+			}
+
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (std::abs(area) < 1e-6f) {
+				continue;
+			}
+
+			// occluders are rasterized double sided, flip to a consistent winding so the edge functions are positive inside
+			if (area < 0.f) {
+				std::swap(x[1], x[2]);
+				std::swap(y[1], y[2]);
+				std::swap(z[1], z[2]);
+				area = -area;
+			}
+
+			ScreenTriangle triangle;
+			triangle.minX = std::max((int32_t)std::floor(std::min({ x[0], x[1], x[2] })), 0);
+			triangle.maxX = std::min((int32_t)std::ceil(std::max({ x[0], x[1], x[2] })), (int32_t)WIDTH - 1);
+			triangle.minY = std::max((int32_t)std::floor(std::min({ y[0], y[1], y[2] })), 0);
+			triangle.maxY = std::min((int32_t)std::ceil(std::max({ y[0], y[1], y[2] })), (int32_t)HEIGHT - 1);
+
+			if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+				continue;
+			}
+
+			for (uint32_t e = 0; e < 3; ++e) {
+				const uint32_t next = (e + 1) % 3;
+				triangle.edgeA[e] = -(y[next] - y[e]);
+				triangle.edgeB[e] = x[next] - x[e];
+				triangle.edgeC[e] = -triangle.edgeB[e] * y[e] - triangle.edgeA[e] * x[e];
+			}
+
+			triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+			triangle.depthB = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / area;
+			triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+
+			triangles.push_back(triangle);
+		}
+	}
+}
+
+void OcclusionCuller::rasterizeBand(uint32_t rowStart, uint32_t rowEnd) {
+	std::fill(depthBuffer.begin() + rowStart * WIDTH, depthBuffer.begin() + rowEnd * WIDTH, 0.f);
+
+	for (const ScreenTriangle& triangle : triangles) {
+		if (triangle.maxY < (int32_t)rowStart || triangle.minY >= (int32_t)rowEnd) {
+			continue;
+		}
+
+		rasterizeTriangle(triangle, rowStart, rowEnd);
+	}
+}
+
+void OcclusionCuller::rasterizeTriangle(const ScreenTriangle& triangle, int32_t rowStart, int32_t rowEnd) {
+	const int32_t yStart = std::max(triangle.minY, rowStart);
+	const int32_t yEnd = std::min(triangle.maxY, rowEnd - 1);
+
+#ifdef __AVX2__
+	const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 edgeA0 = _mm256_set1_ps(triangle.edgeA[0]);
+	const __m256 edgeA1 = _mm256_set1_ps(triangle.edgeA[1]);
+	const __m256 edgeA2 = _mm256_set1_ps(triangle.edgeA[2]);
+	const __m256 depthA = _mm256_set1_ps(triangle.depthA);
+	// WIDTH is a multiple of 8, so starting on an aligned column never runs off the end of the row
+	const int32_t xStart = triangle.minX & ~7;
+#endif // __AVX2__
+
+	for (int32_t y = yStart; y <= yEnd; ++y) {
+		const float py = y + 0.5f;
+		const float rowEdge0 = triangle.edgeB[0] * py + triangle.edgeC[0];
+		const float rowEdge1 = triangle.edgeB[1] * py + triangle.edgeC[1];
+		const float rowEdge2 = triangle.edgeB[2] * py + triangle.edgeC[2];
+		const float rowDepth = triangle.depthB * py + triangle.depthC;
+		float* row = &depthBuffer[y * WIDTH];
+
+#ifdef __AVX2__
+		const __m256 rowEdge0Wide = _mm256_set1_ps(rowEdge0);
+		const __m256 rowEdge1Wide = _mm256_set1_ps(rowEdge1);
+		const __m256 rowEdge2Wide = _mm256_set1_ps(rowEdge2);
+		const __m256 rowDepthWide = _mm256_set1_ps(rowDepth);
+
+		for (int32_t x = xStart; x <= triangle.maxX; x += 8) {
+			const __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), laneOffsets);
+
+			const __m256 edge0 = _mm256_add_ps(_mm256_mul_ps(edgeA0, px), rowEdge0Wide);
+			const __m256 edge1 = _mm256_add_ps(_mm256_mul_ps(edgeA1, px), rowEdge1Wide);
+			const __m256 edge2 = _mm256_add_ps(_mm256_mul_ps(edgeA2, px), rowEdge2Wide);
+
+			__m256 inside = _mm256_cmp_ps(edge0, zero, _CMP_GT_OQ);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge1, zero, _CMP_GT_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(edge2, zero, _CMP_GT_OQ));
+
+			if (_mm256_movemask_ps(inside) == 0) {
+				continue;
+			}
+
+			const __m256 depth = _mm256_add_ps(_mm256_mul_ps(depthA, px), rowDepthWide);
+			const __m256 current = _mm256_loadu_ps(row + x);
+			const __m256 nearest = _mm256_max_ps(current, depth);
+			_mm256_storeu_ps(row + x, _mm256_blendv_ps(current, nearest, inside));
+		}
+#else
+		for (int32_t x = triangle.minX; x <= triangle.maxX; ++x) {
+			const float px = x + 0.5f;
+			if (triangle.edgeA[0] * px + rowEdge0 <= 0.f ||
+				triangle.edgeA[1] * px + rowEdge1 <= 0.f ||
+				triangle.edgeA[2] * px + rowEdge2 <= 0.f) {
+				continue;
+			}
+
+			row[x] = std::max(row[x], triangle.depthA * px + rowDepth);
+		}
+#endif // __AVX2__
+	}
+}
+
+void OcclusionCuller::buildHierarchy() {
+	std::copy(depthBuffer.begin(), depthBuffer.end(), levels[0].minDepth.begin());
+
+	for (size_t i = 1; i < levels.size(); ++i) {
+		const DepthLevel& source = levels[i - 1];
+		DepthLevel& level = levels[i];
+
+		for (uint32_t y = 0; y < level.height; ++y) {
+			for (uint32_t x = 0; x < level.width; ++x) {
+				// the source may only be a single texel wide or high by now
+				const uint32_t sx0 = std::min(x * 2, source.width - 1);
+				const uint32_t sx1 = std::min(x * 2 + 1, source.width - 1);
+				const uint32_t sy0 = std::min(y * 2, source.height - 1);
+				const uint32_t sy1 = std::min(y * 2 + 1, source.height - 1);
+
+				const uint32_t texels[4] = {
+					sy0 * source.width + sx0, sy0 * source.width + sx1,
+					sy1 * source.width + sx0, sy1 * source.width + sx1,
+				};
+
+				float minDepth = FLT_MAX;
+				for (uint32_t texel : texels) {
+					minDepth = std::min(minDepth, source.minDepth[texel]);
+				}
+
+				level.minDepth[y * level.width + x] = minDepth;
+			}
+		}
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+class JobSystem;
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+struct OcclusionStats {
+	uint32_t tested{ 0 };
+	uint32_t occluded{ 0 };
+	uint32_t occluderTriangles{ 0 };
+	float rasterTime{ 0.f };
+
+	float occludedPercentage() const { return tested > 0 ? 100.f * occluded / tested : 0.f; }
+};
+
+// CPU software occlusion culling. Low-poly occluder meshes are rasterized into a small depth buffer on the job system's workers,
+// which is then reduced into a hierarchy of furthest depths that object bounds are tested against.
+// Has no dependency on the GPU, so it works the same on machines without one.
+class OcclusionCuller {
+public:
+	static constexpr uint32_t WIDTH = 256;
+	static constexpr uint32_t HEIGHT = 128;
+
+	void init(JobSystem& jobSystem);
+
+	uint32_t addOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4& transform);
+	void setOccluderTransform(uint32_t occluder, const glm::mat4& transform);
+	void removeOccluder(uint32_t occluder);
+	bool hasOccluders() const { return occluderCount > 0; }
+
+	// Rasterizes every occluder for this view and rebuilds the hierarchy. Also resets the stats for the frame
+	void render(const glm::mat4& viewProjection);
+	// True when the world space box is completely hidden behind the occluders. Safe to call from several threads at once
+	bool isOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+	OcclusionStats getStats() const;
+
+protected:
+	struct Occluder {
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		glm::mat4 transform;
+		bool alive{ false };
+	};
+
+	// triangle set up in screen space as edge functions and a depth plane, all of the form a * x + b * y + c
+	struct ScreenTriangle {
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC;
+		int32_t minX, maxX, minY, maxY;
+	};
+
+	// one level of the hierarchy, each texel covers 2^level pixels along each axis
+	struct DepthLevel {
+		uint32_t width;
+		uint32_t height;
+		// furthest depth within the texel
+		std::vector<float> minDepth;
+	};
+
+	void setupTriangles();
+	void rasterizeBand(uint32_t rowStart, uint32_t rowEnd);
+	void rasterizeTriangle(const ScreenTriangle& triangle, int32_t rowStart, int32_t rowEnd);
+	void buildHierarchy();
+
+	JobSystem* jobSystem;
+	std::vector<Occluder> occluders;
+	std::vector<uint32_t> freeOccluders;
+	uint32_t occluderCount{ 0 };
+
+	glm::mat4 viewProjection{ 1.f };
+	std::vector<ScreenTriangle> triangles;
+	// stores 1 / w, so larger values are closer and the cleared value of 0 is infinitely far away
+	std::vector<float> depthBuffer;
+	std::vector<DepthLevel> levels;
+
+	float rasterTime{ 0.f };
+	mutable std::atomic<uint32_t> testedCount{ 0 };
+	mutable std::atomic<uint32_t> occludedCount{ 0 };
+};
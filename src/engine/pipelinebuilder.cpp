@@ -4,7 +4,7 @@
 
 #include "vulkankinitialisers.h"
 
-VkPipeline PipelineBuilder::buildPipeline(VkDevice& device, VkRenderPass pass) {
+VkPipeline PipelineBuilder::buildPipeline(VkDevice& device, VkPipelineCache cache) {
 	// make viewport state from our stored viewport and scissor.
 	// at the moment we won't support multiple viewports or scissors
 	VkPipelineViewportStateCreateInfo viewportState = {};
@@ -31,12 +31,21 @@ VkPipeline PipelineBuilder::buildPipeline(VkDevice& device, VkRenderPass pass) {
 
 	colorBlending.logicOpEnable = VK_FALSE;
 	colorBlending.logicOp = VK_LOGIC_OP_COPY;
-	colorBlending.attachmentCount = 1;
+	colorBlending.attachmentCount = colorAttachmentCount;
 	colorBlending.pAttachments = &colorBlendAttachment;
 
+	VkPipelineRenderingCreateInfo renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	renderingInfo.pNext = nullptr;
+
+	renderingInfo.colorAttachmentCount = colorAttachmentCount;
+	renderingInfo.pColorAttachmentFormats = &colorFormat;
+	renderingInfo.depthAttachmentFormat = depthFormat;
+	renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
 	VkGraphicsPipelineCreateInfo pipelineInfo = {};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.pNext = nullptr;
+	pipelineInfo.pNext = &renderingInfo;
 
 	pipelineInfo.stageCount = (uint32_t)shaderStages.size();
 	pipelineInfo.pStages = shaderStages.data();
@@ -47,7 +56,7 @@ VkPipeline PipelineBuilder::buildPipeline(VkDevice& device, VkRenderPass pass) {
 	pipelineInfo.pMultisampleState = &multisampling;
 	pipelineInfo.pColorBlendState = &colorBlending;
 	pipelineInfo.layout = pipelineLayout;
-	pipelineInfo.renderPass = pass;
+	pipelineInfo.renderPass = VK_NULL_HANDLE;
 	pipelineInfo.subpass = 0;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.pDepthStencilState = &depthStencil;
@@ -56,7 +65,7 @@ VkPipeline PipelineBuilder::buildPipeline(VkDevice& device, VkRenderPass pass) {
 	//it's easy to error out on create graphics pipeline, so we handle it a bit better than the common VK_CHECK case
 	VkPipeline newPipeline;
 	if (vkCreateGraphicsPipelines(
-		device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
+		device, cache, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
 		std::cout << "failed to create pipeline\n";
 		return VK_NULL_HANDLE; // failed to create graphics pipeline
 	} else {
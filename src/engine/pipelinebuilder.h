@@ -15,6 +15,11 @@ struct PipelineBuilder {
 	VkPipelineMultisampleStateCreateInfo multisampling {};
 	VkPipelineLayout pipelineLayout {};
 	VkPipelineDepthStencilStateCreateInfo depthStencil {};
+	// depth only pipelines have no color attachment to blend into
+	uint32_t colorAttachmentCount { 1 };
+	// dynamic rendering has no render pass to take the attachment formats from, so the pipeline carries them itself
+	VkFormat colorFormat { VK_FORMAT_UNDEFINED };
+	VkFormat depthFormat { VK_FORMAT_UNDEFINED };
 
-	VkPipeline buildPipeline(VkDevice& device, VkRenderPass pass);
+	VkPipeline buildPipeline(VkDevice& device, VkPipelineCache cache = VK_NULL_HANDLE);
 };
\ No newline at end of file
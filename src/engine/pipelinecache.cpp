@@ -0,0 +1,106 @@
+#include "pipelinecache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "console.h"
+
+void PipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties& properties, Console& console, const std::string& filePath) {
+	this->device = device;
+	this->properties = properties;
+	this->console = &console;
+	this->filePath = filePath;
+
+	std::vector<char> data;
+	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+	if (file.is_open()) {
+		data.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read(data.data(), data.size());
+		file.close();
+
+		if (!isCompatible(data)) {
+			console.log("[WARN]: Pipeline cache " + filePath + " was saved by a different driver or GPU, starting with an empty cache");
+			data.clear();
+		}
+	} else {
+		console.log("No pipeline cache found at " + filePath + ", starting with an empty cache");
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.pNext = nullptr;
+	cacheInfo.flags = 0;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+		// the driver may still reject data that passed the header check, an empty cache always works
+		console.log("[WARN]: Failed to create the pipeline cache from " + filePath + ", starting with an empty cache");
+		data.clear();
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = nullptr;
+		VK_CHECK(vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache), console);
+	}
+
+	warm = !data.empty();
+	savedSize = data.size();
+
+	if (warm) {
+		console.log("Loaded pipeline cache " + filePath + " (" + std::to_string(data.size() / 1024) + "KB)");
+	}
+}
+
+void PipelineCache::cleanup() {
+	save();
+	vkDestroyPipelineCache(device, cache, nullptr);
+}
+
+void PipelineCache::save() {
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(device, cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+		return;
+	}
+
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(device, cache, &dataSize, data.data()) != VK_SUCCESS) {
+		return;
+	}
+
+	// write next to the real file first, so a crash mid-write never leaves a truncated cache behind
+	const std::string tempPath = filePath + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		console->log("[WARN]: Failed to write pipeline cache " + tempPath);
+		return;
+	}
+
+	file.write(data.data(), dataSize);
+	file.close();
+
+	std::remove(filePath.c_str());
+	if (std::rename(tempPath.c_str(), filePath.c_str()) != 0) {
+		console->log("[WARN]: Failed to replace pipeline cache " + filePath);
+		return;
+	}
+
+	savedSize = dataSize;
+}
+
+bool PipelineCache::isCompatible(const std::vector<char>& data) const {
+	VkPipelineCacheHeaderVersionOne header;
+	if (data.size() < sizeof(header)) {
+		return false;
+	}
+
+	memcpy(&header, data.data(), sizeof(header));
+
+	return header.headerSize >= sizeof(header) &&
+		header.headerSize <= data.size() &&
+		header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		header.vendorID == properties.vendorID &&
+		header.deviceID == properties.deviceID &&
+		memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
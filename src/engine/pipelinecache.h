@@ -0,0 +1,36 @@
+#pragma once
+
+class Console;
+
+#include <utils/types.h>
+
+#include <string>
+#include <vector>
+
+// Owns the VkPipelineCache every pipeline is created through, persisted to disk between runs.
+// Data saved by a different driver or GPU is thrown away instead of being handed to the driver.
+class PipelineCache {
+public:
+	void init(VkDevice device, const VkPhysicalDeviceProperties& properties, Console& console, const std::string& filePath);
+	void cleanup();
+
+	// Reads the cache back from the driver and writes it out synchronously, so it is only done on shutdown or when asked for from the UI
+	void save();
+
+	VkPipelineCache get() const { return cache; }
+	// True when usable data was loaded from disk, so pipeline creation should mostly hit the cache
+	bool isWarm() const { return warm; }
+	size_t getSavedSize() const { return savedSize; }
+
+protected:
+	bool isCompatible(const std::vector<char>& data) const;
+
+	VkDevice device;
+	VkPhysicalDeviceProperties properties;
+	Console* console;
+	std::string filePath;
+
+	VkPipelineCache cache{ VK_NULL_HANDLE };
+	bool warm{ false };
+	size_t savedSize{ 0 };
+};
@@ -0,0 +1,393 @@
+#include "pipelineregistry.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <unordered_set>
+
+#include "console.h"
+#include "jobsystem.h"
+#include "pipelinecache.h"
+
+template<typename T>
+static void hashCombine(uint64_t& seed, const T& value) {
+	seed ^= std::hash<T>{}(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+// handles, enums and floats all go in by their bits, so equal words mean equal state
+template<typename T>
+static void addState(PipelineState& state, const T& value) {
+	static_assert(sizeof(T) <= sizeof(uint64_t));
+	uint64_t word = 0;
+	memcpy(&word, &value, sizeof(T));
+	state.words.push_back(word);
+	hashCombine(state.hash, word);
+}
+
+void PipelineRegistry::init(VkDevice device, PipelineCache& pipelineCache, JobSystem& jobSystem, Console& console) {
+	this->device = device;
+	this->pipelineCache = &pipelineCache;
+	this->jobSystem = &jobSystem;
+	this->console = &console;
+
+	compileThread = std::thread([this]() { compileLoop(); });
+}
+
+void PipelineRegistry::cleanup() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+
+	wakeCondition.notify_all();
+	if (compileThread.joinable()) {
+		compileThread.join();
+	}
+
+	// requests that finished but were never collected still own their pipeline
+	for (AsyncRequest* request : finishedRequests) {
+		if (request->pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, request->pipeline, nullptr);
+		}
+	}
+
+	finishedRequests.clear();
+	queuedRequests.clear();
+	pendingRequests.clear();
+
+	for (auto& [key, pipeline] : pipelines) {
+		vkDestroyPipeline(device, pipeline, nullptr);
+	}
+
+	for (auto& [path, shaderModule] : shaderModules) {
+		vkDestroyShaderModule(device, shaderModule, nullptr);
+	}
+
+	pipelines.clear();
+	shaderModules.clear();
+	shaderModuleIds.clear();
+}
+
+bool PipelineRegistry::loadShaderModule(const char* filePath, VkShaderModule* outShaderModule) {
+	auto loaded = shaderModules.find(filePath);
+	if (loaded != shaderModules.end()) {
+		*outShaderModule = loaded->second;
+		return true;
+	}
+
+	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	size_t fileSize = (size_t)file.tellg();
+
+	//spirv expects the buffer to be on uint32, so make sure to reserve an int vector big enough for the entire file
+	std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
+	file.seekg(0);
+	file.read((char*)buffer.data(), fileSize);
+	file.close();
+
+	VkShaderModuleCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.pNext = nullptr;
+
+	//codeSize has to be in bytes, so multiply the ints in the buffer by size of int to know the real size of the buffer
+	createInfo.codeSize = buffer.size() * sizeof(uint32_t);
+	createInfo.pCode = buffer.data();
+
+	//check that the creation goes well.
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+		return false;
+	}
+
+	// FNV-1a over the code
+	uint64_t id = 0xcbf29ce484222325ull;
+	const uint8_t* bytes = (const uint8_t*)buffer.data();
+	for (size_t i = 0; i < createInfo.codeSize; ++i) {
+		id = (id ^ bytes[i]) * 0x100000001b3ull;
+	}
+
+	shaderModules[filePath] = shaderModule;
+	shaderModuleIds[shaderModule] = id;
+
+	*outShaderModule = shaderModule;
+	return true;
+}
+
+VkPipeline PipelineRegistry::getPipeline(PipelineBuilder& builder) {
+	const PipelineState key = getState(builder);
+	++stats.requests;
+
+	auto existing = pipelines.find(key);
+	if (existing != pipelines.end()) {
+		++stats.reused;
+		return existing->second;
+	}
+
+	VkPipeline pipeline = builder.buildPipeline(device, pipelineCache->get());
+	if (pipeline != VK_NULL_HANDLE) {
+		pipelines[key] = pipeline;
+		++stats.compiled;
+	}
+
+	return pipeline;
+}
+
+void PipelineRegistry::compile(std::vector<PipelineRequest>& requests) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// find the distinct states that don't have a pipeline yet, requests sharing a state are only built once
+	std::vector<PipelineState> keys(requests.size());
+	std::vector<uint32_t> missing;
+	std::unordered_set<PipelineState, PipelineStateHash> pending;
+
+	for (uint32_t i = 0; i < (uint32_t)requests.size(); ++i) {
+		keys[i] = getState(requests[i].builder);
+		++stats.requests;
+
+		if (pipelines.count(keys[i]) > 0 || pending.count(keys[i]) > 0) {
+			++stats.reused;
+			continue;
+		}
+
+		pending.insert(keys[i]);
+		missing.push_back(i);
+	}
+
+	// the pipeline cache is internally synchronised, and every request builds from its own copy of the builder
+	std::vector<VkPipeline> built(missing.size(), VK_NULL_HANDLE);
+	jobSystem->parallelFor((uint32_t)missing.size(), [&](uint32_t index) {
+		PipelineRequest& request = requests[missing[index]];
+		built[index] = request.builder.buildPipeline(device, pipelineCache->get());
+	});
+
+	for (uint32_t i = 0; i < (uint32_t)missing.size(); ++i) {
+		if (built[i] != VK_NULL_HANDLE) {
+			pipelines[keys[missing[i]]] = built[i];
+			++stats.compiled;
+		}
+	}
+
+	for (uint32_t i = 0; i < (uint32_t)requests.size(); ++i) {
+		auto pipeline = pipelines.find(keys[i]);
+		*requests[i].outPipeline = pipeline != pipelines.end() ? pipeline->second : VK_NULL_HANDLE;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	const float time = std::chrono::duration<float, std::milli>(end - start).count();
+	stats.compileTime += time;
+
+	console->log(
+		"Compiled " + std::to_string(missing.size()) + " of " + std::to_string(requests.size()) + " requested pipelines on " +
+		std::to_string(jobSystem->getThreadCount()) + " threads in " + std::to_string(time) + "ms"
+	);
+}
+
+void PipelineRegistry::requestPipeline(const PipelineBuilder& builder, VkPipeline* outPipeline, VkPipeline fallback) {
+	const PipelineState key = getState(builder);
+	++stats.requests;
+
+	auto existing = pipelines.find(key);
+	if (existing != pipelines.end()) {
+		++stats.reused;
+		*outPipeline = existing->second;
+		return;
+	}
+
+	*outPipeline = fallback;
+
+	// the same state is already on its way, so just wait for that one too
+	auto pending = pendingRequests.find(key);
+	if (pending != pendingRequests.end()) {
+		++stats.reused;
+		pending->second->outputs.push_back(outPipeline);
+		return;
+	}
+
+	auto request = std::make_unique<AsyncRequest>();
+	request->key = key;
+	request->builder = builder;
+	request->outputs.push_back(outPipeline);
+	request->requestTime = std::chrono::high_resolution_clock::now();
+
+	VkPipelineVertexInputStateCreateInfo& vertexInput = request->builder.vertexInputInfo;
+	request->bindings.assign(vertexInput.pVertexBindingDescriptions, vertexInput.pVertexBindingDescriptions + vertexInput.vertexBindingDescriptionCount);
+	request->attributes.assign(vertexInput.pVertexAttributeDescriptions, vertexInput.pVertexAttributeDescriptions + vertexInput.vertexAttributeDescriptionCount);
+	vertexInput.pVertexBindingDescriptions = request->bindings.data();
+	vertexInput.pVertexAttributeDescriptions = request->attributes.data();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queuedRequests.push_back(request.get());
+	}
+
+	pendingRequests[key] = std::move(request);
+	stats.pending = (uint32_t)pendingRequests.size();
+	wakeCondition.notify_one();
+}
+
+void PipelineRegistry::update() {
+	std::vector<AsyncRequest*> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (finishedRequests.empty()) {
+			return;
+		}
+
+		finished.swap(finishedRequests);
+	}
+
+	auto now = std::chrono::high_resolution_clock::now();
+	for (AsyncRequest* request : finished) {
+		if (request->pipeline == VK_NULL_HANDLE) {
+			// the requesters keep using the fallback
+			console->log("[ERROR]: Failed to build an async pipeline, keeping the fallback");
+		} else {
+			pipelines[request->key] = request->pipeline;
+			++stats.compiled;
+
+			for (VkPipeline* output : request->outputs) {
+				*output = request->pipeline;
+			}
+		}
+
+		stats.compileTime += request->buildTime;
+		stats.lastAsyncLatency = std::chrono::duration<float, std::milli>(now - request->requestTime).count();
+		//the key lives in the request, so it can't be what erase is handed
+		pendingRequests.erase(pendingRequests.find(request->key));
+	}
+
+	stats.pending = (uint32_t)pendingRequests.size();
+}
+
+void PipelineRegistry::compileLoop() {
+	while (true) {
+		AsyncRequest* request;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeCondition.wait(lock, [&]() { return quit || !queuedRequests.empty(); });
+
+			if (quit) {
+				return;
+			}
+
+			request = queuedRequests.front();
+			queuedRequests.pop_front();
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		VkPipeline pipeline = request->builder.buildPipeline(device, pipelineCache->get());
+		auto end = std::chrono::high_resolution_clock::now();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		request->pipeline = pipeline;
+		request->buildTime = std::chrono::duration<float, std::milli>(end - start).count();
+		finishedRequests.push_back(request);
+	}
+}
+
+PipelineState PipelineRegistry::getState(const PipelineBuilder& builder) const {
+	PipelineState state;
+
+	for (const VkPipelineShaderStageCreateInfo& stage : builder.shaderStages) {
+		addState(state, stage.stage);
+		for (const char* c = stage.pName; *c != '\0'; ++c) {
+			addState(state, *c);
+		}
+		addState(state, '\0');
+
+		// modules that didn't come through the registry can only be told apart by handle
+		auto id = shaderModuleIds.find(stage.module);
+		if (id != shaderModuleIds.end()) {
+			addState(state, id->second);
+		} else {
+			addState(state, stage.module);
+		}
+	}
+
+	const VkPipelineVertexInputStateCreateInfo& vertexInput = builder.vertexInputInfo;
+	for (uint32_t i = 0; i < vertexInput.vertexBindingDescriptionCount; ++i) {
+		const VkVertexInputBindingDescription& binding = vertexInput.pVertexBindingDescriptions[i];
+		addState(state, binding.binding);
+		addState(state, binding.stride);
+		addState(state, binding.inputRate);
+	}
+
+	for (uint32_t i = 0; i < vertexInput.vertexAttributeDescriptionCount; ++i) {
+		const VkVertexInputAttributeDescription& attribute = vertexInput.pVertexAttributeDescriptions[i];
+		addState(state, attribute.location);
+		addState(state, attribute.binding);
+		addState(state, attribute.format);
+		addState(state, attribute.offset);
+	}
+
+	for (VkDynamicState state : builder.dynamicStateEnables) {
+		addState(state, state);
+	}
+
+	addState(state, builder.inputAssembly.topology);
+	addState(state, builder.inputAssembly.primitiveRestartEnable);
+
+	const VkPipelineRasterizationStateCreateInfo& rasterizer = builder.rasterizer;
+	addState(state, rasterizer.depthClampEnable);
+	addState(state, rasterizer.rasterizerDiscardEnable);
+	addState(state, rasterizer.polygonMode);
+	addState(state, rasterizer.cullMode);
+	addState(state, rasterizer.frontFace);
+	addState(state, rasterizer.depthBiasEnable);
+	addState(state, rasterizer.depthBiasConstantFactor);
+	addState(state, rasterizer.depthBiasClamp);
+	addState(state, rasterizer.depthBiasSlopeFactor);
+	addState(state, rasterizer.lineWidth);
+
+	const VkPipelineColorBlendAttachmentState& blend = builder.colorBlendAttachment;
+	addState(state, blend.blendEnable);
+	addState(state, blend.srcColorBlendFactor);
+	addState(state, blend.dstColorBlendFactor);
+	addState(state, blend.colorBlendOp);
+	addState(state, blend.srcAlphaBlendFactor);
+	addState(state, blend.dstAlphaBlendFactor);
+	addState(state, blend.alphaBlendOp);
+	addState(state, blend.colorWriteMask);
+	addState(state, builder.colorAttachmentCount);
+
+	const VkPipelineMultisampleStateCreateInfo& multisampling = builder.multisampling;
+	addState(state, multisampling.rasterizationSamples);
+	addState(state, multisampling.sampleShadingEnable);
+	addState(state, multisampling.minSampleShading);
+	addState(state, multisampling.alphaToCoverageEnable);
+	addState(state, multisampling.alphaToOneEnable);
+
+	const VkPipelineDepthStencilStateCreateInfo& depthStencil = builder.depthStencil;
+	addState(state, depthStencil.depthTestEnable);
+	addState(state, depthStencil.depthWriteEnable);
+	addState(state, depthStencil.depthCompareOp);
+	addState(state, depthStencil.depthBoundsTestEnable);
+	addState(state, depthStencil.minDepthBounds);
+	addState(state, depthStencil.maxDepthBounds);
+	addState(state, depthStencil.stencilTestEnable);
+
+	if (depthStencil.stencilTestEnable) {
+		for (const VkStencilOpState& op : { depthStencil.front, depthStencil.back }) {
+			addState(state, op.failOp);
+			addState(state, op.passOp);
+			addState(state, op.depthFailOp);
+			addState(state, op.compareOp);
+			addState(state, op.compareMask);
+			addState(state, op.writeMask);
+			addState(state, op.reference);
+		}
+	}
+
+	addState(state, builder.colorFormat);
+	addState(state, builder.depthFormat);
+
+	addState(state, builder.pipelineLayout);
+
+	return state;
+}
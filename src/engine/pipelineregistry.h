@@ -0,0 +1,106 @@
+#pragma once
+
+class Console;
+class JobSystem;
+class PipelineCache;
+
+#include <utils/types.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "pipelinebuilder.h"
+
+struct PipelineRequest {
+	PipelineBuilder builder;
+	VkPipeline* outPipeline;
+};
+
+struct PipelineRegistryStats {
+	uint32_t requests{ 0 };
+	uint32_t reused{ 0 };
+	uint32_t compiled{ 0 };
+	float compileTime{ 0.f };
+	// async requests waiting on the compile thread, and how long the last one took to become ready
+	uint32_t pending{ 0 };
+	float lastAsyncLatency{ 0.f };
+};
+
+// The builder state a pipeline is built from, flattened into words. Lookups compare every word,
+// so two states whose hashes collide still get pipelines of their own
+struct PipelineState {
+	std::vector<uint64_t> words;
+	uint64_t hash{ 0 };
+
+	bool operator==(const PipelineState& other) const { return hash == other.hash && words == other.words; }
+};
+
+struct PipelineStateHash {
+	size_t operator()(const PipelineState& state) const { return (size_t)state.hash; }
+};
+
+// Deduplicates pipelines by their full builder state, so call sites asking for the same state share one VkPipeline.
+// Owns every pipeline and shader module it hands out.
+class PipelineRegistry {
+public:
+	void init(VkDevice device, PipelineCache& pipelineCache, JobSystem& jobSystem, Console& console);
+	void cleanup();
+
+	// Loads a SPIR-V file once per path. Modules are identified by their code, so identical shaders under different names share pipelines
+	bool loadShaderModule(const char* filePath, VkShaderModule* outShaderModule);
+
+	// Returns the existing pipeline for this state, building it on the calling thread when there isn't one yet
+	VkPipeline getPipeline(PipelineBuilder& builder);
+	// Resolves every request, building the missing pipelines in parallel on the job system
+	void compile(std::vector<PipelineRequest>& requests);
+	// Never blocks: outPipeline holds the fallback until the pipeline has been built on the compile thread, and is swapped over in update.
+	// outPipeline has to stay valid until then
+	void requestPipeline(const PipelineBuilder& builder, VkPipeline* outPipeline, VkPipeline fallback);
+	// Hands finished async pipelines to their requesters. Called once per frame before any draws are recorded
+	void update();
+
+	const PipelineRegistryStats& getStats() const { return stats; }
+
+protected:
+	struct AsyncRequest {
+		PipelineState key;
+		PipelineBuilder builder;
+		// the builder only points at vertex input descriptions, the caller's copies may be gone before it gets built
+		std::vector<VkVertexInputBindingDescription> bindings;
+		std::vector<VkVertexInputAttributeDescription> attributes;
+		std::vector<VkPipeline*> outputs;
+		std::chrono::high_resolution_clock::time_point requestTime;
+		VkPipeline pipeline{ VK_NULL_HANDLE };
+		float buildTime{ 0.f };
+	};
+
+	PipelineState getState(const PipelineBuilder& builder) const;
+	void compileLoop();
+
+	VkDevice device;
+	PipelineCache* pipelineCache;
+	JobSystem* jobSystem;
+	Console* console;
+
+	std::unordered_map<PipelineState, VkPipeline, PipelineStateHash> pipelines;
+	std::unordered_map<std::string, VkShaderModule> shaderModules;
+	std::unordered_map<VkShaderModule, uint64_t> shaderModuleIds;
+
+	PipelineRegistryStats stats;
+
+	// the compile thread only writes the pipeline and build time of a request, and hands it back through finishedRequests
+	std::unordered_map<PipelineState, std::unique_ptr<AsyncRequest>, PipelineStateHash> pendingRequests;
+	std::deque<AsyncRequest*> queuedRequests;
+	std::vector<AsyncRequest*> finishedRequests;
+	std::thread compileThread;
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	bool quit{ false };
+};
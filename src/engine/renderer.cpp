@@ -11,9 +11,12 @@
 #include <imgui_impl_sdl.h>
 #include <imgui_impl_vulkan.h>
 
-#include <fstream>
+#include <chrono>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <unordered_set>
+#include <cstring>
 
 #include "vulkankinitialisers.h"
 #include "pipelinebuilder.h"
@@ -21,9 +24,25 @@
 #include "console.h"
 #include "model.h"
 #include "mesh.h"
+#include "staticbatcher.h"
+#include "jobsystem.h"
+#include "allocationtracker.h"
 
 constexpr uint32_t ONE_SECOND = 1000000000;
 constexpr uint32_t MAX_RENDERABLE_OBJECTS = 10000;
+constexpr uint32_t MAX_RENDER_OBJECTS = 100000;
+constexpr uint32_t MAX_OBJECT_UPLOADS_PER_FRAME = 16384;
+constexpr uint32_t MAX_MESHES = 1024;
+constexpr uint32_t MAX_TEXTURES = 256;
+constexpr uint32_t MAX_MATERIALS = 4096;
+// uploads bigger than this are streamed through it a piece at a time
+constexpr VkDeviceSize STAGING_MEMORY_CAP = 64 * 1024 * 1024;
+// a starting size, each arena grows to fit the busiest frame it has seen
+constexpr size_t FRAME_ARENA_SIZE = 1024 * 1024;
+// uploaded buffers are copied out of as well when defragmentation moves them
+constexpr VkBufferUsageFlags UPLOAD_BUFFER_USAGE = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+constexpr uint32_t SHADOW_MAP_RESOLUTION = 2048;
+constexpr const char* PIPELINE_CACHE_PATH = "pipelinecache.bin";
 
 void VK_CHECK(VkResult err, Console& console) {
 	do {                                                                  
@@ -36,10 +55,11 @@ void VK_CHECK(VkResult err, Console& console) {
 }
 
 
-void Renderer::init(Window& window, uint32_t* pFrameNumber, Console& console) {
+void Renderer::init(Window& window, uint32_t* pFrameNumber, Console& console, JobSystem& jobSystem) {
 	this->window = &window;
 	this->pFrameNumber = pFrameNumber;
 	this->console = &console;
+	this->jobSystem = &jobSystem;
 
 	initVulkan();
 
@@ -56,204 +76,1485 @@ void Renderer::init(Window& window, uint32_t* pFrameNumber, Console& console) {
 	});
 
 	initSyncStructure();
+	renderObjects.init(MAX_RENDER_OBJECTS);
+	lightManager.init(MAX_LIGHTS);
+	materialManager.init(MAX_MATERIALS);
+	//the sun does most of the lighting, the ambient term only keeps the shadowed side from going black
+	sceneProps.ambientColor = glm::vec4(0.3f);
+	sceneProps.sunDirection = glm::vec4(glm::normalize(glm::vec3(-0.4f, -1.f, -0.3f)), 1.f);
+	sceneProps.sunColor = glm::vec4(1.f);
+	occlusionCuller.init(jobSystem);
 	initDescriptors();
+	initFrames();
+	mainDeletionQueue.pushFunction([=]() {
+		cleanupFrames();
+	});
+
+	pipelineCache.init(device, GPU_props, console, PIPELINE_CACHE_PATH);
+	mainDeletionQueue.pushFunction([=]() {
+		pipelineCache.cleanup();
+	});
+
+	pipelineRegistry.init(device, pipelineCache, jobSystem, console);
+	mainDeletionQueue.pushFunction([=]() {
+		pipelineRegistry.cleanup();
+	});
+
+	renderGraph.init(device, allocator, console);
+	//transients replaced after a resize retire with the frames still drawing to them, like the rest of the swapchain's resources
+	renderGraph.setDeletionQueue(frameDeletionQueue, &frameTimelineValue);
+	mainDeletionQueue.pushFunction([=]() {
+		renderGraph.cleanup();
+	});
+
 	initPipelines();
+	initShadows();
+	initDepthPyramid();
+	mainDeletionQueue.pushFunction([=]() {
+		cleanupDepthPyramid();
+	});
+
 	initIMGUI();
 
+	//timestamps are read back once the frame comes around again, so a scale change shows up in them a frame after that
+	dynamicResolution.init(framesInFlight + 1);
+
 	camera.init();
-	meshManager.init(console);
-	textureManager.init(console);
+	meshManager.init(console, MAX_MESHES);
+	textureManager.init(console, MAX_TEXTURES);
+
+	for (LinearArena& arena : frameArenas) {
+		arena.init(FRAME_ARENA_SIZE);
+	}
+	beginFrame();
+
+	isInitialised = true;
+}
+
+void Renderer::beginFrame() {
+	LinearArena& arena = frameArenas[*pFrameNumber % framesInFlight];
+	arena.reset();
+
+	// the old contents belong to an arena that is reset later, so they are dropped rather than freed
+	modelQueue = FrameVector<Model*>(arena);
+	objectCopyRegions = FrameVector<VkBufferCopy>(arena);
+	visibleRenderObjects = FrameVector<uint32_t>(arena);
+	occludedRenderObjects = FrameVector<uint8_t>(arena);
+	visibleRenderObjects.reserve(renderObjects.getCount());
+}
+
+void Renderer::draw() {
+	if (requestedFramesInFlight != framesInFlight) {
+		applyFramesInFlight();
+	}
+
+	//the time blocked here is how long the CPU ran ahead of the GPU
+	auto waitStart = std::chrono::high_resolution_clock::now();
+	VkSemaphoreWaitInfo waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.pNext = nullptr;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &frameTimeline;
+	waitInfo.pValues = &getCurrentFrame().timelineValue;
+	VK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX), *console);
+	framePacingStats.cpuWait = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+	getCurrentFrame().transientDescriptors.reset();
+
+	//a minimised window has nothing to present to until it is restored
+	if (window->extent.width == 0 || window->extent.height == 0) {
+		return;
+	}
+
+	//rebuilt before the acquire, so the frame doesn't have to be thrown away for it
+	if (framebufferResized || presentModeChanged || swapchainOutdated) {
+		recreateSwapchain();
+	}
+
+	uint32_t swapchainImageIndex;
+	VkResult result = vkAcquireNextImageKHR(device, swapchain, ONE_SECOND, getCurrentFrame().presentSemaphore, nullptr, &swapchainImageIndex);
+
+	//nothing was acquired from an out of date swapchain and the semaphore is still unsignalled, so the frame can carry on with a new one
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+		recreateSwapchain();
+		result = vkAcquireNextImageKHR(device, swapchain, ONE_SECOND, getCurrentFrame().presentSemaphore, nullptr, &swapchainImageIndex);
+	}
+
+	if (result == VK_SUBOPTIMAL_KHR) {
+		//the image can still be presented, the swapchain gets rebuilt before the next acquire
+		swapchainOutdated = true;
+	} else if (result != VK_SUCCESS) {
+		return;
+	}
+
+	uint64_t completedValue = 0;
+	VK_CHECK(vkGetSemaphoreCounterValue(device, frameTimeline, &completedValue), *console);
+	frameDeletionQueue.collect(completedValue);
+	//the budgets VMA reports are refreshed when the frame index moves on
+	vmaSetCurrentFrameIndex(allocator, *pFrameNumber);
+	if (!memoryDefragmenter.isPassPending()) {
+		evictAssets();
+	}
+	updateDefragmentation(completedValue);
+
+	VK_CHECK(vkResetCommandBuffer(getCurrentFrame().mainCommandBuffer, 0), *console);
+	VkCommandBuffer cmd = getCurrentFrame().mainCommandBuffer;
+
+	//begin the command buffer recording. We will use this command buffer exactly once, so we want to let Vulkan know that
+	VkCommandBufferBeginInfo cmdBeginInfo = vkinit::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo), *console);
+
+	FrameData& frame = getCurrentFrame();
+	if (frame.imageDescriptorsStale) {
+		writeFrameImageDescriptors(frame);
+	}
+	writeCullDescriptor(frame);
+	//everything queued since the last frame, material sets from model loads included, goes to the driver in one go
+	descriptorWriter.flush();
+	readFrameTimestamps(frame);
+	readCullStats(frame);
+	readLightStats(frame);
+	updateRenderExtent();
+	vkCmdResetQueryPool(cmd, frame.timestampPool, 0, TIMESTAMP_COUNT);
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_FRAME);
+
+	pipelineRegistry.update();
+	shadowCascades.update(camera, glm::vec3(sceneProps.sunDirection), renderObjects, renderObjects.getDrawOrder(), renderObjects.getStaticVersion());
+	updateSceneBuffers();
+	uploadLights();
+	uploadMaterials();
+	uploadDirtyRenderObjects();
+	// objects past this frame's upload budget aren't in the object buffer yet, so a cache drawn from them would be wrong
+	if (!renderObjects.getDirtySlots().empty()) {
+		shadowCascades.invalidateCache();
+	}
+	uploadModelQueue();
+	cullRenderObjects();
+
+	VkClearValue colorClearValue;
+	colorClearValue.color = { { 0.f, 0.f, 0.f, 1.f } };
+
+	VkClearValue depthClearValue;
+	depthClearValue.depthStencil.depth = 1.f;
+
+	VkViewport viewport {};
+	viewport.x = 0.f;
+	viewport.y = 0.f;
+	viewport.width = renderExtent.width;
+	viewport.height = renderExtent.height;
+	viewport.minDepth = 0.f;
+	viewport.maxDepth = 1.f;
+	VkRect2D scissor{ {0, 0}, renderExtent };
+
+	// the two phase cull already gets most of the overdraw savings, and its first phase needs to lay down the depth on its own
+	gpuOcclusionActive = gpuOcclusionEnabled;
+	depthPrepassActive = depthPrepassEnabled && !gpuOcclusionActive;
+
+	if (gpuOcclusionActive) {
+		writeDrawCommands();
+	}
+	const bool gpuCullActive = gpuOcclusionActive && indirectDrawCount > 0;
+
+	//the scene passes render straight into the images, a null color view makes it a depth only pass
+	auto beginRendering = [&](VkCommandBuffer cmd, VkImageView colorView, VkAttachmentLoadOp colorLoadOp, VkAttachmentLoadOp depthLoadOp) {
+		VkRenderingAttachmentInfo colorAttachment = vkinit::renderingAttachmentInfo(colorView, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, colorLoadOp, colorClearValue);
+		VkRenderingAttachmentInfo depthAttachment = vkinit::renderingAttachmentInfo(depthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, depthLoadOp, depthClearValue);
+		VkRenderingInfo renderingInfo = vkinit::renderingInfo(renderExtent, colorView != VK_NULL_HANDLE ? &colorAttachment : nullptr, &depthAttachment);
+
+		vkCmdBeginRendering(cmd, &renderingInfo);
+		vkCmdSetViewport(cmd, 0, 1, &viewport);
+		vkCmdSetScissor(cmd, 0, 1, &scissor);
+	};
+
+	//every pass declares what it touches, the graph works out the order and the barriers in between.
+	//The swapchain image only becomes available once the acquire semaphore is waited on at the color output stage
+	renderGraph.reset();
+	RenderGraphResource swapchainTarget = renderGraph.importImage(
+		"Swapchain", swapchainImages[swapchainImageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+		{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED }
+	);
+	// only lives from the main pass to the upscale, so the graph owns it and places it in memory it can share.
+	// It is sized for the largest render scale, lower scales only use part of it
+	RenderGraphResource sceneColor = renderGraph.createImage(
+		"Scene Color",
+		{ swapchainImageFormat, window->extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT }
+	);
+	RenderGraphResource depthTarget = renderGraph.importImage(
+		"Depth", depthImage.image, VK_IMAGE_ASPECT_DEPTH_BIT,
+		{ VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED }
+	);
+	RenderGraphResource objects = renderGraph.importBuffer(
+		"Objects", objectBuffer.buffer,
+		{ VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT }
+	);
+	renderGraph.markOutput(swapchainTarget, USAGE_PRESENT);
+
+	if (!objectCopyRegions.empty()) {
+		renderGraph.addPass("Object Upload", [&](VkCommandBuffer cmd) {
+			vkCmdCopyBuffer(cmd, frame.objectStagingBuffer.buffer, objectBuffer.buffer, (uint32_t)objectCopyRegions.size(), objectCopyRegions.data());
+		})
+			.write(objects, USAGE_TRANSFER_DST);
+	}
+
+	// the per frame buffers were last used before the timeline value this frame waited on, and the host writes are visible once submitted
+	RenderGraphResource earlyDraws = renderGraph.importBuffer("Early Draws", frame.drawCommandBuffer.buffer, {});
+	RenderGraphResource lateDraws = renderGraph.importBuffer("Late Draws", frame.lateDrawCommandBuffer.buffer, {});
+	RenderGraphResource cullStats = renderGraph.importBuffer("Cull Stats", frame.cullStatsBuffer.buffer, {});
+	RenderGraphResource pyramid = renderGraph.importImage(
+		"Depth Pyramid", depthPyramid.image, VK_IMAGE_ASPECT_COLOR_BIT,
+		{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, depthPyramidLayout }
+	);
+
+	if (gpuCullActive) {
+		renderGraph.markOutput(cullStats, USAGE_HOST);
+
+		renderGraph.addPass("Clear Cull Stats", [&](VkCommandBuffer cmd) {
+			vkCmdFillBuffer(cmd, frame.cullStatsBuffer.buffer, 0, sizeof(GPUCullStats), 0);
+		})
+			.write(cullStats, USAGE_TRANSFER_DST);
+
+		renderGraph.addPass("Occlusion Cull Early", [&](VkCommandBuffer cmd) {
+			dispatchOcclusionCull(cmd, 0);
+		})
+			.read(objects, USAGE_COMPUTE_STORAGE)
+			.read(pyramid, USAGE_COMPUTE_STORAGE)
+			.read(earlyDraws, USAGE_COMPUTE_STORAGE)
+			.write(earlyDraws, USAGE_COMPUTE_STORAGE)
+			.read(cullStats, USAGE_COMPUTE_STORAGE)
+			.write(cullStats, USAGE_COMPUTE_STORAGE);
+	}
+
+	// the host writes to the light list are visible once submitted, and the clusters were last read before this frame's timeline wait
+	RenderGraphResource lights = renderGraph.importBuffer("Lights", frame.lightBuffer.buffer, {});
+	RenderGraphResource clusters = renderGraph.importBuffer("Light Clusters", frame.clusterBuffer.buffer, {});
+	RenderGraphResource lightStatsResource = renderGraph.importBuffer("Light Stats", frame.lightStatsBuffer.buffer, {});
+	renderGraph.markOutput(lightStatsResource, USAGE_HOST);
+
+	renderGraph.addPass("Clear Light Stats", [&](VkCommandBuffer cmd) {
+		vkCmdFillBuffer(cmd, frame.lightStatsBuffer.buffer, 0, sizeof(GPULightStats), 0);
+	})
+		.write(lightStatsResource, USAGE_TRANSFER_DST);
+
+	renderGraph.addPass("Light Binning", [&](VkCommandBuffer cmd) {
+		dispatchLightCull(cmd);
+	})
+		.read(lights, USAGE_COMPUTE_STORAGE)
+		.write(clusters, USAGE_COMPUTE_STORAGE)
+		.read(lightStatsResource, USAGE_COMPUTE_STORAGE)
+		.write(lightStatsResource, USAGE_COMPUTE_STORAGE);
+
+	// every layer gets cleared or has the cache copied over it, so whatever the last frame left can go.
+	// The cache itself is only ever written here, it is in whatever layout the last frame that used it left it in
+	RenderGraphResource shadowMapResource = renderGraph.importImage(
+		"Shadow Map", shadowMap.image, VK_IMAGE_ASPECT_DEPTH_BIT,
+		{ VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED }
+	);
+	RenderGraphResource shadowCacheResource = renderGraph.importImage(
+		"Shadow Cache", shadowCache.image, VK_IMAGE_ASPECT_DEPTH_BIT,
+		{ VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_NONE, shadowCacheLayout }
+	);
+
+	const bool shadowCacheActive = shadowCascades.settings.cacheStatic;
+	const bool shadowCacheRefresh = shadowCascades.needsCacheRefresh();
+	auto beginShadowPass = [&](VkCommandBuffer cmd, VkImageView layerView, VkAttachmentLoadOp loadOp) {
+		VkRenderingAttachmentInfo depthAttachment = vkinit::renderingAttachmentInfo(layerView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, loadOp, depthClearValue);
+		VkRenderingInfo renderingInfo = vkinit::renderingInfo({ SHADOW_MAP_RESOLUTION, SHADOW_MAP_RESOLUTION }, nullptr, &depthAttachment);
+
+		VkViewport shadowViewport = { 0.f, 0.f, (float)SHADOW_MAP_RESOLUTION, (float)SHADOW_MAP_RESOLUTION, 0.f, 1.f };
+		VkRect2D shadowScissor = { { 0, 0 }, { SHADOW_MAP_RESOLUTION, SHADOW_MAP_RESOLUTION } };
+		vkCmdBeginRendering(cmd, &renderingInfo);
+		vkCmdSetViewport(cmd, 0, 1, &shadowViewport);
+		vkCmdSetScissor(cmd, 0, 1, &shadowScissor);
+	};
+
+	if (shadowCacheRefresh) {
+		renderGraph.addPass("Static Shadow Cache", [&](VkCommandBuffer cmd) {
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_SHADOW_CACHE);
+			for (uint32_t cascadeIndex = SHADOW_FIRST_CACHED_CASCADE; cascadeIndex < SHADOW_CASCADES; ++cascadeIndex) {
+				const ShadowCascade& cascade = shadowCascades.getCascade(cascadeIndex);
+				if (!cascade.refreshCache) {
+					continue;
+				}
+
+				beginShadowPass(cmd, shadowCacheLayerViews[cascadeIndex - SHADOW_FIRST_CACHED_CASCADE], VK_ATTACHMENT_LOAD_OP_CLEAR);
+				drawShadowCasters(cmd, cascade.staticCasters, cascade.viewProjection, false);
+				vkCmdEndRendering(cmd);
+			}
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_SHADOW_CACHE + 1);
+		})
+			.read(objects, USAGE_VERTEX_STORAGE)
+			.read(shadowCacheResource, USAGE_DEPTH_ATTACHMENT)
+			.write(shadowCacheResource, USAGE_DEPTH_ATTACHMENT);
+	}
+
+	if (shadowCacheActive) {
+		renderGraph.addPass("Shadow Cache Copy", [&](VkCommandBuffer cmd) {
+			VkImageCopy region = {};
+			region.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, SHADOW_CACHED_CASCADES };
+			region.dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, SHADOW_FIRST_CACHED_CASCADE, SHADOW_CACHED_CASCADES };
+			region.extent = { SHADOW_MAP_RESOLUTION, SHADOW_MAP_RESOLUTION, 1 };
+			vkCmdCopyImage(
+				cmd,
+				shadowCache.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				shadowMap.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &region
+			);
+		})
+			.read(shadowCacheResource, USAGE_TRANSFER_SRC)
+			.write(shadowMapResource, USAGE_TRANSFER_DST);
+	}
+
+	RenderGraphPassBuilder shadowPass = renderGraph.addPass("Shadows", [&](VkCommandBuffer cmd) {
+		// the refresh pair still has to be written when there was no refresh, otherwise the whole pool reads back as not ready
+		if (!shadowCacheRefresh) {
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_SHADOW_CACHE);
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_SHADOW_CACHE + 1);
+		}
+
+		for (uint32_t cascadeIndex = 0; cascadeIndex < SHADOW_CASCADES; ++cascadeIndex) {
+			const ShadowCascade& cascade = shadowCascades.getCascade(cascadeIndex);
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_CASCADES + cascadeIndex * 2);
+
+			beginShadowPass(cmd, shadowLayerViews[cascadeIndex], cascade.cached ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR);
+			drawShadowCasters(cmd, cascade.casters, cascade.viewProjection, true);
+			vkCmdEndRendering(cmd);
+
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_CASCADES + cascadeIndex * 2 + 1);
+		}
+	});
+	shadowPass
+		.read(objects, USAGE_VERTEX_STORAGE)
+		.write(shadowMapResource, USAGE_DEPTH_ATTACHMENT);
+	if (shadowCacheActive) {
+		shadowPass.read(shadowMapResource, USAGE_DEPTH_ATTACHMENT);
+	}
+
+	if (depthPrepassActive) {
+		renderGraph.addPass("Depth Pre-pass", [&](VkCommandBuffer cmd) {
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_DEPTH_PREPASS);
+			beginRendering(cmd, VK_NULL_HANDLE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_CLEAR);
+			drawDepthPrepass(cmd);
+			vkCmdEndRendering(cmd);
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_DEPTH_PREPASS + 1);
+		})
+			.read(objects, USAGE_VERTEX_STORAGE)
+			.write(depthTarget, USAGE_DEPTH_ATTACHMENT);
+	}
+
+	RenderGraphPassBuilder mainPass = renderGraph.addPass("Main", [&](VkCommandBuffer cmd) {
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_MAIN);
+
+		//after the depth pre-pass the main pass keeps its depth instead of clearing it
+		beginRendering(cmd, renderGraph.getImageView(sceneColor), VK_ATTACHMENT_LOAD_OP_CLEAR, depthPrepassActive ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR);
+		if (gpuOcclusionActive) {
+			drawRenderObjectsIndirect(cmd, frame.drawCommandBuffer.buffer);
+		} else {
+			drawRenderObjects(cmd);
+		}
+		drawModelsInQueue(cmd);
+		vkCmdEndRendering(cmd);
+
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_MAIN + 1);
+	});
+	mainPass
+		.read(objects, USAGE_VERTEX_STORAGE)
+		.read(shadowMapResource, USAGE_FRAGMENT_SAMPLED)
+		.read(lights, USAGE_FRAGMENT_STORAGE)
+		.read(clusters, USAGE_FRAGMENT_STORAGE)
+		.write(sceneColor, USAGE_COLOR_ATTACHMENT)
+		.write(depthTarget, USAGE_DEPTH_ATTACHMENT);
+	if (depthPrepassActive) {
+		mainPass.read(depthTarget, USAGE_DEPTH_ATTACHMENT);
+	}
+	if (gpuOcclusionActive) {
+		mainPass.read(earlyDraws, USAGE_INDIRECT);
+	}
+
+	if (gpuCullActive) {
+		// second phase: rebuild the pyramid from what the first phase drew,
+		// then draw whatever it wrongly rejected against last frame's pyramid so newly revealed objects don't pop in a frame late
+		renderGraph.addPass("Depth Pyramid", [&](VkCommandBuffer cmd) {
+			buildDepthPyramid(cmd);
+		})
+			.read(depthTarget, USAGE_COMPUTE_SAMPLED)
+			.write(pyramid, USAGE_COMPUTE_STORAGE);
+
+		renderGraph.addPass("Occlusion Cull Late", [&](VkCommandBuffer cmd) {
+			dispatchOcclusionCull(cmd, 1);
+		})
+			.read(objects, USAGE_COMPUTE_STORAGE)
+			.read(pyramid, USAGE_COMPUTE_STORAGE)
+			.read(earlyDraws, USAGE_COMPUTE_STORAGE)
+			.write(lateDraws, USAGE_COMPUTE_STORAGE)
+			.read(cullStats, USAGE_COMPUTE_STORAGE)
+			.write(cullStats, USAGE_COMPUTE_STORAGE);
+
+		renderGraph.addPass("Main Late", [&](VkCommandBuffer cmd) {
+			//draws on top of the first phase, keeping both its color and depth
+			beginRendering(cmd, renderGraph.getImageView(sceneColor), VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_LOAD_OP_LOAD);
+			drawRenderObjectsIndirect(cmd, frame.lateDrawCommandBuffer.buffer);
+			vkCmdEndRendering(cmd);
+		})
+			.read(objects, USAGE_VERTEX_STORAGE)
+			.read(lateDraws, USAGE_INDIRECT)
+			.read(shadowMapResource, USAGE_FRAGMENT_SAMPLED)
+			.read(lights, USAGE_FRAGMENT_STORAGE)
+			.read(clusters, USAGE_FRAGMENT_STORAGE)
+			.read(sceneColor, USAGE_COLOR_ATTACHMENT)
+			.write(sceneColor, USAGE_COLOR_ATTACHMENT)
+			.read(depthTarget, USAGE_DEPTH_ATTACHMENT)
+			.write(depthTarget, USAGE_DEPTH_ATTACHMENT);
+	}
+
+	renderGraph.addPass("Upscale", [&](VkCommandBuffer cmd) {
+		VkImageBlit region = {};
+		region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.srcOffsets[1] = { (int32_t)renderExtent.width, (int32_t)renderExtent.height, 1 };
+		region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.dstOffsets[1] = { (int32_t)window->extent.width, (int32_t)window->extent.height, 1 };
+		vkCmdBlitImage(
+			cmd,
+			renderGraph.getImage(sceneColor), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			swapchainImages[swapchainImageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &region, VK_FILTER_LINEAR
+		);
+	})
+		.read(sceneColor, USAGE_TRANSFER_SRC)
+		.write(swapchainTarget, USAGE_TRANSFER_DST);
+
+	// the ui is drawn after the upscale so it always stays at the window's resolution
+	renderGraph.addPass("UI", [&](VkCommandBuffer cmd) {
+		VkRenderPassBeginInfo rpInfo = {};
+		rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		rpInfo.pNext = nullptr;
+
+		rpInfo.renderPass = uiRenderPass;
+		rpInfo.renderArea.offset.x = 0;
+		rpInfo.renderArea.offset.y = 0;
+		rpInfo.renderArea.extent = window->extent;
+		rpInfo.framebuffer = framebuffers[swapchainImageIndex];
+
+		vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+		vkCmdEndRenderPass(cmd);
+	})
+		.read(swapchainTarget, USAGE_COLOR_ATTACHMENT)
+		.write(swapchainTarget, USAGE_COLOR_ATTACHMENT);
+
+	addDefragmentationPass(sceneColor);
+
+	renderGraph.compile();
+	renderGraph.execute(cmd);
+	if (shadowCacheActive) {
+		shadowCacheLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	}
+	if (gpuCullActive) {
+		depthPyramidLayout = VK_IMAGE_LAYOUT_GENERAL;
+	}
+
+	// like the cache refresh pair, the pre-pass pair still has to be written when the pass didn't run
+	if (!depthPrepassActive) {
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_DEPTH_PREPASS);
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_DEPTH_PREPASS + 1);
+	}
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, TIMESTAMP_FRAME + 1);
+	frame.timestampsWritten = true;
+	frame.cullStatsWritten = gpuCullActive;
+	frame.lightStatsWritten = true;
+	frame.shadowCacheRefreshed = shadowCacheRefresh;
+	frame.depthPrepassMeasured = depthPrepassActive;
+
+	VK_CHECK(vkEndCommandBuffer(cmd), *console);
+
+	//prepare the submission to the queue.
+	//we want to wait on the _presentSemaphore, as that semaphore is signaled when the swapchain is ready
+	//we will signal the _renderSemaphore, to signal that rendering has finished
+
+	VkSubmitInfo submit = {};
+	submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit.pNext = nullptr;
+
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+	submit.pWaitDstStageMask = &waitStage;
+
+	submit.waitSemaphoreCount = 1;
+	submit.pWaitSemaphores = &getCurrentFrame().presentSemaphore;
+
+	//the binary semaphore is for the present, the timeline value tells the frame when its resources are free again
+	frame.timelineValue = ++frameTimelineValue;
+	VkSemaphore signalSemaphores[] = { frame.renderSemaphore, frameTimeline };
+	uint64_t signalValues[] = { 0, frame.timelineValue };
+
+	VkTimelineSemaphoreSubmitInfo timelineSubmit = {};
+	timelineSubmit.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineSubmit.pNext = nullptr;
+	timelineSubmit.signalSemaphoreValueCount = 2;
+	timelineSubmit.pSignalSemaphoreValues = signalValues;
+	submit.pNext = &timelineSubmit;
+
+	submit.signalSemaphoreCount = 2;
+	submit.pSignalSemaphores = signalSemaphores;
+
+	submit.commandBufferCount = 1;
+	submit.pCommandBuffers = &cmd;
+
+	VK_CHECK(vkQueueSubmit(graphicsQueue, 1, &submit, VK_NULL_HANDLE), *console);
+
+	// this will put the image we just rendered into the visible window.
+	// we want to wait on the _renderSemaphore for that,
+	// as it's necessary that drawing commands have finished before the image is displayed to the user
+	VkPresentInfoKHR presentInfo = {};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.pNext = nullptr;
+
+	presentInfo.pSwapchains = &swapchain;
+	presentInfo.swapchainCount = 1;
+
+	presentInfo.pWaitSemaphores = &getCurrentFrame().renderSemaphore;
+	presentInfo.waitSemaphoreCount = 1;
+
+	presentInfo.pImageIndices = &swapchainImageIndex;
+
+	VkResult presentResult = vkQueuePresentKHR(graphicsQueue, &presentInfo);
+	if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
+		swapchainOutdated = true;
+	} else {
+		VK_CHECK(presentResult, *console);
+	}
+}
+
+void Renderer::drawDebug() {
+	ImGui::Begin("Renderer");
+	ImGui::Text("Camera Position: {%.3f, %.3f, %.3f}", camera.position.x, camera.position.y, camera.position.z);
+	ImGui::Text("Camera Rotation: {%.3f, %.3f}", camera.rotation.x, camera.rotation.y);
+	ImGui::Text("Render Objects: %u / %u", renderObjects.getCount(), renderObjects.getCapacity());
+	ImGui::Text("Objects Uploaded: %u", objectsUploadedLastFrame);
+	ImGui::Text("Objects Drawn: %u", renderObjectsDrawn);
+	const DescriptorAllocatorStats& descriptorStats = descriptorAllocator.getStats();
+	ImGui::Text("Descriptor Sets: %u in %u pools (%u layouts)", descriptorStats.sets, descriptorStats.pools, descriptorLayoutCache.getCount());
+	const DescriptorWriterStats& writerStats = descriptorWriter.getStats();
+	ImGui::Text("Descriptor Writes: %u (%u templated) in %.3fms", writerStats.writes, writerStats.templatedWrites, writerStats.flushTime);
+	const LinearArena& frameArena = frameArenas[*pFrameNumber % framesInFlight];
+	ImGui::Text(
+		"Frame Arena: %zuKB / %zuKB (peak %zuKB, grown %u times)",
+		frameArena.getUsed() / 1024, frameArena.getCapacity() / 1024, frameArena.getPeak() / 1024, frameArena.getGrowCount()
+	);
+	ImGui::Separator();
+	ImGui::Checkbox("Occlusion Culling", &occlusionCullingEnabled);
+	ImGui::Text("Occluded: %.1f%% (%u / %u)", occlusionStats.occludedPercentage(), occlusionStats.occluded, occlusionStats.tested);
+	ImGui::Text("Occluder Triangles: %u", occlusionStats.occluderTriangles);
+	ImGui::Text("Occlusion Raster: %.3fms", occlusionStats.rasterTime);
+	ImGui::Separator();
+	ImGui::Checkbox("GPU Occlusion Culling", &gpuOcclusionEnabled);
+	ImGui::Text("Hi-Z Culled: %u / %u", gpuCullStats.occluded, gpuCullStats.tested);
+	ImGui::Text("Phase 1 Drawn: %u", gpuCullStats.earlyDrawn);
+	ImGui::Text("Phase 2 Drawn: %u", gpuCullStats.lateDrawn);
+	ImGui::Separator();
+	ImGui::Text("Materials: %u / %u (%u bind states)", materialManager.getCount(), materialManager.getCapacity(), materialManager.getBindStateCount());
+	ImGui::Separator();
+	ImGui::Text("Lights: %u / %u", lightManager.getCount(), lightManager.getCapacity());
+	ImGui::Text("Active Clusters: %u / %u", lightStats.activeClusters, CLUSTER_COUNT);
+	ImGui::Text("Lights Per Cluster: %.1f avg, %u max", lightStats.averageLights(), lightStats.maxLights);
+	if (lightStats.overflowedClusters > 0) {
+		ImGui::Text("Overflowed Clusters: %u (over %u lights)", lightStats.overflowedClusters, MAX_LIGHTS_PER_CLUSTER);
+	}
+	ImGui::Checkbox("Cluster Heatmap", &clusterHeatmapEnabled);
+	ImGui::Separator();
+	glm::vec3 sunDirection = glm::vec3(sceneProps.sunDirection);
+	if (ImGui::SliderFloat3("Sun Direction", &sunDirection.x, -1.f, 1.f, "%.2f") && glm::length(sunDirection) > 0.01f) {
+		sceneProps.sunDirection = glm::vec4(glm::normalize(sunDirection), sceneProps.sunDirection.w);
+	}
+	ShadowSettings& shadowSettings = shadowCascades.settings;
+	ImGui::SliderFloat("Shadow Distance", &shadowSettings.shadowDistance, 10.f, 200.f, "%.0f");
+	ImGui::SliderFloat("Cascade Split Lambda", &shadowSettings.splitLambda, 0.f, 1.f, "%.2f");
+	ImGui::Checkbox("Cache Static Cascades", &shadowSettings.cacheStatic);
+	const ShadowStats& shadowStats = shadowCascades.getStats();
+	for (uint32_t cascade = 0; cascade < SHADOW_CASCADES; ++cascade) {
+		if (shadowCascades.getCascade(cascade).cached) {
+			ImGui::Text("Cascade %u: %.3fms, %u dynamic casters (%u static cached)", cascade, gpuTimings.cascades[cascade], shadowStats.casters[cascade], shadowStats.staticCasters[cascade]);
+		} else {
+			ImGui::Text("Cascade %u: %.3fms, %u casters", cascade, gpuTimings.cascades[cascade], shadowStats.casters[cascade]);
+		}
+	}
+	ImGui::Text("Shadow Cache Refresh: %.3fms (%u refreshes)", gpuTimings.shadowCacheRefresh, shadowStats.cacheRefreshes);
+	ImGui::Separator();
+	//the first phase of the Hi-Z cull lays down the depth itself, so the pre-pass only runs without it
+	ImGui::BeginDisabled(gpuOcclusionEnabled);
+	ImGui::Checkbox("Depth Pre-pass", &depthPrepassEnabled);
+	ImGui::EndDisabled();
+	if (gpuOcclusionEnabled) {
+		ImGui::TextDisabled("Replaced by GPU occlusion culling");
+	} else if (depthPrepassActive) {
+		ImGui::Text("GPU Depth Pre-pass: %.3fms", gpuTimings.depthPrepass);
+	}
+	ImGui::Text("GPU Main Pass: %.3fms", gpuTimings.mainPass);
+	ImGui::Text("GPU Frame: %.3fms", gpuTimings.total);
+	ImGui::Separator();
+	int framesInFlightSetting = (int)requestedFramesInFlight;
+	if (ImGui::SliderInt("Frames In Flight", &framesInFlightSetting, 1, (int)MAX_FRAMES_IN_FLIGHT)) {
+		requestedFramesInFlight = (uint32_t)framesInFlightSetting;
+	}
+	ImGui::Text("CPU Wait: %.3fms", framePacingStats.cpuWait);
+	ImGui::Text("GPU Idle: %.3fms", framePacingStats.gpuIdle);
+	const FrameDeletionStats& deletionStats = frameDeletionQueue.getStats();
+	ImGui::Text("Deferred Deletions: %u pending, %u destroyed", deletionStats.pending, deletionStats.destroyed);
+	ImGui::Separator();
+	const AssetMemory& meshMemory = meshManager.meshes.getUsage();
+	const AssetMemory& textureMemory = textureManager.loadedTextures.getUsage();
+	ImGui::Text("Meshes: %u loaded, %.2fMB CPU, %.2fMB GPU", meshManager.meshes.getCount(), meshMemory.cpuBytes / 1048576.f, meshMemory.gpuBytes / 1048576.f);
+	ImGui::Text("Textures: %u loaded, %.2fMB GPU", textureManager.loadedTextures.getCount(), textureMemory.gpuBytes / 1048576.f);
+	int cpuBudget = (int)assetBudget.cpuMegabytes;
+	if (ImGui::SliderInt("CPU Asset Budget (MB)", &cpuBudget, 16, 4096)) {
+		assetBudget.cpuMegabytes = (uint32_t)cpuBudget;
+	}
+	int gpuBudget = (int)assetBudget.gpuMegabytes;
+	if (ImGui::SliderInt("GPU Asset Budget (MB)", &gpuBudget, 16, 8192)) {
+		assetBudget.gpuMegabytes = (uint32_t)gpuBudget;
+	}
+	ImGui::Text("Evicted: %u meshes, %u textures", assetStats.evictedMeshes, assetStats.evictedTextures);
+	ImGui::Separator();
+	DynamicResolutionSettings& resolutionSettings = dynamicResolution.settings;
+	ImGui::Checkbox("Dynamic Resolution", &resolutionSettings.enabled);
+	ImGui::SliderFloat("Target GPU Frame (ms)", &resolutionSettings.targetFrameTime, 1.f, 50.f, "%.1f");
+	ImGui::SliderFloat("Min Scale", &resolutionSettings.minScale, 0.25f, 1.f, "%.2f");
+	ImGui::SliderFloat("Max Scale", &resolutionSettings.maxScale, 0.25f, 1.f, "%.2f");
+	ImGui::SliderFloat("Hysteresis", &resolutionSettings.hysteresis, 0.f, 0.5f, "%.2f");
+	ImGui::Text("Render Scale: %.2f (%u x %u)", dynamicResolution.getScale(), renderExtent.width, renderExtent.height);
+	ImGui::Separator();
+	const RenderGraphStats& graphStats = renderGraph.getStats();
+	ImGui::Text("Render Graph Passes: %u (%u culled)", graphStats.passes, graphStats.culledPasses);
+	ImGui::Text("Barriers: %u in %u batches", graphStats.barriers, graphStats.barrierBatches);
+	ImGui::Text("Transient Images: %u", graphStats.transientImages);
+	ImGui::Text("Transient Memory: %.2fMB (%.2fMB saved by aliasing)", graphStats.allocatedBytes / 1048576.f, graphStats.savedBytes() / 1048576.f);
+	ImGui::Separator();
+	const PipelineRegistryStats& pipelineStats = pipelineRegistry.getStats();
+	ImGui::Text("Pipelines: %u compiled, %u reused", pipelineStats.compiled, pipelineStats.reused);
+	ImGui::Text("Pipelines Pending: %u", pipelineStats.pending);
+	ImGui::Text("Last Async Pipeline: %.3fms", pipelineStats.lastAsyncLatency);
+	ImGui::Text("Pipeline Cache: %s, %.2fKB saved", pipelineCache.isWarm() ? "warm" : "cold", pipelineCache.getSavedSize() / 1024.f);
+	//also saved on shutdown, saving reads the whole cache back from the driver and writes the file on this thread
+	if (ImGui::Button("Save Pipeline Cache")) {
+		pipelineCache.save();
+	}
+	if (staticBatchStats.batches > 0) {
+		ImGui::Text("Static Batches: %u (from %u objects)", staticBatchStats.batches, staticBatchStats.sourceObjects);
+		ImGui::Text("Dynamic Objects: %u", staticBatchStats.dynamicObjects);
+		ImGui::Text("Static Batch Memory: %.2fMB (source %.2fMB)", staticBatchStats.batchedBytes / 1048576.f, staticBatchStats.sourceBytes / 1048576.f);
+	}
+	ImGui::End();
+
+	drawMemoryDebug();
+}
+
+void Renderer::drawMemoryDebug() {
+	ImGui::Begin("GPU Memory");
+
+	VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+	vmaGetHeapBudgets(allocator, budgets);
+	const VkPhysicalDeviceMemoryProperties* memoryProperties;
+	vmaGetMemoryProperties(allocator, &memoryProperties);
+
+	ImGui::Text("Budgets: %s", memoryBudgetSupported ? "VK_EXT_memory_budget" : "estimated");
+	VkDeviceSize allocatedBytes = 0;
+	for (uint32_t heap = 0; heap < memoryProperties->memoryHeapCount; ++heap) {
+		const VmaBudget& budget = budgets[heap];
+		const bool deviceLocal = (memoryProperties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		ImGui::Text("Heap %u (%s): %.1fMB / %.1fMB", heap, deviceLocal ? "device" : "host", budget.usage / 1048576.f, budget.budget / 1048576.f);
+		ImGui::ProgressBar(budget.budget > 0 ? (float)budget.usage / budget.budget : 0.f);
+		//what the blocks hold beyond their allocations is free space, mostly holes left by freed resources
+		ImGui::Text("%u allocations, %.2fMB in %u blocks of %.2fMB", budget.statistics.allocationCount, budget.statistics.allocationBytes / 1048576.f, budget.statistics.blockCount, budget.statistics.blockBytes / 1048576.f);
+		allocatedBytes += budget.statistics.allocationBytes;
+	}
+	ImGui::Separator();
+
+	auto allocationSize = [&](VmaAllocation allocation) -> VkDeviceSize {
+		if (allocation == VK_NULL_HANDLE) {
+			return 0;
+		}
+
+		VmaAllocationInfo info;
+		vmaGetAllocationInfo(allocator, allocation, &info);
+		return info.size;
+	};
+
+	VkDeviceSize meshBytes = 0;
+	auto addMesh = [&](const Mesh& mesh) {
+		meshBytes += allocationSize(mesh.vertexBuffer.allocation) + allocationSize(mesh.positionBuffer.allocation) + allocationSize(mesh.indexBuffer.allocation);
+	};
+	meshManager.meshes.forEach(addMesh);
+	for (const std::unique_ptr<Mesh>& mesh : staticBatchMeshes) {
+		addMesh(*mesh);
+	}
+
+	VkDeviceSize textureBytes = 0;
+	textureManager.loadedTextures.forEach([&](const Texture& texture) {
+		textureBytes += allocationSize(texture.image.allocation);
+	});
+
+	VkDeviceSize frameBytes = 0;
+	for (const FrameData& frame : frames) {
+		for (const AllocatedBuffer* buffer : { &frame.cameraBuffer, &frame.modelBuffer, &frame.objectStagingBuffer, &frame.drawCommandBuffer,
+			&frame.lateDrawCommandBuffer, &frame.cullStatsBuffer, &frame.lightBuffer, &frame.clusterBuffer, &frame.lightStatsBuffer, &frame.materialBuffer }) {
+			frameBytes += allocationSize(buffer->allocation);
+		}
+	}
+
+	VkDeviceSize attachmentBytes = renderGraph.getStats().allocatedBytes;
+	for (const AllocatedImage* image : { &depthImage, &depthPyramid, &shadowMap, &shadowCache }) {
+		attachmentBytes += allocationSize(image->allocation);
+	}
+
+	const StagingPoolStats& stagingStats = stagingPool.getStats();
+	const VkDeviceSize categorisedBytes = meshBytes + textureBytes + frameBytes + attachmentBytes + stagingStats.bytes;
+	ImGui::Text("Meshes: %.2fMB", meshBytes / 1048576.f);
+	ImGui::Text("Textures: %.2fMB", textureBytes / 1048576.f);
+	ImGui::Text("Per-frame: %.2fMB", frameBytes / 1048576.f);
+	ImGui::Text("Attachments: %.2fMB", attachmentBytes / 1048576.f);
+	ImGui::Text("Staging: %.2fMB / %.2fMB in %u chunks", stagingStats.bytes / 1048576.f, stagingPool.getCap() / 1048576.f, stagingStats.chunks);
+	ImGui::Text("Staging Chunks: %llu reused, %llu created, %llu stalls", stagingStats.reused, stagingStats.created, stagingStats.stalls);
+	ImGui::Text("Other: %.2fMB", allocatedBytes > categorisedBytes ? (allocatedBytes - categorisedBytes) / 1048576.f : 0.f);
+	ImGui::Separator();
+
+	DefragmentationSettings& defragmentationSettings = memoryDefragmenter.settings;
+	ImGui::Checkbox("Defragment After Evictions", &defragmentationSettings.automatic);
+	ImGui::SliderFloat("Defragmentation Budget (ms)", &defragmentationSettings.timeBudget, 0.1f, 5.f, "%.1f");
+	int maxMegabytes = (int)defragmentationSettings.maxMegabytesPerPass;
+	if (ImGui::SliderInt("Max Pass Size (MB)", &maxMegabytes, 1, 256)) {
+		defragmentationSettings.maxMegabytesPerPass = (uint32_t)maxMegabytes;
+	}
+	if (memoryDefragmenter.isActive()) {
+		ImGui::Text("Defragmenting...");
+	} else if (ImGui::Button("Defragment")) {
+		memoryDefragmenter.start();
+	}
+	const DefragmentationStats& defragmentationStats = memoryDefragmenter.getStats();
+	ImGui::Text("Runs: %u, Passes: %u", defragmentationStats.runs, defragmentationStats.passes);
+	ImGui::Text("Moved: %u (%.2fMB), %u skipped", defragmentationStats.moves, defragmentationStats.bytesMoved / 1048576.f, defragmentationStats.skippedMoves);
+	ImGui::Text("Freed: %.2fMB", defragmentationStats.bytesFreed / 1048576.f);
+	ImGui::End();
+}
+
+void Renderer::setPresentMode(VkPresentModeKHR mode) {
+	if (mode != requestedPresentMode) {
+		requestedPresentMode = mode;
+		presentModeChanged = true;
+	}
+}
+
+const char* Renderer::presentModeName(VkPresentModeKHR mode) {
+	switch (mode) {
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:
+		return "Immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR:
+		return "Mailbox";
+	case VK_PRESENT_MODE_FIFO_KHR:
+		return "FIFO";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+		return "FIFO Relaxed";
+	default:
+		return "Unknown";
+	}
+}
+
+void Renderer::addToModelQueue(Model& model) {
+	modelQueue.push_back(&model);
+}
+
+RenderObjectHandle Renderer::addRenderObject(const Model& model, bool isStatic) {
+	MaterialBindState* bindState = materialManager.getBindState(model.material);
+	if (!bindState) {
+		console->log("[ERROR]: Render object added without a valid material");
+		return {};
+	}
+
+	RenderObjectHandle handle = renderObjects.add({ model.mesh, model.material, bindState, model.transformMatrix, isStatic });
+	if (!handle.isValid()) {
+		console->log("[ERROR]: Render object limit of " + std::to_string(MAX_RENDER_OBJECTS) + " reached");
+	}
+
+	return handle;
+}
+
+void Renderer::updateRenderObjectTransform(RenderObjectHandle handle, const glm::mat4& transform) {
+	renderObjects.setTransform(handle, transform);
+}
+
+void Renderer::updateRenderObjectMaterial(RenderObjectHandle handle, MaterialId material) {
+	MaterialBindState* bindState = materialManager.getBindState(material);
+	if (!bindState) {
+		console->log("[ERROR]: Render object given an invalid material");
+		return;
+	}
+
+	renderObjects.setMaterial(handle, material, bindState);
+}
+
+void Renderer::removeRenderObject(RenderObjectHandle handle) {
+	renderObjects.remove(handle);
+}
+
+uint32_t Renderer::addOccluder(const char* filePath, const glm::mat4& transform) {
+	//the positions are copied out, so the occluder holds no reference and the mesh can be evicted like any other
+	Mesh* mesh = meshManager.getMesh(meshManager.loadMesh(filePath, *pFrameNumber));
+	if (!mesh) {
+		return UINT32_MAX;
+	}
+
+	std::vector<glm::vec3> positions;
+	positions.reserve(mesh->vertices.size());
+	for (const Vertex& vertex : mesh->vertices) {
+		positions.push_back(vertex.position);
+	}
+
+	std::vector<uint32_t> indices = mesh->indices;
+	if (indices.empty()) {
+		indices.resize(mesh->vertices.size());
+		for (uint32_t i = 0; i < (uint32_t)indices.size(); ++i) {
+			indices[i] = i;
+		}
+	}
+
+	return occlusionCuller.addOccluder(positions, indices, transform);
+}
+
+void Renderer::setOccluderTransform(uint32_t occluder, const glm::mat4& transform) {
+	occlusionCuller.setOccluderTransform(occluder, transform);
+}
+
+void Renderer::removeOccluder(uint32_t occluder) {
+	occlusionCuller.removeOccluder(occluder);
+}
+
+uint32_t Renderer::addLight(const Light& light) {
+	uint32_t id = lightManager.add(light);
+	if (id == UINT32_MAX) {
+		console->log("[ERROR]: Light limit of " + std::to_string(MAX_LIGHTS) + " reached");
+	}
+
+	return id;
+}
+
+void Renderer::setLight(uint32_t light, const Light& properties) {
+	lightManager.set(light, properties);
+}
+
+void Renderer::removeLight(uint32_t light) {
+	lightManager.remove(light);
+}
+
+void Renderer::readFrameTimestamps(FrameData& frame) {
+	// the frame's timeline value has already been waited on, so the queries from its last use are complete
+	if (!frame.timestampsWritten) {
+		return;
+	}
+
+	uint64_t timestamps[TIMESTAMP_COUNT];
+	VkResult result = vkGetQueryPoolResults(
+		device, frame.timestampPool, 0, TIMESTAMP_COUNT,
+		sizeof(timestamps), timestamps, sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT
+	);
+
+	if (result != VK_SUCCESS) {
+		return;
+	}
+
+	const float nanosecondsPerTick = GPU_props.limits.timestampPeriod;
+	auto toMilliseconds = [&](uint64_t start, uint64_t end) {
+		return (float)(end - start) * nanosecondsPerTick / 1000000.f;
+	};
+
+	const uint64_t frameStart = timestamps[TIMESTAMP_FRAME];
+	const uint64_t frameEnd = timestamps[TIMESTAMP_FRAME + 1];
+	gpuTimings.depthPrepass = frame.depthPrepassMeasured ? toMilliseconds(timestamps[TIMESTAMP_DEPTH_PREPASS], timestamps[TIMESTAMP_DEPTH_PREPASS + 1]) : 0.f;
+	gpuTimings.mainPass = toMilliseconds(timestamps[TIMESTAMP_MAIN], timestamps[TIMESTAMP_MAIN + 1]);
+	gpuTimings.total = toMilliseconds(frameStart, frameEnd);
+
+	//frames are read back in the order they were submitted, so the gap to the last one is how long the GPU sat waiting for work
+	if (gpuFrameEndValid) {
+		framePacingStats.gpuIdle = frameStart > gpuFrameEnd ? toMilliseconds(gpuFrameEnd, frameStart) : 0.f;
+	}
+	gpuFrameEnd = frameEnd;
+	gpuFrameEndValid = true;
+
+	for (uint32_t cascade = 0; cascade < SHADOW_CASCADES; ++cascade) {
+		gpuTimings.cascades[cascade] = toMilliseconds(timestamps[TIMESTAMP_CASCADES + cascade * 2], timestamps[TIMESTAMP_CASCADES + cascade * 2 + 1]);
+	}
+	if (frame.shadowCacheRefreshed) {
+		gpuTimings.shadowCacheRefresh = toMilliseconds(timestamps[TIMESTAMP_SHADOW_CACHE], timestamps[TIMESTAMP_SHADOW_CACHE + 1]);
+	}
+}
+
+void Renderer::updateRenderExtent() {
+	const float scale = dynamicResolution.update(gpuTimings.total);
+
+	renderExtent.width = std::clamp((uint32_t)std::lround(window->extent.width * scale), 1u, window->extent.width);
+	renderExtent.height = std::clamp((uint32_t)std::lround(window->extent.height * scale), 1u, window->extent.height);
+}
+
+void Renderer::updateSceneBuffers() {
+	int frameIndex = *pFrameNumber % framesInFlight;
+
+	//slice = log(depth) * Z / log(far / near) - Z * log(near) / log(far / near)
+	const float sliceScale = CLUSTER_Z / std::log(camera.farPlane / camera.nearPlane);
+	sceneProps.clusterScale = glm::vec4(
+		(float)CLUSTER_X / renderExtent.width,
+		(float)CLUSTER_Y / renderExtent.height,
+		sliceScale,
+		-sliceScale * std::log(camera.nearPlane)
+	);
+	sceneProps.clusterOptions = glm::uvec4(clusterHeatmapEnabled ? 1 : 0, 0, 0, 0);
+
+	for (uint32_t cascade = 0; cascade < SHADOW_CASCADES; ++cascade) {
+		sceneProps.cascadeMatrices[cascade] = shadowCascades.getCascade(cascade).viewProjection;
+		sceneProps.cascadeSplits[cascade] = shadowCascades.getCascade(cascade).splitDepth;
+	}
+
+	int8_t* sceneData;
+	vmaMapMemory(allocator, scenePropsBuffer.allocation, (void**)&sceneData);
+	sceneData += padUniformBufferSize(sizeof(GPUSceneData)) * frameIndex;
+	memcpy(sceneData, &sceneProps, sizeof(GPUSceneData));
+	vmaUnmapMemory(allocator, scenePropsBuffer.allocation);
+
+	GPUCameraData cameraData;
+	cameraData.view = camera.view();
+	cameraData.projection = camera.projection();
+	cameraData.matrix = camera.matrix();
+	void* data;
+	vmaMapMemory(allocator, getCurrentFrame().cameraBuffer.allocation, &data);
+	memcpy(data, &cameraData, sizeof(GPUCameraData));
+	vmaUnmapMemory(allocator, getCurrentFrame().cameraBuffer.allocation);
+}
+
+void Renderer::uploadDirtyRenderObjects() {
+	const std::vector<uint32_t>& dirtySlots = renderObjects.getDirtySlots();
+	const uint32_t uploadCount = (uint32_t)std::min<size_t>(dirtySlots.size(), MAX_OBJECT_UPLOADS_PER_FRAME);
+	objectsUploadedLastFrame = uploadCount;
+	objectCopyRegions.clear();
+
+	if (uploadCount == 0) {
+		return;
+	}
+	objectCopyRegions.reserve(uploadCount);
+
+	void* stagingData;
+	vmaMapMemory(allocator, getCurrentFrame().objectStagingBuffer.allocation, &stagingData);
+	GPUModelData* stagingSSBO = (GPUModelData*)stagingData;
+
+	// scatter the dirty entries into the persistent buffer, merging runs of neighbouring slots into a single region.
+	// The copy itself is recorded by the render graph, which also keeps it clear of the previous frames' reads
+	for (uint32_t i = 0; i < uploadCount; ++i) {
+		const uint32_t slot = dirtySlots[i];
+		const RenderObject& object = renderObjects.getBySlot(slot);
+		stagingSSBO[i].matrix = object.transformMatrix;
+		stagingSSBO[i].boundsMin = glm::vec4(object.boundsMin, 1.f);
+		stagingSSBO[i].boundsMax = glm::vec4(object.boundsMax, 1.f);
+		stagingSSBO[i].material = object.material;
+
+		const VkDeviceSize srcOffset = i * sizeof(GPUModelData);
+		const VkDeviceSize dstOffset = slot * sizeof(GPUModelData);
+		if (!objectCopyRegions.empty()) {
+			VkBufferCopy& last = objectCopyRegions.back();
+			if (last.srcOffset + last.size == srcOffset && last.dstOffset + last.size == dstOffset) {
+				last.size += sizeof(GPUModelData);
+				continue;
+			}
+		}
+
+		objectCopyRegions.push_back({ srcOffset, dstOffset, sizeof(GPUModelData) });
+	}
+	vmaUnmapMemory(allocator, getCurrentFrame().objectStagingBuffer.allocation);
+
+	renderObjects.clearDirty(uploadCount);
+}
+
+void Renderer::bindMaterial(VkCommandBuffer cmd, MaterialBindState& bindState, VkDescriptorSet modelDescriptor) {
+	const bool useDepthEqual = depthPrepassActive && bindState.depthEqualPipeline != VK_NULL_HANDLE;
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, useDepthEqual ? bindState.depthEqualPipeline : bindState.pipeline);
+
+	uint32_t uniformOffset = padUniformBufferSize(sizeof(GPUSceneData)) * (*pFrameNumber % framesInFlight);
+	vkCmdBindDescriptorSets(
+		cmd, 
+		VK_PIPELINE_BIND_POINT_GRAPHICS, 
+		bindState.pipelineLayout, 
+		0, 1, 
+		&getCurrentFrame().globalDescriptor, 1, &uniformOffset);
+
+	vkCmdBindDescriptorSets(
+		cmd,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		bindState.pipelineLayout,
+		1, 1,
+		&modelDescriptor, 0, nullptr);
+
+	if (bindState.textureSet != VK_NULL_HANDLE) {
+		//texture descriptor
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, bindState.pipelineLayout, 2, 1, &bindState.textureSet, 0, nullptr);
+	}
+}
+
+void Renderer::bindMesh(VkCommandBuffer cmd, Mesh& mesh, bool positionsOnly) {
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(cmd, 0, 1, positionsOnly ? &mesh.positionBuffer.buffer : &mesh.vertexBuffer.buffer, &offset);
+
+	if (!mesh.indices.empty()) {
+		vkCmdBindIndexBuffer(cmd, mesh.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+}
+
+void Renderer::drawMesh(VkCommandBuffer cmd, Mesh& mesh, uint32_t firstInstance) {
+	if (mesh.indices.empty()) {
+		vkCmdDraw(cmd, (uint32_t)mesh.vertices.size(), 1, 0, firstInstance);
+	} else {
+		vkCmdDrawIndexed(cmd, (uint32_t)mesh.indices.size(), 1, 0, 0, firstInstance);
+	}
+}
+
+void Renderer::cullRenderObjects() {
+	const std::vector<uint32_t>& drawOrder = renderObjects.getDrawOrder();
+	const Frustum frustum = camera.frustum();
+
+	visibleRenderObjects.clear();
+	for (uint32_t slot : drawOrder) {
+		const RenderObject& object = renderObjects.getBySlot(slot);
+		if (frustum.intersects(object.boundsMin, object.boundsMax)) {
+			visibleRenderObjects.push_back(slot);
+		}
+	}
+
+	if (occlusionCullingEnabled && occlusionCuller.hasOccluders()) {
+		occlusionCuller.render(camera.matrix());
+
+		// test in chunks across the workers, then compact on this thread so the draw order stays sorted
+		constexpr uint32_t OCCLUSION_TEST_CHUNK = 256;
+		const uint32_t visibleCount = (uint32_t)visibleRenderObjects.size();
+		occludedRenderObjects.assign(visibleCount, 0);
+
+		jobSystem->parallelFor((visibleCount + OCCLUSION_TEST_CHUNK - 1) / OCCLUSION_TEST_CHUNK, [&](uint32_t chunk) {
+			const uint32_t end = std::min((chunk + 1) * OCCLUSION_TEST_CHUNK, visibleCount);
+			for (uint32_t i = chunk * OCCLUSION_TEST_CHUNK; i < end; ++i) {
+				const RenderObject& object = renderObjects.getBySlot(visibleRenderObjects[i]);
+				occludedRenderObjects[i] = occlusionCuller.isOccluded(object.boundsMin, object.boundsMax);
+			}
+		});
+
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < visibleCount; ++i) {
+			if (!occludedRenderObjects[i]) {
+				visibleRenderObjects[kept++] = visibleRenderObjects[i];
+			}
+		}
+		visibleRenderObjects.resize(kept);
+
+		occlusionStats = occlusionCuller.getStats();
+	} else {
+		occlusionStats = {};
+	}
+
+	renderObjectsDrawn = (uint32_t)visibleRenderObjects.size();
+}
+
+void Renderer::drawDepthPrepass(VkCommandBuffer cmd) {
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipeline);
+
+	uint32_t uniformOffset = padUniformBufferSize(sizeof(GPUSceneData)) * (*pFrameNumber % framesInFlight);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipelineLayout, 0, 1, &getCurrentFrame().globalDescriptor, 1, &uniformOffset);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipelineLayout, 1, 1, &objectDescriptor, 0, nullptr);
+
+	Mesh* lastMesh = nullptr;
+	for (uint32_t slot : visibleRenderObjects) {
+		const RenderObject& object = renderObjects.getBySlot(slot);
+		if (object.mesh != lastMesh) {
+			bindMesh(cmd, *object.mesh, true);
+			lastMesh = object.mesh;
+		}
+
+		drawMesh(cmd, *object.mesh, slot);
+	}
+
+	if (modelQueue.empty()) {
+		return;
+	}
+
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipelineLayout, 1, 1, &getCurrentFrame().modelDescriptor, 0, nullptr);
+
+	lastMesh = nullptr;
+	for (uint32_t modelIndex = 0; modelIndex < modelQueue.size(); ++modelIndex) {
+		Model& model = *modelQueue[modelIndex];
+		if (model.mesh != lastMesh) {
+			bindMesh(cmd, *model.mesh, true);
+			lastMesh = model.mesh;
+		}
+
+		drawMesh(cmd, *model.mesh, modelIndex);
+	}
+}
+
+void Renderer::drawShadowCasters(VkCommandBuffer cmd, const std::vector<uint32_t>& casters, const glm::mat4& viewProjection, bool drawModelQueue) {
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipeline);
+	vkCmdPushConstants(cmd, shadowPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &viewProjection);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipelineLayout, 1, 1, &objectDescriptor, 0, nullptr);
+
+	Mesh* lastMesh = nullptr;
+	for (uint32_t slot : casters) {
+		const RenderObject& object = renderObjects.getBySlot(slot);
+		if (object.mesh != lastMesh) {
+			bindMesh(cmd, *object.mesh, true);
+			lastMesh = object.mesh;
+		}
+
+		drawMesh(cmd, *object.mesh, slot);
+	}
+
+	// queued models have no bounds to sort by, so they go into every cascade as dynamic casters
+	if (!drawModelQueue || modelQueue.empty()) {
+		return;
+	}
+
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipelineLayout, 1, 1, &getCurrentFrame().modelDescriptor, 0, nullptr);
+
+	lastMesh = nullptr;
+	for (uint32_t modelIndex = 0; modelIndex < modelQueue.size(); ++modelIndex) {
+		Model& model = *modelQueue[modelIndex];
+		if (model.mesh != lastMesh) {
+			bindMesh(cmd, *model.mesh, true);
+			lastMesh = model.mesh;
+		}
+
+		drawMesh(cmd, *model.mesh, modelIndex);
+	}
+}
+
+void Renderer::drawRenderObjects(VkCommandBuffer cmd) {
+	Mesh* lastMesh = nullptr;
+	MaterialBindState* lastBindState = nullptr;
+
+	for (uint32_t slot : visibleRenderObjects) {
+		const RenderObject& object = renderObjects.getBySlot(slot);
+		if (object.bindState != lastBindState) {
+			bindMaterial(cmd, *object.bindState, objectDescriptor);
+			lastBindState = object.bindState;
+		}
+
+		if (object.mesh != lastMesh) {
+			bindMesh(cmd, *object.mesh);
+			lastMesh = object.mesh;
+		}
+
+		// the slot doubles as the index into the persistent object buffer
+		drawMesh(cmd, *object.mesh, slot);
+	}
+}
+
+void Renderer::writeDrawCommands() {
+	indirectDrawCount = (uint32_t)visibleRenderObjects.size();
+	if (indirectDrawCount == 0) {
+		return;
+	}
+
+	void* data;
+	vmaMapMemory(allocator, getCurrentFrame().drawCommandBuffer.allocation, &data);
+	GPUDrawCommand* commands = (GPUDrawCommand*)data;
+
+	for (uint32_t i = 0; i < indirectDrawCount; ++i) {
+		const uint32_t slot = visibleRenderObjects[i];
+		const Mesh& mesh = *renderObjects.getBySlot(slot).mesh;
+
+		if (mesh.indices.empty()) {
+			commands[i].nonIndexed = { (uint32_t)mesh.vertices.size(), 1, 0, slot };
+		} else {
+			commands[i].indexed = { (uint32_t)mesh.indices.size(), 1, 0, 0, slot };
+		}
+		commands[i].objectIndex = slot;
+	}
+
+	vmaUnmapMemory(allocator, getCurrentFrame().drawCommandBuffer.allocation);
+}
+
+void Renderer::dispatchOcclusionCull(VkCommandBuffer cmd, uint32_t phase) {
+	if (indirectDrawCount == 0) {
+		return;
+	}
+
+	GPUCullConstants constants;
+	constants.viewProjection = camera.matrix();
+	constants.pyramidSize = glm::vec2(depthPyramidWidth, depthPyramidHeight);
+	constants.drawCount = indirectDrawCount;
+	constants.phase = phase;
+	constants.pyramidValid = depthPyramidValid ? 1 : 0;
+
+	if (getCurrentFrame().cullDescriptor == VK_NULL_HANDLE) {
+		return;
+	}
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &getCurrentFrame().cullDescriptor, 0, nullptr);
+	vkCmdPushConstants(cmd, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullConstants), &constants);
+	vkCmdDispatch(cmd, (indirectDrawCount + 63) / 64, 1, 1);
+}
+
+void Renderer::buildDepthPyramid(VkCommandBuffer cmd) {
+	// the render graph has already moved the depth image into a sampled layout, only the mips need syncing here
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramidPipeline);
+
+	for (uint32_t level = 0; level < depthPyramidLevels; ++level) {
+		const uint32_t levelWidth = std::max(depthPyramidWidth >> level, 1u);
+		const uint32_t levelHeight = std::max(depthPyramidHeight >> level, 1u);
+		//only the rendered part of the depth image is stretched over the first level, the levels after it are read whole
+		const glm::vec2 sourceScale = level == 0
+			? glm::vec2((float)renderExtent.width / window->extent.width, (float)renderExtent.height / window->extent.height)
+			: glm::vec2(1.f);
+		const glm::vec4 levelConstants = glm::vec4(levelWidth, levelHeight, sourceScale.x, sourceScale.y);
+
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramidPipelineLayout, 0, 1, &depthPyramidDescriptors[level], 0, nullptr);
+		vkCmdPushConstants(cmd, depthPyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(glm::vec4), &levelConstants);
+		vkCmdDispatch(cmd, (levelWidth + 31) / 32, (levelHeight + 31) / 32, 1);
+
+		// the next level samples this one
+		VkImageMemoryBarrier levelBarrier = {};
+		levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		levelBarrier.pNext = nullptr;
+		levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		levelBarrier.image = depthPyramid.image;
+		levelBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+	}
+
+	depthPyramidValid = true;
+}
+
+void Renderer::drawRenderObjectsIndirect(VkCommandBuffer cmd, VkBuffer drawCommandBuffer) {
+	MaterialBindState* lastBindState = nullptr;
+	const uint32_t drawCount = (uint32_t)visibleRenderObjects.size();
+
+	// the draw order is sorted by bind state then mesh, so every run sharing both becomes one multi draw.
+	// Each draw picks up its own material from the object buffer, so parameters can differ within a run
+	uint32_t runStart = 0;
+	while (runStart < drawCount) {
+		const RenderObject& first = renderObjects.getBySlot(visibleRenderObjects[runStart]);
+
+		uint32_t runEnd = runStart + 1;
+		while (runEnd < drawCount) {
+			const RenderObject& next = renderObjects.getBySlot(visibleRenderObjects[runEnd]);
+			if (next.mesh != first.mesh || next.bindState != first.bindState) {
+				break;
+			}
+			++runEnd;
+		}
+
+		if (first.bindState != lastBindState) {
+			bindMaterial(cmd, *first.bindState, objectDescriptor);
+			lastBindState = first.bindState;
+		}
 
-	isInitialised = true;
-}
+		bindMesh(cmd, *first.mesh);
 
-void Renderer::draw() {
-	VK_CHECK(vkWaitForFences(device, 1, &getCurrentFrame().renderFence, true, ONE_SECOND), *console);
+		const VkDeviceSize offset = runStart * sizeof(GPUDrawCommand);
+		if (first.mesh->indices.empty()) {
+			vkCmdDrawIndirect(cmd, drawCommandBuffer, offset, runEnd - runStart, sizeof(GPUDrawCommand));
+		} else {
+			vkCmdDrawIndexedIndirect(cmd, drawCommandBuffer, offset, runEnd - runStart, sizeof(GPUDrawCommand));
+		}
 
-	uint32_t swapchainImageIndex;
-	VkResult result = vkAcquireNextImageKHR(device, swapchain, ONE_SECOND, getCurrentFrame().presentSemaphore, nullptr, &swapchainImageIndex);
+		runStart = runEnd;
+	}
+}
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
-		recreateSwapchain();
-		framebufferResized = false;
+void Renderer::uploadLights() {
+	FrameData& frame = getCurrentFrame();
+	if (frame.lightVersion == lightManager.getVersion()) {
 		return;
 	}
 
-	VK_CHECK(vkResetFences(device, 1, &getCurrentFrame().renderFence), *console);
-
-	VK_CHECK(vkResetCommandBuffer(getCurrentFrame().mainCommandBuffer, 0), *console);
-	VkCommandBuffer cmd = getCurrentFrame().mainCommandBuffer;
-
-	//begin the command buffer recording. We will use this command buffer exactly once, so we want to let Vulkan know that
-	VkCommandBufferBeginInfo cmdBeginInfo = vkinit::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	const std::vector<GPULight>& packed = lightManager.getPacked();
+	if (!packed.empty()) {
+		void* data;
+		vmaMapMemory(allocator, frame.lightBuffer.allocation, &data);
+		memcpy(data, packed.data(), sizeof(GPULight) * packed.size());
+		vmaUnmapMemory(allocator, frame.lightBuffer.allocation);
+	}
 
-	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo), *console);
-	VkClearValue colorClearValue;
-	colorClearValue.color = { { 0.f, 0.f, 0.f, 1.f } };
+	frame.lightVersion = lightManager.getVersion();
+}
 
-	VkClearValue depthClearValue;
-	depthClearValue.depthStencil.depth = 1.f;
+void Renderer::uploadMaterials() {
+	FrameData& frame = getCurrentFrame();
+	if (frame.materialVersion == materialManager.getVersion()) {
+		return;
+	}
 
-	//start the main renderpass.
-	//We will use the clear color from above, and the framebuffer of the index the swapchain gave us
-	VkRenderPassBeginInfo rpInfo = {};
-	rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	rpInfo.pNext = nullptr;
+	// released ids are copied along with the rest, nothing indexes them until they are handed out again
+	const std::vector<GPUMaterialData>& materials = materialManager.getGPUData();
+	if (!materials.empty()) {
+		void* data;
+		vmaMapMemory(allocator, frame.materialBuffer.allocation, &data);
+		memcpy(data, materials.data(), sizeof(GPUMaterialData) * materials.size());
+		vmaUnmapMemory(allocator, frame.materialBuffer.allocation);
+	}
 
-	rpInfo.renderPass = renderPass;
-	rpInfo.renderArea.offset.x = 0;
-	rpInfo.renderArea.offset.y = 0;
-	rpInfo.renderArea.extent = window->extent;
-	rpInfo.framebuffer = framebuffers[swapchainImageIndex];
+	frame.materialVersion = materialManager.getVersion();
+}
 
-	VkClearValue clearValues[] = { colorClearValue, depthClearValue };
-	rpInfo.clearValueCount = 2;
-	rpInfo.pClearValues = &clearValues[0];
+void Renderer::dispatchLightCull(VkCommandBuffer cmd) {
+	const glm::mat4 projection = camera.projection();
 
-	vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+	GPULightCullConstants constants;
+	constants.view = camera.view();
+	constants.projection = glm::vec4(projection[0][0], projection[1][1], camera.nearPlane, camera.farPlane);
+	constants.lightCount = lightManager.getCount();
 
-	VkViewport viewport {};
-	viewport.x = 0.f;
-	viewport.y = 0.f;
-	viewport.width = window->extent.width;
-	viewport.height = window->extent.height;
-	viewport.minDepth = 0.f;
-	viewport.maxDepth = 1.f;
-	VkRect2D scissor{ {0, 0}, window->extent };
-	vkCmdSetViewport(cmd, 0, 1, &viewport);
-	vkCmdSetScissor(cmd, 0, 1, &scissor);
+	//even without lights the counts still have to be written, the main pass reads them either way
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, lightCullPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, lightCullPipelineLayout, 0, 1, &getCurrentFrame().lightCullDescriptor, 0, nullptr);
+	vkCmdPushConstants(cmd, lightCullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPULightCullConstants), &constants);
+	vkCmdDispatch(cmd, (CLUSTER_COUNT + 63) / 64, 1, 1);
+}
 
-	drawModelsInQueue(cmd);
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+void Renderer::readLightStats(FrameData& frame) {
+	if (!frame.lightStatsWritten) {
+		lightStats = {};
+		return;
+	}
 
-	vkCmdEndRenderPass(cmd);
-	VK_CHECK(vkEndCommandBuffer(cmd), *console);
+	void* data;
+	vmaMapMemory(allocator, frame.lightStatsBuffer.allocation, &data);
+	vmaInvalidateAllocation(allocator, frame.lightStatsBuffer.allocation, 0, VK_WHOLE_SIZE);
+	memcpy(&lightStats, data, sizeof(GPULightStats));
+	vmaUnmapMemory(allocator, frame.lightStatsBuffer.allocation);
+}
 
-	//prepare the submission to the queue.
-	//we want to wait on the _presentSemaphore, as that semaphore is signaled when the swapchain is ready
-	//we will signal the _renderSemaphore, to signal that rendering has finished
+void Renderer::readCullStats(FrameData& frame) {
+	// like the timestamps, the frame's timeline value has already been waited on
+	if (!frame.cullStatsWritten) {
+		gpuCullStats = {};
+		return;
+	}
 
-	VkSubmitInfo submit = {};
-	submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit.pNext = nullptr;
+	void* data;
+	vmaMapMemory(allocator, frame.cullStatsBuffer.allocation, &data);
+	vmaInvalidateAllocation(allocator, frame.cullStatsBuffer.allocation, 0, VK_WHOLE_SIZE);
+	memcpy(&gpuCullStats, data, sizeof(GPUCullStats));
+	vmaUnmapMemory(allocator, frame.cullStatsBuffer.allocation);
+}
 
-	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+void Renderer::buildStaticBatches(float chunkSize) {
+	StaticBatcher batcher;
+	std::vector<RenderObjectHandle> sourceHandles;
+	std::unordered_set<Mesh*> sourceMeshes;
 
-	submit.pWaitDstStageMask = &waitStage;
+	for (uint32_t slot : renderObjects.getDrawOrder()) {
+		const RenderObject& object = renderObjects.getBySlot(slot);
+		if (!object.isStatic || object.isBatch) {
+			continue;
+		}
 
-	submit.waitSemaphoreCount = 1;
-	submit.pWaitSemaphores = &getCurrentFrame().presentSemaphore;
+		batcher.add({ object.mesh, object.material, object.transformMatrix, object.boundsMin, object.boundsMax });
+		sourceHandles.push_back(renderObjects.getHandle(slot));
+		sourceMeshes.insert(object.mesh);
+	}
 
-	submit.signalSemaphoreCount = 1;
-	submit.pSignalSemaphores = &getCurrentFrame().renderSemaphore;
+	if (sourceHandles.empty()) {
+		return;
+	}
 
-	submit.commandBufferCount = 1;
-	submit.pCommandBuffers = &cmd;
+	std::vector<StaticBatch> batches = batcher.build(chunkSize);
 
-	//submit command buffer to the queue and execute it.
-	// _renderFence will now block until the graphic commands finish execution
-	VK_CHECK(vkQueueSubmit(graphicsQueue, 1, &submit, getCurrentFrame().renderFence), *console);
+	//every batch is uploaded before the objects it replaces are removed, so a failed upload leaves the scene as it was
+	for (size_t i = 0; i < batches.size(); ++i) {
+		if (!uploadMesh(*batches[i].mesh)) {
+			console->log("[ERROR]: Failed to upload a static batch, the objects stay unbatched");
+			for (size_t uploaded = 0; uploaded < i; ++uploaded) {
+				releaseMesh(*batches[uploaded].mesh);
+			}
+			return;
+		}
+	}
 
-	// this will put the image we just rendered into the visible window.
-	// we want to wait on the _renderSemaphore for that,
-	// as it's necessary that drawing commands have finished before the image is displayed to the user
-	VkPresentInfoKHR presentInfo = {};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.pNext = nullptr;
+	for (RenderObjectHandle handle : sourceHandles) {
+		renderObjects.remove(handle);
+	}
 
-	presentInfo.pSwapchains = &swapchain;
-	presentInfo.swapchainCount = 1;
+	staticBatchStats.sourceObjects += (uint32_t)sourceHandles.size();
+	for (Mesh* mesh : sourceMeshes) {
+		staticBatchStats.sourceBytes += mesh->vertices.size() * sizeof(Vertex);
+	}
 
-	presentInfo.pWaitSemaphores = &getCurrentFrame().renderSemaphore;
-	presentInfo.waitSemaphoreCount = 1;
+	for (StaticBatch& batch : batches) {
+		// batches stay static so cached shadows keep them, but are marked so that a later call doesn't try to merge them again
+		MaterialBindState* bindState = materialManager.getBindState(batch.material);
+		renderObjects.add({ batch.mesh.get(), batch.material, bindState, glm::mat4{ 1.f }, true, true });
 
-	presentInfo.pImageIndices = &swapchainImageIndex;
+		//batches outlive the models they were merged from, so they keep their material and texture loaded themselves
+		materialManager.acquire(batch.material);
+		auto texture = materialTextures.find(bindState);
+		if (texture != materialTextures.end()) {
+			textureManager.loadedTextures.acquire(texture->second, *pFrameNumber);
+		}
 
-	VK_CHECK(vkQueuePresentKHR(graphicsQueue, &presentInfo), *console);
-}
+		staticBatchStats.batchedBytes += batch.mesh->vertices.size() * sizeof(Vertex) + batch.mesh->indices.size() * sizeof(uint32_t);
+		staticBatchStats.batches++;
+		staticBatchMeshes.push_back(std::move(batch.mesh));
+	}
 
-void Renderer::drawDebug() {
-	ImGui::Begin("Renderer");
-	ImGui::Text("Camera Position: {%.3f, %.3f, %.3f}", camera.position.x, camera.position.y, camera.position.z);
-	ImGui::Text("Camera Rotation: {%.3f, %.3f}", camera.rotation.x, camera.rotation.y);
-	ImGui::End();
-}
+	staticBatchStats.dynamicObjects = renderObjects.getCount() - staticBatchStats.batches;
 
-void Renderer::addToModelQueue(Model& model) {
-	modelQueue.push_back(&model);
+	console->log(
+		"Static batching merged " + std::to_string(sourceHandles.size()) + " objects into " +
+		std::to_string(batches.size()) + " batches, " + std::to_string(staticBatchStats.dynamicObjects) + " dynamic objects remain"
+	);
+	console->log(
+		"Static batch memory: " + std::to_string(staticBatchStats.batchedBytes / 1024) + "KB batched from " +
+		std::to_string(staticBatchStats.sourceBytes / 1024) + "KB of source meshes"
+	);
 }
 
-void Renderer::drawModelsInQueue(VkCommandBuffer cmd) {
+void Renderer::uploadModelQueue() {
 	if (modelQueue.size() == 0) {
 		return;
 	}
 
-	glm::mat4 view = camera.view();
-	glm::mat4 projection = camera.projection();
-
-	Mesh* lastMesh = nullptr;
-	Material* lastMaterial = nullptr;
-	int frameIndex = *pFrameNumber % FRAME_OVERLAP;
-
-	int8_t* sceneData;
-	vmaMapMemory(allocator, scenePropsBuffer.allocation, (void**)&sceneData);
-	sceneData += padUniformBufferSize(sizeof(GPUSceneData)) * frameIndex;
-	memcpy(sceneData, &sceneProps, sizeof(GPUSceneData));
-	vmaUnmapMemory(allocator, scenePropsBuffer.allocation);
-
-	GPUCameraData cameraData;
-	cameraData.view = view;
-	cameraData.projection = projection;
-	cameraData.matrix = camera.matrix();
-	void* data;
-	vmaMapMemory(allocator, getCurrentFrame().cameraBuffer.allocation, &data);
-	memcpy(data, &cameraData, sizeof(GPUCameraData));
-	vmaUnmapMemory(allocator, getCurrentFrame().cameraBuffer.allocation);
-
 	void* modelData;
 	vmaMapMemory(allocator, getCurrentFrame().modelBuffer.allocation, &modelData);
 	GPUModelData* modelSSBO = (GPUModelData*)modelData;
 	for (uint32_t modelIndex = 0; modelIndex < modelQueue.size(); ++modelIndex) {
 		modelSSBO[modelIndex].matrix = modelQueue[modelIndex]->transformMatrix;
+		modelSSBO[modelIndex].material = modelQueue[modelIndex]->material;
 	}
 	vmaUnmapMemory(allocator, getCurrentFrame().modelBuffer.allocation);
+}
 
-	for (uint32_t modelIndex = 0; modelIndex < modelQueue.size(); ++modelIndex) {
-		Model& model = *modelQueue[modelIndex];
-		if (model.material != lastMaterial) {
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, model.material->pipeline);
-
-			uint32_t uniformOffset = padUniformBufferSize(sizeof(GPUSceneData)) * frameIndex;
-			vkCmdBindDescriptorSets(
-				cmd, 
-				VK_PIPELINE_BIND_POINT_GRAPHICS, 
-				model.material->pipelineLayout, 
-				0, 1, 
-				&getCurrentFrame().globalDescriptor, 1, &uniformOffset);
-
-			vkCmdBindDescriptorSets(
-				cmd,
-				VK_PIPELINE_BIND_POINT_GRAPHICS,
-				model.material->pipelineLayout,
-				1, 1,
-				&getCurrentFrame().modelDescriptor, 0, nullptr);
+void Renderer::drawModelsInQueue(VkCommandBuffer cmd) {
+	if (modelQueue.size() == 0) {
+		return;
+	}
 
-			if (model.material->textureSet != VK_NULL_HANDLE) {
-				//texture descriptor
-				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, model.material->pipelineLayout, 2, 1, &model.material->textureSet, 0, nullptr);
+	Mesh* lastMesh = nullptr;
+	MaterialBindState* lastBindState = nullptr;
 
-			}
+	for (uint32_t modelIndex = 0; modelIndex < modelQueue.size(); ++modelIndex) {
+		Model& model = *modelQueue[modelIndex];
+		MaterialBindState* bindState = materialManager.getBindState(model.material);
+		if (!bindState) {
+			continue;
+		}
 
-			lastMaterial = model.material;
+		if (bindState != lastBindState) {
+			bindMaterial(cmd, *bindState, getCurrentFrame().modelDescriptor);
+			lastBindState = bindState;
 		}
 
 		if (model.mesh != lastMesh) {
-			VkDeviceSize offset = 0;
-			vkCmdBindVertexBuffers(cmd, 0, 1, &model.mesh->vertexBuffer.buffer, &offset);
+			bindMesh(cmd, *model.mesh);
 			lastMesh = model.mesh;
 		}
 
-		vkCmdDraw(cmd, (uint32_t)model.mesh->vertices.size(), 1, 0, modelIndex);
+		drawMesh(cmd, *model.mesh, modelIndex);
 	}
 
 	modelQueue.clear();
@@ -281,10 +1582,31 @@ void Renderer::initVulkan() {
 
 	//use vkbootstrap to select a GPU.
 	//We want a GPU that can write to the SDL surface and supports Vulkan 1.1
+	//GPU occlusion culling issues one indirect draw per mesh run with the object slot as firstInstance,
+	//and builds its depth pyramid with a max reduction sampler
+	VkPhysicalDeviceFeatures requiredFeatures = {};
+	requiredFeatures.multiDrawIndirect = VK_TRUE;
+	requiredFeatures.drawIndirectFirstInstance = VK_TRUE;
+
+	VkPhysicalDeviceVulkan12Features requiredFeatures12 = {};
+	requiredFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	requiredFeatures12.samplerFilterMinmax = VK_TRUE;
+
+	//the render graph records all of its barriers with synchronization2
+	VkPhysicalDeviceVulkan13Features requiredFeatures13 = {};
+	requiredFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	requiredFeatures13.synchronization2 = VK_TRUE;
+	//the scene passes render straight into their images, so nothing has to be rebuilt when those images are
+	requiredFeatures13.dynamicRendering = VK_TRUE;
+
 	vkb::PhysicalDeviceSelector selector{ vkb_inst };
 	vkb::PhysicalDevice physicalDevice = selector
 		.set_minimum_version(1, 3)
 		.set_surface(surface)
+		.set_required_features(requiredFeatures)
+		.set_required_features_12(requiredFeatures12)
+		.set_required_features_13(requiredFeatures13)
+		.add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
 		.select()
 		.value();
 
@@ -304,12 +1626,31 @@ void Renderer::initVulkan() {
 	graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
 	graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+	//desired extensions are enabled whenever the device has them
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(GPU, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(GPU, nullptr, &extensionCount, extensions.data());
+	for (const VkExtensionProperties& extension : extensions) {
+		if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+			memoryBudgetSupported = true;
+		}
+	}
+
 	VmaAllocatorCreateInfo allocatorInfo = {};
 
 	allocatorInfo.physicalDevice = GPU;
 	allocatorInfo.device = device;
 	allocatorInfo.instance = instance;
+	allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
+	allocatorInfo.pAllocationCallbacks = allocationtracker::getVulkanCallbacks();
+	allocatorInfo.pDeviceMemoryCallbacks = allocationtracker::getDeviceMemoryCallbacks();
+	if (memoryBudgetSupported) {
+		allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+	}
 	vmaCreateAllocator(&allocatorInfo, &allocator);
+	frameDeletionQueue.init(device, allocator);
+	memoryDefragmenter.init(allocator, *console);
 }
 
 void Renderer::initIMGUI() {
@@ -351,7 +1692,7 @@ void Renderer::initIMGUI() {
 	init_info.ImageCount = 3;
 	init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
-	ImGui_ImplVulkan_Init(&init_info, renderPass);
+	ImGui_ImplVulkan_Init(&init_info, uiRenderPass);
 
 	//execute a gpu command to upload imgui font textures
 	immediateSubmit([&](VkCommandBuffer cmd) {
@@ -369,11 +1710,38 @@ void Renderer::initIMGUI() {
 void Renderer::initSwapchain() {
 	vkb::SwapchainBuilder swapchainBuilder{ GPU, device, surface };
 
+	uint32_t presentModeCount = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(GPU, surface, &presentModeCount, nullptr);
+	std::vector<VkPresentModeKHR> supportedPresentModes(presentModeCount);
+	vkGetPhysicalDeviceSurfacePresentModesKHR(GPU, surface, &presentModeCount, supportedPresentModes.data());
+
+	//mailbox keeps vsync's lack of tearing so it falls back to fifo, immediate would rather keep its low latency and tries mailbox first.
+	//Fifo is the one mode every device has to support
+	std::vector<VkPresentModeKHR> candidates = { requestedPresentMode };
+	if (requestedPresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+		candidates.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+	}
+	candidates.push_back(VK_PRESENT_MODE_FIFO_KHR);
+
+	activePresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	for (VkPresentModeKHR candidate : candidates) {
+		if (std::find(supportedPresentModes.begin(), supportedPresentModes.end(), candidate) != supportedPresentModes.end()) {
+			activePresentMode = candidate;
+			break;
+		}
+	}
+	if (activePresentMode != requestedPresentMode) {
+		console->log("[WARN]: " + std::string(presentModeName(requestedPresentMode)) + " presentation isn't supported, using " + presentModeName(activePresentMode));
+	}
+
+	//handing over the old swapchain lets the driver reuse its resources, and keeps the images it still has queued presentable
 	vkb::Swapchain vkbSwapchain = swapchainBuilder
+		.set_old_swapchain(swapchain)
 		.use_default_format_selection()
-		//use vsync present mode
-		.set_desired_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR)
+		.set_desired_present_mode(activePresentMode)
 		.set_desired_extent(window->extent.width, window->extent.height)
+		//the scene gets blitted in rather than drawn straight into the swapchain
+		.set_image_usage_flags(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT)
 		.build()
 		.value();
 
@@ -392,8 +1760,9 @@ void Renderer::initSwapchain() {
 	//hardcoding the depth format to 32 bit float
 	depthFormat = VK_FORMAT_D32_SFLOAT;
 
-	//the depth image will be an image with the format we selected and Depth Attachment usage flag
-	VkImageCreateInfo dimgInfo = vkinit::imageCreateInfo(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthImageExtent);
+	//the depth image will be an image with the format we selected and Depth Attachment usage flag.
+	//It is also sampled when building the depth pyramid for occlusion culling
+	VkImageCreateInfo dimgInfo = vkinit::imageCreateInfo(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, depthImageExtent);
 
 	//for the depth image, we want to allocate it from GPU local memory
 	VmaAllocationCreateInfo dimg_allocinfo = {};
@@ -405,37 +1774,198 @@ void Renderer::initSwapchain() {
 	VkImageViewCreateInfo dviewInfo = vkinit::imageviewCreateInfo(depthFormat, depthImage.image, VK_IMAGE_ASPECT_DEPTH_BIT);
 
 	VK_CHECK(vkCreateImageView(device, &dviewInfo, nullptr, &depthImageView), *console);
+
+	renderExtent = window->extent;
 }
 
 void Renderer::recreateSwapchain() {
-	cleanupSwapchain();
+	//the frames still in flight keep drawing with the old resources, they are only queued up for deletion here.
+	//The old swapchain handle stays in place until initSwapchain has built the new one from it
 	cleanupFramebuffers();
+	cleanupDepthPyramid();
+	cleanupSwapchain();
 
 	initSwapchain();
 	initFramebuffers();
+	initDepthPyramid();
+
+	framebufferResized = false;
+	presentModeChanged = false;
+	swapchainOutdated = false;
 }
 
 void Renderer::cleanupSwapchain() {
-	vkDestroySwapchainKHR(device, swapchain, nullptr);
-	vkDestroyImageView(device, depthImageView, nullptr);
-	vmaDestroyImage(allocator, depthImage.image, depthImage.allocation);
+	//the swapchain handle itself stays valid until then, initSwapchain still builds the new one from it
+	destroyDeferred(depthImageView);
+	destroyDeferred(depthImage);
+	destroyDeferred(swapchain);
 }
 
-void Renderer::initCommands() {
-	//create a command pool for commands submitted to the graphics queue.
-	//we also want the pool to allow for resetting of individual command buffers
-	VkCommandPoolCreateInfo commandPoolInfo = vkinit::commandPoolCreateInfo(graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+void Renderer::initDepthPyramid() {
+	//the first level is the depth image rounded down to a power of two, so every level after it halves cleanly
+	auto previousPowerOfTwo = [](uint32_t value) {
+		uint32_t result = 1;
+		while (result * 2 <= value) {
+			result *= 2;
+		}
+		return result;
+	};
+
+	depthPyramidWidth = previousPowerOfTwo(window->extent.width);
+	depthPyramidHeight = previousPowerOfTwo(window->extent.height);
+	depthPyramidLevels = 1;
+	while ((std::max(depthPyramidWidth, depthPyramidHeight) >> depthPyramidLevels) > 0) {
+		++depthPyramidLevels;
+	}
 
-	for (uint8_t i = 0; i < FRAME_OVERLAP; ++i) {
-		VK_CHECK(vkCreateCommandPool(device, &commandPoolInfo, nullptr, &frames[i].commandPool), *console);
-		VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::commandBufferAllocateInfo(frames[i].commandPool, 1);
-		VK_CHECK(vkAllocateCommandBuffers(device, &cmdAllocInfo, &frames[i].mainCommandBuffer), *console);
+	VkExtent3D pyramidExtent = { depthPyramidWidth, depthPyramidHeight, 1 };
+	VkImageCreateInfo pyramidInfo = vkinit::imageCreateInfo(VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, pyramidExtent);
+	pyramidInfo.mipLevels = depthPyramidLevels;
 
-		mainDeletionQueue.pushFunction([=]() {
-			vkDestroyCommandPool(device, frames[i].commandPool, nullptr);
-		});
+	VmaAllocationCreateInfo pyramidAllocInfo = {};
+	pyramidAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	VK_CHECK(vmaCreateImage(allocator, &pyramidInfo, &pyramidAllocInfo, &depthPyramid.image, &depthPyramid.allocation, nullptr), *console);
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageviewCreateInfo(VK_FORMAT_R32_SFLOAT, depthPyramid.image, VK_IMAGE_ASPECT_COLOR_BIT);
+	viewInfo.subresourceRange.levelCount = depthPyramidLevels;
+	VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &depthPyramidView), *console);
+
+	depthPyramidMips.resize(depthPyramidLevels);
+	for (uint32_t level = 0; level < depthPyramidLevels; ++level) {
+		viewInfo.subresourceRange.baseMipLevel = level;
+		viewInfo.subresourceRange.levelCount = 1;
+		VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &depthPyramidMips[level]), *console);
+	}
+
+	//the pyramid is both written as a storage image and sampled every frame, so once the render graph has moved it into the general layout it stays there.
+	//Leaving that to the graph means a resize doesn't have to wait on a submit of its own
+	depthPyramidLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	//one set per level, so the pool lives and dies with the pyramid
+	std::vector<VkDescriptorPoolSize> sizes =
+	{
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, depthPyramidLevels },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depthPyramidLevels }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = 0;
+	poolInfo.maxSets = depthPyramidLevels;
+	poolInfo.poolSizeCount = (uint32_t)sizes.size();
+	poolInfo.pPoolSizes = sizes.data();
+	VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &depthPyramidDescriptorPool), *console);
+
+	std::vector<VkDescriptorSetLayout> setLayouts(depthPyramidLevels, depthPyramidSetLayout);
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.pNext = nullptr;
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = depthPyramidDescriptorPool;
+	allocateInfo.descriptorSetCount = depthPyramidLevels;
+	allocateInfo.pSetLayouts = setLayouts.data();
+
+	depthPyramidDescriptors.resize(depthPyramidLevels);
+	VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, depthPyramidDescriptors.data()), *console);
+
+	for (uint32_t level = 0; level < depthPyramidLevels; ++level) {
+		descriptorWriter.writeImage(
+			depthPyramidDescriptors[level], 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, depthPyramidMips[level], VK_IMAGE_LAYOUT_GENERAL
+		);
+
+		//the first level reads the depth image itself, every other level the one above it
+		if (level == 0) {
+			descriptorWriter.writeImage(
+				depthPyramidDescriptors[level], 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depthPyramidSampler, depthImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			);
+		} else {
+			descriptorWriter.writeImage(
+				depthPyramidDescriptors[level], 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depthPyramidSampler, depthPyramidMips[level - 1], VK_IMAGE_LAYOUT_GENERAL
+			);
+		}
+	}
+	//the sets are new, nothing can be reading them yet. the frames' cull sets are written every frame, so they pick the new pyramid up on their own
+	descriptorWriter.flush();
+
+	//a fresh pyramid holds nothing yet, so the first phase draws everything until it has been built once
+	depthPyramidValid = false;
+}
+
+void Renderer::cleanupDepthPyramid() {
+	destroyDeferred(depthPyramidDescriptorPool);
+
+	for (VkImageView mip : depthPyramidMips) {
+		destroyDeferred(mip);
+	}
+	depthPyramidMips.clear();
+
+	destroyDeferred(depthPyramidView);
+	destroyDeferred(depthPyramid);
+}
+
+void Renderer::initShadows() {
+	shadowCascades.init(SHADOW_MAP_RESOLUTION);
+
+	VkExtent3D shadowExtent = { SHADOW_MAP_RESOLUTION, SHADOW_MAP_RESOLUTION, 1 };
+	VmaAllocationCreateInfo shadowAllocInfo = {};
+	shadowAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	//one layer per cascade, the cached layers get their static depth copied in before the dynamic casters are drawn
+	VkImageCreateInfo shadowMapInfo = vkinit::imageCreateInfo(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, shadowExtent);
+	shadowMapInfo.arrayLayers = SHADOW_CASCADES;
+	VK_CHECK(vmaCreateImage(allocator, &shadowMapInfo, &shadowAllocInfo, &shadowMap.image, &shadowMap.allocation, nullptr), *console);
+
+	VkImageCreateInfo shadowCacheInfo = vkinit::imageCreateInfo(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, shadowExtent);
+	shadowCacheInfo.arrayLayers = SHADOW_CACHED_CASCADES;
+	VK_CHECK(vmaCreateImage(allocator, &shadowCacheInfo, &shadowAllocInfo, &shadowCache.image, &shadowCache.allocation, nullptr), *console);
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageviewCreateInfo(depthFormat, shadowMap.image, VK_IMAGE_ASPECT_DEPTH_BIT);
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	viewInfo.subresourceRange.layerCount = SHADOW_CASCADES;
+	VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &shadowMapView), *console);
+
+	//every cascade renders into its own layer
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.subresourceRange.layerCount = 1;
+	for (uint32_t cascade = 0; cascade < SHADOW_CASCADES; ++cascade) {
+		viewInfo.subresourceRange.baseArrayLayer = cascade;
+		VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &shadowLayerViews[cascade]), *console);
+	}
+
+	viewInfo.image = shadowCache.image;
+	for (uint32_t layer = 0; layer < SHADOW_CACHED_CASCADES; ++layer) {
+		viewInfo.subresourceRange.baseArrayLayer = layer;
+		VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &shadowCacheLayerViews[layer]), *console);
 	}
+	shadowCacheLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	//hardware depth comparison with linear filtering gives every tap a 2x2 PCF for free. Outside the map counts as lit
+	VkSamplerCreateInfo shadowSamplerInfo = vkinit::samplerCreateInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER);
+	shadowSamplerInfo.compareEnable = VK_TRUE;
+	shadowSamplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	shadowSamplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	shadowSamplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	VK_CHECK(vkCreateSampler(device, &shadowSamplerInfo, nullptr, &shadowSampler), *console);
+	//the frames pick the map up in writeFrameImageDescriptors
+
+	mainDeletionQueue.pushFunction([=]() {
+		vkDestroySampler(device, shadowSampler, nullptr);
 
+		for (uint32_t layer = 0; layer < SHADOW_CACHED_CASCADES; ++layer) {
+			vkDestroyImageView(device, shadowCacheLayerViews[layer], nullptr);
+		}
+
+		for (uint32_t cascade = 0; cascade < SHADOW_CASCADES; ++cascade) {
+			vkDestroyImageView(device, shadowLayerViews[cascade], nullptr);
+		}
+
+		vkDestroyImageView(device, shadowMapView, nullptr);
+		vmaDestroyImage(allocator, shadowCache.image, shadowCache.allocation);
+		vmaDestroyImage(allocator, shadowMap.image, shadowMap.allocation);
+	});
+}
+
+void Renderer::initCommands() {
+	//the frames' own command pools are created with the rest of their resources in initFrames
 	VkCommandPoolCreateInfo uploadCommandPoolInfo = vkinit::commandPoolCreateInfo(graphicsQueueFamily);
 	VK_CHECK(vkCreateCommandPool(device, &uploadCommandPoolInfo, nullptr, &uploadContext.commandPool), *console);
 
@@ -451,30 +1981,18 @@ void Renderer::initCommands() {
 }
 
 void Renderer::initDefaultRenderpass() {
+	//the scene passes all use dynamic rendering, only the imgui backend still needs a render pass to draw with
 	VkAttachmentDescription colorAttachment = {};
 	colorAttachment.format = swapchainImageFormat;
 	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	//the ui draws over the upscaled scene, which the render graph has already moved into the attachment layout
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
 	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	VkAttachmentDescription depthAttachment = {};
-	depthAttachment.flags = 0;
-	depthAttachment.format = depthFormat;
-	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	VkAttachmentReference depthAttachmentRef = {};
-	depthAttachmentRef.attachment = 1;
-	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	//the render graph moves the image on to presenting
+	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentReference colorAttachmentRef = {};
 	colorAttachmentRef.attachment = 0;
@@ -484,9 +2002,6 @@ void Renderer::initDefaultRenderpass() {
 	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colorAttachmentRef;
-	subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-	VkAttachmentDescription attachments[2] = { colorAttachment, depthAttachment };
 
 	VkSubpassDependency dependency = {};
 	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
@@ -496,40 +2011,30 @@ void Renderer::initDefaultRenderpass() {
 	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
-	VkSubpassDependency depthDependency = {};
-	depthDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	depthDependency.dstSubpass = 0;
-	depthDependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	depthDependency.srcAccessMask = 0;
-	depthDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	depthDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-	VkSubpassDependency dependencies[2] = { dependency, depthDependency };
+	VkRenderPassCreateInfo uiPassInfo = {};
+	uiPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 
-	VkRenderPassCreateInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	uiPassInfo.attachmentCount = 1;
+	uiPassInfo.pAttachments = &colorAttachment;
+	uiPassInfo.subpassCount = 1;
+	uiPassInfo.pSubpasses = &subpass;
+	uiPassInfo.dependencyCount = 1;
+	uiPassInfo.pDependencies = &dependency;
 
-	renderPassInfo.attachmentCount = 2;
-	renderPassInfo.pAttachments = &attachments[0];
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 2;
-	renderPassInfo.pDependencies = &dependencies[0];
-
-	VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass), *console);
+	VK_CHECK(vkCreateRenderPass(device, &uiPassInfo, nullptr, &uiRenderPass), *console);
 
 	mainDeletionQueue.pushFunction([=]() {
-		vkDestroyRenderPass(device, renderPass, nullptr);
+		vkDestroyRenderPass(device, uiRenderPass, nullptr);
 	});
 }
 
 void Renderer::initFramebuffers() {
-	//create the framebuffers for the swapchain images. This will connect the render-pass to the images for rendering
+	//only the ui draws into the swapchain images through a framebuffer, the scene gets blitted in
 	VkFramebufferCreateInfo fb_info = {};
 	fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 	fb_info.pNext = nullptr;
 
-	fb_info.renderPass = renderPass;
+	fb_info.renderPass = uiRenderPass;
 	fb_info.attachmentCount = 1;
 	fb_info.width = window->extent.width;
 	fb_info.height = window->extent.height;
@@ -541,29 +2046,19 @@ void Renderer::initFramebuffers() {
 
 	//create framebuffers for each of the swapchain image views
 	for (uint32_t i = 0; i < swapchain_imagecount; i++) {
-		VkImageView attachments[2];
-		attachments[0] = swapchainImageViews[i];
-		attachments[1] = depthImageView;
-
-		fb_info.pAttachments = attachments;
-		fb_info.attachmentCount = 2;
+		fb_info.pAttachments = &swapchainImageViews[i];
 		VK_CHECK(vkCreateFramebuffer(device, &fb_info, nullptr, &framebuffers[i]), *console);
 	}
 }
 
 void Renderer::cleanupFramebuffers() {
-	const uint32_t swapchain_imagecount = (uint32_t)swapchainImages.size();
-
-	for (uint32_t i = 0; i < swapchain_imagecount; i++) {
-		vkDestroyFramebuffer(device, framebuffers[i], nullptr);
-		vkDestroyImageView(device, swapchainImageViews[i], nullptr);
+	for (size_t i = 0; i < framebuffers.size(); i++) {
+		destroyDeferred(framebuffers[i]);
+		destroyDeferred(swapchainImageViews[i]);
 	}
 }
 
 void Renderer::initSyncStructure() {
-	VkFenceCreateInfo fenceCreateInfo = vkinit::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-	VkSemaphoreCreateInfo semaphoreCreateInfo = vkinit::semaphoreCreateInfo();
-
 	VkFenceCreateInfo uploadFenceCreateInfo = vkinit::fenceCreateInfo();
 
 	VK_CHECK(vkCreateFence(device, &uploadFenceCreateInfo, nullptr, &uploadContext.uploadFence), *console);
@@ -571,40 +2066,38 @@ void Renderer::initSyncStructure() {
 		vkDestroyFence(device, uploadContext.uploadFence, nullptr);
 	});
 
-	for (uint8_t i = 0; i < FRAME_OVERLAP; ++i) {
-		VK_CHECK(vkCreateFence(device, &fenceCreateInfo, nullptr, &frames[i].renderFence), *console);
+	//staging chunks are handed out again once the upload fence has been seen to pass the submit reading them
+	stagingPool.init(allocator, STAGING_MEMORY_CAP);
+	mainDeletionQueue.pushFunction([=]() {
+		stagingPool.cleanup();
+	});
 
-		mainDeletionQueue.pushFunction([=]() {
-			vkDestroyFence(device, frames[i].renderFence, nullptr);
-		});
+	//every submitted frame signals the next value, a frame's resources are free again once the value it signalled is reached
+	VkSemaphoreTypeCreateInfo timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.pNext = nullptr;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = 0;
 
-		VK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frames[i].presentSemaphore), *console);
-		VK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frames[i].renderSemaphore), *console);
+	VkSemaphoreCreateInfo timelineCreateInfo = vkinit::semaphoreCreateInfo();
+	timelineCreateInfo.pNext = &timelineInfo;
 
-		mainDeletionQueue.pushFunction([=]() {
-			vkDestroySemaphore(device, frames[i].presentSemaphore, nullptr);
-			vkDestroySemaphore(device, frames[i].renderSemaphore, nullptr);
-		});
-	}
+	VK_CHECK(vkCreateSemaphore(device, &timelineCreateInfo, nullptr, &frameTimeline), *console);
+	mainDeletionQueue.pushFunction([=]() {
+		vkDestroySemaphore(device, frameTimeline, nullptr);
+	});
 }
 
 void Renderer::initDescriptors() {
-	std::vector<VkDescriptorPoolSize> sizes =
-	{
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10 },
-		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10 },
-		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10 }
-	};
-
-	VkDescriptorPoolCreateInfo pool_info = {};
-	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	pool_info.flags = 0;
-	pool_info.maxSets = 10;
-	pool_info.poolSizeCount = (uint32_t)sizes.size();
-	pool_info.pPoolSizes = sizes.data();
-
-	vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptorPool);
+	//most of these sets are material textures, the pools grow as more materials are loaded
+	descriptorAllocator.init(device, 64, {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0.25f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0.25f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0.5f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.f }
+	});
+	descriptorLayoutCache.init(device);
+	descriptorWriter.init(device, *console);
 
 	VkDescriptorSetLayoutBinding cameraBufferBinding = vkinit::descriptorsetLayoutBinding(
 		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
@@ -621,12 +2114,35 @@ void Renderer::initDescriptors() {
 		VK_SHADER_STAGE_VERTEX_BIT, 0
 	);
 
-	VkDescriptorSetLayoutBinding bindings[] = { cameraBufferBinding, scenePropsBufferBinding };
+	//the frame's lights and the clusters they were binned into, read when shading
+	VkDescriptorSetLayoutBinding lightBufferBinding = vkinit::descriptorsetLayoutBinding(
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_SHADER_STAGE_FRAGMENT_BIT, 2
+	);
+
+	VkDescriptorSetLayoutBinding clusterBufferBinding = vkinit::descriptorsetLayoutBinding(
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_SHADER_STAGE_FRAGMENT_BIT, 3
+	);
+
+	//the sun's shadow cascades, written in initShadows once the image exists
+	VkDescriptorSetLayoutBinding shadowMapBinding = vkinit::descriptorsetLayoutBinding(
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		VK_SHADER_STAGE_FRAGMENT_BIT, 4
+	);
+
+	//every material's parameters, indexed by the material in the object buffer
+	VkDescriptorSetLayoutBinding materialBufferBinding = vkinit::descriptorsetLayoutBinding(
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_SHADER_STAGE_FRAGMENT_BIT, 5
+	);
+
+	VkDescriptorSetLayoutBinding bindings[] = { cameraBufferBinding, scenePropsBufferBinding, lightBufferBinding, clusterBufferBinding, shadowMapBinding, materialBufferBinding };
 
 	VkDescriptorSetLayoutCreateInfo setinfo = {};
 	setinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	setinfo.pNext = nullptr;
-	setinfo.bindingCount = 2;
+	setinfo.bindingCount = (uint32_t)std::size(bindings);
 	setinfo.flags = 0;
 	setinfo.pBindings = bindings;
 
@@ -637,106 +2153,275 @@ void Renderer::initDescriptors() {
 	modelSetInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	modelSetInfo.pBindings = &modelBufferBinding;
 
-	vkCreateDescriptorSetLayout(device, &setinfo, nullptr, &globalSetLayout);
-	vkCreateDescriptorSetLayout(device, &modelSetInfo, nullptr, &modelSetLayout);
+	globalSetLayout = descriptorLayoutCache.createLayout(setinfo);
+	modelSetLayout = descriptorLayoutCache.createLayout(modelSetInfo);
+
+	VkDescriptorSetLayoutBinding cullBindings[] = {
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+	};
+
+	VkDescriptorSetLayoutCreateInfo cullSetInfo = {};
+	cullSetInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	cullSetInfo.pNext = nullptr;
+	cullSetInfo.flags = 0;
+	cullSetInfo.bindingCount = (uint32_t)std::size(cullBindings);
+	cullSetInfo.pBindings = cullBindings;
+
+	cullSetLayout = descriptorLayoutCache.createLayout(cullSetInfo);
+
+	VkDescriptorSetLayoutBinding depthPyramidBindings[] = {
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+	};
+
+	VkDescriptorSetLayoutCreateInfo depthPyramidSetInfo = cullSetInfo;
+	depthPyramidSetInfo.bindingCount = (uint32_t)std::size(depthPyramidBindings);
+	depthPyramidSetInfo.pBindings = depthPyramidBindings;
+
+	depthPyramidSetLayout = descriptorLayoutCache.createLayout(depthPyramidSetInfo);
+
+	VkDescriptorSetLayoutBinding lightCullBindings[] = {
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+	};
+
+	VkDescriptorSetLayoutCreateInfo lightCullSetInfo = cullSetInfo;
+	lightCullSetInfo.bindingCount = (uint32_t)std::size(lightCullBindings);
+	lightCullSetInfo.pBindings = lightCullBindings;
+
+	lightCullSetLayout = descriptorLayoutCache.createLayout(lightCullSetInfo);
+
+	//a max reduction sampler returns the furthest depth under its footprint instead of blending it
+	VkSamplerReductionModeCreateInfo reductionInfo = {};
+	reductionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO;
+	reductionInfo.pNext = nullptr;
+	reductionInfo.reductionMode = VK_SAMPLER_REDUCTION_MODE_MAX;
+
+	VkSamplerCreateInfo depthPyramidSamplerInfo = vkinit::samplerCreateInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	depthPyramidSamplerInfo.pNext = &reductionInfo;
+	depthPyramidSamplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	depthPyramidSamplerInfo.minLod = 0.f;
+	depthPyramidSamplerInfo.maxLod = 16.f;
+
+	VK_CHECK(vkCreateSampler(device, &depthPyramidSamplerInfo, nullptr, &depthPyramidSampler), *console);
+
+	// render objects live in a single device local buffer that is only written to through copies from the per frame staging buffers
+	objectBuffer = createBuffer(
+		sizeof(GPUModelData) * MAX_RENDER_OBJECTS,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	objectDescriptor = descriptorAllocator.allocate(modelSetLayout);
+
+	descriptorWriter.writeBuffer(objectDescriptor, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objectBuffer.buffer, 0, sizeof(GPUModelData) * MAX_RENDER_OBJECTS);
+	descriptorWriter.flush();
+
+	VkDescriptorSetLayoutBinding textureBind = vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+
+	VkDescriptorSetLayoutCreateInfo textureSetInfo = {};
+	textureSetInfo.bindingCount = 1;
+	textureSetInfo.flags = 0;
+	textureSetInfo.pNext = nullptr;
+	textureSetInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	textureSetInfo.pBindings = &textureBind;
+
+	singleTextureSetLayout = descriptorLayoutCache.createLayout(textureSetInfo);
+	textureSetTemplate = descriptorWriter.createTemplate(singleTextureSetLayout, &textureBind, 1);
+
+	VkSamplerCreateInfo textureSamplerInfo = vkinit::samplerCreateInfo(VK_FILTER_NEAREST);
+	VK_CHECK(vkCreateSampler(device, &textureSamplerInfo, nullptr, &textureSampler), *console);
+
+	mainDeletionQueue.pushFunction([&]() {
+		vkDestroySampler(device, textureSampler, nullptr);
+		vkDestroySampler(device, depthPyramidSampler, nullptr);
+		descriptorWriter.cleanup();
+		descriptorLayoutCache.cleanup();
+		descriptorAllocator.cleanup();
+
+		vmaDestroyBuffer(allocator, objectBuffer.buffer, objectBuffer.allocation);
+	});
+}
+
+void Renderer::initFrames() {
+	frames.resize(framesInFlight);
+
+	//sized for the global, model, cull and light cull set of each frame, so the first pool fits them all
+	frameDescriptors.init(device, 4 * framesInFlight, {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0.25f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0.25f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0.5f }
+	});
+
+	const size_t scenePropsBufferSize = framesInFlight * padUniformBufferSize(sizeof(GPUSceneData));
+	scenePropsBuffer = createBuffer(scenePropsBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+	//create a command pool for commands submitted to the graphics queue.
+	//we also want the pool to allow for resetting of individual command buffers
+	VkCommandPoolCreateInfo commandPoolInfo = vkinit::commandPoolCreateInfo(graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vkinit::semaphoreCreateInfo();
+
+	for (FrameData& frame : frames) {
+		VK_CHECK(vkCreateCommandPool(device, &commandPoolInfo, nullptr, &frame.commandPool), *console);
+		VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::commandBufferAllocateInfo(frame.commandPool, 1);
+		VK_CHECK(vkAllocateCommandBuffers(device, &cmdAllocInfo, &frame.mainCommandBuffer), *console);
 
-	const size_t scenePropsBufferSize = FRAME_OVERLAP * padUniformBufferSize(sizeof(GPUSceneData));
-	scenePropsBuffer = createBuffer(scenePropsBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.pNext = nullptr;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = TIMESTAMP_COUNT;
+		VK_CHECK(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &frame.timestampPool), *console);
 
-	for (uint8_t i = 0; i < FRAME_OVERLAP; ++i) {
-		frames[i].cameraBuffer = createBuffer(
+		//presenting still needs binary semaphores, the timeline only replaces the fence
+		VK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.presentSemaphore), *console);
+		VK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.renderSemaphore), *console);
+
+		frame.cameraBuffer = createBuffer(
 			sizeof(GPUCameraData), 
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
 			VMA_MEMORY_USAGE_CPU_TO_GPU
 		);
 
-		frames[i].modelBuffer = createBuffer(
+		frame.modelBuffer = createBuffer(
 			sizeof(GPUModelData) * MAX_RENDERABLE_OBJECTS,
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 			VMA_MEMORY_USAGE_CPU_TO_GPU
 		);
 
-		VkDescriptorSetAllocateInfo allocateInfo = {};
-		allocateInfo.pNext = nullptr;
-		allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocateInfo.descriptorPool = descriptorPool;
-		allocateInfo.descriptorSetCount = 1;
-		allocateInfo.pSetLayouts = &globalSetLayout;
-
-		vkAllocateDescriptorSets(device, &allocateInfo, &frames[i].globalDescriptor);
-
-		VkDescriptorSetAllocateInfo modelSetAllocateInfo = {};
-		modelSetAllocateInfo.pNext = nullptr;
-		modelSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		modelSetAllocateInfo.descriptorPool = descriptorPool;
-		modelSetAllocateInfo.descriptorSetCount = 1;
-		modelSetAllocateInfo.pSetLayouts = &modelSetLayout;
-
-		vkAllocateDescriptorSets(device, &modelSetAllocateInfo, &frames[i].modelDescriptor);
-
-		VkDescriptorBufferInfo cameraInfo;
-		cameraInfo.buffer = frames[i].cameraBuffer.buffer;
-		cameraInfo.offset = 0;
-		cameraInfo.range = sizeof(GPUCameraData);
-
-		VkDescriptorBufferInfo sceneInfo;
-		sceneInfo.buffer = scenePropsBuffer.buffer;
-		sceneInfo.offset = 0;
-		sceneInfo.range = sizeof(GPUSceneData);
-
-		VkDescriptorBufferInfo objectBufferInfo;
-		objectBufferInfo.buffer = frames[i].modelBuffer.buffer;
-		objectBufferInfo.offset = 0;
-		objectBufferInfo.range = sizeof(GPUModelData) * MAX_RENDERABLE_OBJECTS;
-
-		VkWriteDescriptorSet cameraWrite = vkinit::writeDescriptorBuffer(
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 
-			frames[i].globalDescriptor, &cameraInfo, 0
+		frame.objectStagingBuffer = createBuffer(
+			sizeof(GPUModelData) * MAX_OBJECT_UPLOADS_PER_FRAME,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VMA_MEMORY_USAGE_CPU_ONLY
+		);
+
+		frame.drawCommandBuffer = createBuffer(
+			sizeof(GPUDrawCommand) * MAX_RENDER_OBJECTS,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU
+		);
+
+		// only ever written by the second phase of the cull
+		frame.lateDrawCommandBuffer = createBuffer(
+			sizeof(GPUDrawCommand) * MAX_RENDER_OBJECTS,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY
+		);
+
+		frame.cullStatsBuffer = createBuffer(
+			sizeof(GPUCullStats),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_TO_CPU
+		);
+
+		frame.lightBuffer = createBuffer(
+			sizeof(GPULight) * MAX_LIGHTS,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU
+		);
+
+		frame.materialBuffer = createBuffer(
+			sizeof(GPUMaterialData) * MAX_MATERIALS,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU
 		);
 
-		VkWriteDescriptorSet sceneWrite = vkinit::writeDescriptorBuffer(
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-			frames[i].globalDescriptor, &sceneInfo, 1
+		// a count per cluster followed by a fixed number of light index slots for each one
+		frame.clusterBuffer = createBuffer(
+			sizeof(uint32_t) * CLUSTER_COUNT * (1 + MAX_LIGHTS_PER_CLUSTER),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY
 		);
 
-		VkWriteDescriptorSet modelWrite = vkinit::writeDescriptorBuffer(
-			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 
-			frames[i].modelDescriptor, 
-			&objectBufferInfo, 0
+		frame.lightStatsBuffer = createBuffer(
+			sizeof(GPULightStats),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_TO_CPU
 		);
 
+		//pools are only created once the frame allocates its first transient set
+		frame.transientDescriptors.init(device, 16, {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.f }
+		});
+
+		frame.globalDescriptor = frameDescriptors.allocate(globalSetLayout);
+		frame.modelDescriptor = frameDescriptors.allocate(modelSetLayout);
+
+		descriptorWriter.writeBuffer(frame.globalDescriptor, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame.cameraBuffer.buffer, 0, sizeof(GPUCameraData));
+		descriptorWriter.writeBuffer(frame.globalDescriptor, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, scenePropsBuffer.buffer, 0, sizeof(GPUSceneData));
+		descriptorWriter.writeBuffer(frame.globalDescriptor, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.lightBuffer.buffer, 0, sizeof(GPULight) * MAX_LIGHTS);
+		descriptorWriter.writeBuffer(frame.globalDescriptor, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.clusterBuffer.buffer, 0, VK_WHOLE_SIZE);
+		descriptorWriter.writeBuffer(frame.globalDescriptor, 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.materialBuffer.buffer, 0, sizeof(GPUMaterialData) * MAX_MATERIALS);
+		descriptorWriter.writeBuffer(frame.modelDescriptor, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.modelBuffer.buffer, 0, sizeof(GPUModelData) * MAX_RENDERABLE_OBJECTS);
 
-		VkWriteDescriptorSet setWrites[] = { cameraWrite, sceneWrite, modelWrite };
-		vkUpdateDescriptorSets(device, 3, setWrites, 0, nullptr);
+		frame.lightCullDescriptor = frameDescriptors.allocate(lightCullSetLayout);
+		descriptorWriter.writeBuffer(frame.lightCullDescriptor, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.lightBuffer.buffer, 0, sizeof(GPULight) * MAX_LIGHTS);
+		descriptorWriter.writeBuffer(frame.lightCullDescriptor, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.clusterBuffer.buffer, 0, VK_WHOLE_SIZE);
+		descriptorWriter.writeBuffer(frame.lightCullDescriptor, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.lightStatsBuffer.buffer, 0, sizeof(GPULightStats));
 	}
+	//every frame's sets in one call, they are new so nothing is reading them
+	descriptorWriter.flush();
+}
 
-	VkDescriptorSetLayoutBinding textureBind = vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+void Renderer::cleanupFrames() {
+	for (FrameData& frame : frames) {
+		vkDestroyCommandPool(device, frame.commandPool, nullptr);
+		vkDestroyQueryPool(device, frame.timestampPool, nullptr);
+		vkDestroySemaphore(device, frame.presentSemaphore, nullptr);
+		vkDestroySemaphore(device, frame.renderSemaphore, nullptr);
+
+		vmaDestroyBuffer(allocator, frame.cameraBuffer.buffer, frame.cameraBuffer.allocation);
+		vmaDestroyBuffer(allocator, frame.modelBuffer.buffer, frame.modelBuffer.allocation);
+		vmaDestroyBuffer(allocator, frame.objectStagingBuffer.buffer, frame.objectStagingBuffer.allocation);
+		vmaDestroyBuffer(allocator, frame.drawCommandBuffer.buffer, frame.drawCommandBuffer.allocation);
+		vmaDestroyBuffer(allocator, frame.lateDrawCommandBuffer.buffer, frame.lateDrawCommandBuffer.allocation);
+		vmaDestroyBuffer(allocator, frame.cullStatsBuffer.buffer, frame.cullStatsBuffer.allocation);
+		vmaDestroyBuffer(allocator, frame.lightBuffer.buffer, frame.lightBuffer.allocation);
+		vmaDestroyBuffer(allocator, frame.materialBuffer.buffer, frame.materialBuffer.allocation);
+		vmaDestroyBuffer(allocator, frame.clusterBuffer.buffer, frame.clusterBuffer.allocation);
+		vmaDestroyBuffer(allocator, frame.lightStatsBuffer.buffer, frame.lightStatsBuffer.allocation);
+		frame.transientDescriptors.cleanup();
+	}
+	frames.clear();
 
-	VkDescriptorSetLayoutCreateInfo textureSetInfo = {};
-	textureSetInfo.bindingCount = 1;
-	textureSetInfo.flags = 0;
-	textureSetInfo.pNext = nullptr;
-	textureSetInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	textureSetInfo.pBindings = &textureBind;
+	frameDescriptors.cleanup();
+	vmaDestroyBuffer(allocator, scenePropsBuffer.buffer, scenePropsBuffer.allocation);
+}
 
-	vkCreateDescriptorSetLayout(device, &textureSetInfo, nullptr, &singleTextureSetLayout);
+void Renderer::writeFrameImageDescriptors(FrameData& frame) {
+	descriptorWriter.writeImage(
+		frame.globalDescriptor, 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, shadowSampler, shadowMapView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	);
 
-	mainDeletionQueue.pushFunction([&]() {
-		vkDestroyDescriptorSetLayout(device, globalSetLayout, nullptr);
-		vkDestroyDescriptorSetLayout(device, modelSetLayout, nullptr);
-		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-
-		for (uint8_t i = 0; i < FRAME_OVERLAP; ++i)
-		{
-			vmaDestroyBuffer(allocator, frames[i].cameraBuffer.buffer, frames[i].cameraBuffer.allocation);
-			vmaDestroyBuffer(allocator, frames[i].modelBuffer.buffer, frames[i].modelBuffer.allocation);
-		}
+	frame.imageDescriptorsStale = false;
+}
 
-		vmaDestroyBuffer(allocator, scenePropsBuffer.buffer, scenePropsBuffer.allocation);
-	});
+void Renderer::applyFramesInFlight() {
+	//nothing of the old frames can be in use while they are rebuilt
+	VK_CHECK(vkDeviceWaitIdle(device), *console);
+
+	cleanupFrames();
+	framesInFlight = std::clamp(requestedFramesInFlight, 1u, MAX_FRAMES_IN_FLIGHT);
+	requestedFramesInFlight = framesInFlight;
+	//the new frames point their sets at the depth pyramid and shadow map when they first come around
+	initFrames();
+
+	dynamicResolution.init(framesInFlight + 1);
+	gpuFrameEndValid = false;
 }
 
 void Renderer::initPipelines() {
+	auto pipelineStart = std::chrono::high_resolution_clock::now();
 
 	VkPipelineLayoutCreateInfo meshPipelineLayoutInfo = vkinit::pipelineLayoutCreateInfo();
 	VkDescriptorSetLayout setLayouts[] = { globalSetLayout, modelSetLayout, singleTextureSetLayout };
@@ -759,19 +2444,22 @@ void Renderer::initPipelines() {
 	pipelineBuilder.multisampling = vkinit::multisamplingStateCreateInfo();
 	pipelineBuilder.colorBlendAttachment = vkinit::colorBlendAttachmentState();
 	pipelineBuilder.depthStencil = vkinit::depthStencilCreateInfo(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
+	//the scene color matches the swapchain so the upscale can blit straight across, the shadow map shares the depth format
+	pipelineBuilder.colorFormat = swapchainImageFormat;
+	pipelineBuilder.depthFormat = depthFormat;
 
-	VertexInputDescription vertexDescription = Vertex::getVertexDescription();
+	meshVertexDescription = Vertex::getVertexDescription();
 
 	//connect the pipeline builder vertex input info to the one we get from Vertex
-	pipelineBuilder.vertexInputInfo.pVertexAttributeDescriptions = vertexDescription.attributes.data();
-	pipelineBuilder.vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)vertexDescription.attributes.size();
+	pipelineBuilder.vertexInputInfo.pVertexAttributeDescriptions = meshVertexDescription.attributes.data();
+	pipelineBuilder.vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)meshVertexDescription.attributes.size();
 
-	pipelineBuilder.vertexInputInfo.pVertexBindingDescriptions = vertexDescription.bindings.data();
-	pipelineBuilder.vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)vertexDescription.bindings.size();
+	pipelineBuilder.vertexInputInfo.pVertexBindingDescriptions = meshVertexDescription.bindings.data();
+	pipelineBuilder.vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)meshVertexDescription.bindings.size();
 
 
 	VkShaderModule meshVertShader;
-	if (!loadShaderModule("shaders/default.vert.spv", &meshVertShader))
+	if (!pipelineRegistry.loadShaderModule("shaders/default.vert.spv", &meshVertShader))
 	{
 		console->log("Error when building the mesh vertex shader module");
 	}
@@ -780,7 +2468,7 @@ void Renderer::initPipelines() {
 	}
 
 	VkShaderModule meshFragShader;
-	if (!loadShaderModule("shaders/default.frag.spv", &meshFragShader))
+	if (!pipelineRegistry.loadShaderModule("shaders/default.frag.spv", &meshFragShader))
 	{
 		console->log("Error when building the mesh fragment shader module");
 	}
@@ -797,101 +2485,375 @@ void Renderer::initPipelines() {
 
 	pipelineBuilder.pipelineLayout = meshPipelineLayout;
 
+	//material variants loaded later start from the same state with their own shaders
+	meshPipelineBuilder = pipelineBuilder;
+
+	//every variant is queued up and compiled together, the registry builds them in parallel and skips states it already has
+	std::vector<PipelineRequest> pipelineRequests;
+
 	VkPipeline meshPipeline;
-	meshPipeline = pipelineBuilder.buildPipeline(device, renderPass);
+	pipelineRequests.push_back({ pipelineBuilder, &meshPipeline });
+
+	//after the depth pre-pass the depth buffer already holds the closest surface, so only fragments matching it get shaded
+	pipelineBuilder.depthStencil = vkinit::depthStencilCreateInfo(true, false, VK_COMPARE_OP_EQUAL);
+	VkPipeline meshDepthEqualPipeline;
+	pipelineRequests.push_back({ pipelineBuilder, &meshDepthEqualPipeline });
+
+	VkShaderModule depthOnlyVertShader;
+	if (!pipelineRegistry.loadShaderModule("shaders/depthonly.vert.spv", &depthOnlyVertShader))
+	{
+		console->log("Error when building the depth only vertex shader module");
+	}
+	else {
+		console->log("Depth only vertex shader successfully loaded");
+	}
+
+	VertexInputDescription positionDescription = Vertex::getPositionOnlyDescription();
+	pipelineBuilder.vertexInputInfo.pVertexAttributeDescriptions = positionDescription.attributes.data();
+	pipelineBuilder.vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)positionDescription.attributes.size();
+	pipelineBuilder.vertexInputInfo.pVertexBindingDescriptions = positionDescription.bindings.data();
+	pipelineBuilder.vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)positionDescription.bindings.size();
+
+	pipelineBuilder.shaderStages.clear();
+	pipelineBuilder.shaderStages.push_back(
+		vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, depthOnlyVertShader));
+
+	pipelineBuilder.colorAttachmentCount = 0;
+	pipelineBuilder.colorFormat = VK_FORMAT_UNDEFINED;
+	pipelineBuilder.depthStencil = vkinit::depthStencilCreateInfo(true, true, VK_COMPARE_OP_LESS);
+	pipelineRequests.push_back({ pipelineBuilder, &depthPrepassPipeline });
+	depthPrepassPipelineLayout = meshPipelineLayout;
+
+	VkShaderModule shadowVertShader;
+	if (!pipelineRegistry.loadShaderModule("shaders/shadow.vert.spv", &shadowVertShader))
+	{
+		console->log("Error when building the shadow vertex shader module");
+	}
+	else {
+		console->log("Shadow vertex shader successfully loaded");
+	}
+
+	//each cascade pushes its own matrix, the object buffer sits in set 1 like it does for every other pipeline
+	VkPushConstantRange shadowPushConstant = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4) };
+	VkPipelineLayoutCreateInfo shadowLayoutInfo = vkinit::pipelineLayoutCreateInfo();
+	shadowLayoutInfo.setLayoutCount = 2;
+	shadowLayoutInfo.pSetLayouts = setLayouts;
+	shadowLayoutInfo.pushConstantRangeCount = 1;
+	shadowLayoutInfo.pPushConstantRanges = &shadowPushConstant;
+	VK_CHECK(vkCreatePipelineLayout(device, &shadowLayoutInfo, nullptr, &shadowPipelineLayout), *console);
+
+	//the bias pushes the stored depth back, so surfaces don't shadow themselves where the texels are coarser than the slope
+	pipelineBuilder.shaderStages.clear();
+	pipelineBuilder.shaderStages.push_back(
+		vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, shadowVertShader));
+	pipelineBuilder.pipelineLayout = shadowPipelineLayout;
+	pipelineBuilder.rasterizer.depthBiasEnable = VK_TRUE;
+	pipelineBuilder.rasterizer.depthBiasConstantFactor = 1.25f;
+	pipelineBuilder.rasterizer.depthBiasSlopeFactor = 1.75f;
+	pipelineBuilder.depthStencil = vkinit::depthStencilCreateInfo(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
+	pipelineRequests.push_back({ pipelineBuilder, &shadowPipeline });
+
+	pipelineRegistry.compile(pipelineRequests);
+
+	VkShaderModule depthPyramidShader;
+	if (!pipelineRegistry.loadShaderModule("shaders/depthpyramid.comp.spv", &depthPyramidShader))
+	{
+		console->log("Error when building the depth pyramid compute shader module");
+	}
+	else {
+		console->log("Depth pyramid compute shader successfully loaded");
+	}
+
+	VkShaderModule occlusionCullShader;
+	if (!pipelineRegistry.loadShaderModule("shaders/occlusioncull.comp.spv", &occlusionCullShader))
+	{
+		console->log("Error when building the occlusion cull compute shader module");
+	}
+	else {
+		console->log("Occlusion cull compute shader successfully loaded");
+	}
+
+	VkShaderModule lightCullShader;
+	if (!pipelineRegistry.loadShaderModule("shaders/lightcull.comp.spv", &lightCullShader))
+	{
+		console->log("Error when building the light cull compute shader module");
+	}
+	else {
+		console->log("Light cull compute shader successfully loaded");
+	}
 
-	//deleting all of the vulkan shaders
-	vkDestroyShaderModule(device, meshVertShader, nullptr);
-	vkDestroyShaderModule(device, meshFragShader, nullptr);
+	VkPushConstantRange depthPyramidPushConstant = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(glm::vec4) };
+	VkPipelineLayoutCreateInfo depthPyramidLayoutInfo = vkinit::pipelineLayoutCreateInfo();
+	depthPyramidLayoutInfo.setLayoutCount = 1;
+	depthPyramidLayoutInfo.pSetLayouts = &depthPyramidSetLayout;
+	depthPyramidLayoutInfo.pushConstantRangeCount = 1;
+	depthPyramidLayoutInfo.pPushConstantRanges = &depthPyramidPushConstant;
+	VK_CHECK(vkCreatePipelineLayout(device, &depthPyramidLayoutInfo, nullptr, &depthPyramidPipelineLayout), *console);
+
+	VkComputePipelineCreateInfo depthPyramidPipelineInfo = vkinit::computePipelineCreateInfo(depthPyramidShader, depthPyramidPipelineLayout);
+	VK_CHECK(vkCreateComputePipelines(device, pipelineCache.get(), 1, &depthPyramidPipelineInfo, nullptr, &depthPyramidPipeline), *console);
+
+	VkPushConstantRange cullPushConstant = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullConstants) };
+	VkPipelineLayoutCreateInfo cullLayoutInfo = vkinit::pipelineLayoutCreateInfo();
+	cullLayoutInfo.setLayoutCount = 1;
+	cullLayoutInfo.pSetLayouts = &cullSetLayout;
+	cullLayoutInfo.pushConstantRangeCount = 1;
+	cullLayoutInfo.pPushConstantRanges = &cullPushConstant;
+	VK_CHECK(vkCreatePipelineLayout(device, &cullLayoutInfo, nullptr, &cullPipelineLayout), *console);
+
+	VkComputePipelineCreateInfo cullPipelineInfo = vkinit::computePipelineCreateInfo(occlusionCullShader, cullPipelineLayout);
+	VK_CHECK(vkCreateComputePipelines(device, pipelineCache.get(), 1, &cullPipelineInfo, nullptr, &cullPipeline), *console);
+
+	VkPushConstantRange lightCullPushConstant = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPULightCullConstants) };
+	VkPipelineLayoutCreateInfo lightCullLayoutInfo = vkinit::pipelineLayoutCreateInfo();
+	lightCullLayoutInfo.setLayoutCount = 1;
+	lightCullLayoutInfo.pSetLayouts = &lightCullSetLayout;
+	lightCullLayoutInfo.pushConstantRangeCount = 1;
+	lightCullLayoutInfo.pPushConstantRanges = &lightCullPushConstant;
+	VK_CHECK(vkCreatePipelineLayout(device, &lightCullLayoutInfo, nullptr, &lightCullPipelineLayout), *console);
+
+	VkComputePipelineCreateInfo lightCullPipelineInfo = vkinit::computePipelineCreateInfo(lightCullShader, lightCullPipelineLayout);
+	VK_CHECK(vkCreateComputePipelines(device, pipelineCache.get(), 1, &lightCullPipelineInfo, nullptr, &lightCullPipeline), *console);
+
+	//shader module loading is included, it is part of what a cold start pays for too
+	auto pipelineEnd = std::chrono::high_resolution_clock::now();
+	console->log(
+		"Pipeline creation took " + std::to_string(std::chrono::duration<float, std::milli>(pipelineEnd - pipelineStart).count()) + "ms (" +
+		(pipelineCache.isWarm() ? "warm" : "cold") + " pipeline cache)"
+	);
 
-	meshManager.loadMaterial({ "default", meshPipeline, meshPipelineLayout, nullptr });
+	//untextured models draw with this one, it has no texture set for its material to sample
+	materialManager.loadBindState({ "default", meshPipeline, meshPipelineLayout, meshDepthEqualPipeline, VK_NULL_HANDLE }, { .textured = false });
 
-	//adding the pipelines to the deletion queue
+	//adding the pipelines to the deletion queue, the graphics pipelines and shader modules belong to the registry
 	mainDeletionQueue.pushFunction([=]() {
-		vkDestroyPipeline(device, meshPipeline, nullptr);
+		vkDestroyPipeline(device, depthPyramidPipeline, nullptr);
+		vkDestroyPipeline(device, cullPipeline, nullptr);
+		vkDestroyPipeline(device, lightCullPipeline, nullptr);
 		vkDestroyPipelineLayout(device, meshPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, depthPyramidPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, lightCullPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, shadowPipelineLayout, nullptr);
 	});
 }
 
-bool Renderer::loadShaderModule(const char* filePath, VkShaderModule* outShaderModule) {
-	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+MaterialId Renderer::loadMaterialVariant(const std::string& name, const char* vertexShaderPath, const char* fragmentShaderPath) {
+	MaterialBindState* defaultState = materialManager.findBindState("default");
 
-	if (!file.is_open()) {
-		return false;
+	MaterialBindState* existing = materialManager.findBindState(name);
+	if (existing) {
+		return existing->baseMaterial;
+	}
+
+	VkShaderModule vertShader;
+	VkShaderModule fragShader;
+	if (!pipelineRegistry.loadShaderModule(vertexShaderPath, &vertShader) || !pipelineRegistry.loadShaderModule(fragmentShaderPath, &fragShader)) {
+		console->log("[ERROR]: Failed to load the shaders for material " + name + ", using the default material");
+		return defaultState->baseMaterial;
 	}
 
-	size_t fileSize = (size_t)file.tellg();
+	MaterialBindState* bindState = materialManager.loadBindState(
+		{ name, defaultState->pipeline, defaultState->pipelineLayout, defaultState->depthEqualPipeline, VK_NULL_HANDLE },
+		{ .textured = false }
+	);
+
+	PipelineBuilder pipelineBuilder = meshPipelineBuilder;
+	pipelineBuilder.shaderStages.clear();
+	pipelineBuilder.shaderStages.push_back(
+		vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, vertShader));
+	pipelineBuilder.shaderStages.push_back(
+		vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragShader));
+
+	//the material draws with the default pipelines until its own have been compiled in the background
+	pipelineRegistry.requestPipeline(pipelineBuilder, &bindState->pipeline, defaultState->pipeline);
 
-	//spirv expects the buffer to be on uint32, so make sure to reserve an int vector big enough for the entire file
-	std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
-	file.seekg(0);
-	file.read((char*)buffer.data(), fileSize);
-	file.close();
+	pipelineBuilder.depthStencil = vkinit::depthStencilCreateInfo(true, false, VK_COMPARE_OP_EQUAL);
+	pipelineRegistry.requestPipeline(pipelineBuilder, &bindState->depthEqualPipeline, defaultState->depthEqualPipeline);
 
-	VkShaderModuleCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.pNext = nullptr;
+	return bindState->baseMaterial;
+}
 
-	//codeSize has to be in bytes, so multiply the ints in the buffer by size of int to know the real size of the buffer
-	createInfo.codeSize = buffer.size() * sizeof(uint32_t);
-	createInfo.pCode = buffer.data();
+MaterialId Renderer::createMaterial(MaterialId base, const MaterialParameters& parameters) {
+	MaterialBindState* bindState = materialManager.getBindState(base);
+	if (!bindState) {
+		console->log("[ERROR]: Can't create a material from an invalid base material");
+		return INVALID_MATERIAL;
+	}
 
-	//check that the creation goes well.
-	VkShaderModule shaderModule;
-	if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-		return false;
+	MaterialId material = materialManager.create(bindState, parameters);
+	if (material == INVALID_MATERIAL) {
+		console->log("[ERROR]: Material limit of " + std::to_string(MAX_MATERIALS) + " reached");
+		return INVALID_MATERIAL;
 	}
 
-	*outShaderModule = shaderModule;
-	return true;
+	//evicting the texture removes the bind state along with every material made from it, so the material keeps it loaded
+	auto texture = materialTextures.find(bindState);
+	if (texture != materialTextures.end()) {
+		textureManager.loadedTextures.acquire(texture->second, *pFrameNumber);
+	}
+
+	return material;
+}
+
+void Renderer::setMaterialParameters(MaterialId material, const MaterialParameters& parameters) {
+	materialManager.setParameters(material, parameters);
+}
+
+const MaterialParameters* Renderer::getMaterialParameters(MaterialId material) const {
+	return materialManager.getParameters(material);
+}
+
+void Renderer::releaseMaterial(MaterialId material) {
+	//base materials are never freed here, and never held a texture reference of their own
+	MaterialBindState* bindState = materialManager.getBindState(material);
+	if (!materialManager.release(material)) {
+		return;
+	}
+
+	auto texture = materialTextures.find(bindState);
+	if (texture != materialTextures.end()) {
+		textureManager.loadedTextures.release(texture->second, *pFrameNumber);
+	}
 }
 
 void Renderer::loadModel(Model& model, LoadModelInfo info) {
-	model.mesh = loadMesh(info.filePath.c_str());
+	model.meshHandle = loadMesh(info.filePath.c_str());
+	meshManager.meshes.acquire(model.meshHandle, *pFrameNumber);
+	model.mesh = meshManager.getMesh(model.meshHandle);
+
+	const MaterialId base = loadModelMaterial(model, info);
+	model.material = base;
+
+	//a model tinted or lit differently gets a material of its own, which still shares the base's bind state and batches with it
+	MaterialParameters parameters = *materialManager.getParameters(base);
+	if (parameters.color == info.color && parameters.emissive == info.emissive && parameters.emissiveStrength == info.emissiveStrength) {
+		return;
+	}
 
-	if (info.textured) {
-		Texture* texture = textureManager.loadTexture(*this, info.texturePath.c_str());
+	parameters.color = info.color;
+	parameters.emissive = info.emissive;
+	parameters.emissiveStrength = info.emissiveStrength;
 
-		Material* defaultMaterial = meshManager.loadMaterial({ "default" });
-		CreateMaterialInfo materialInfo = {
-			.name = info.filePath + info.texturePath,
-			.pipeline = defaultMaterial->pipeline,
-			.layout = defaultMaterial->pipelineLayout,
-		};
+	const MaterialId material = createMaterial(base, parameters);
+	if (material != INVALID_MATERIAL) {
+		model.material = material;
+	}
+}
+
+MaterialId Renderer::loadModelMaterial(Model& model, const LoadModelInfo& info) {
+	MaterialBindState* defaultState = materialManager.findBindState("default");
+	if (!info.textured) {
+		return defaultState->baseMaterial;
+	}
 
-		model.material = meshManager.loadMaterial(materialInfo);
+	model.textureHandle = textureManager.loadTexture(*this, info.texturePath.c_str(), *pFrameNumber);
+	Texture* texture = textureManager.getTexture(model.textureHandle);
+	if (!texture) {
+		return defaultState->baseMaterial;
+	}
+	textureManager.loadedTextures.acquire(model.textureHandle, *pFrameNumber);
+
+	//the bind state only depends on the texture, so every model sampling it shares one set and base material
+	CreateBindStateInfo bindStateInfo = {
+		.name = info.texturePath,
+		.pipeline = defaultState->pipeline,
+		.layout = defaultState->pipelineLayout,
+		.depthEqualPipeline = defaultState->depthEqualPipeline,
+		.textureSet = VK_NULL_HANDLE
+	};
 
-		VkSamplerCreateInfo samplerInfo = vkinit::samplerCreateInfo(VK_FILTER_NEAREST);
-		VkSampler sampler;
-		vkCreateSampler(device, &samplerInfo, nullptr, &sampler);
+	MaterialBindState* bindState = materialManager.loadBindState(bindStateInfo);
+	if (bindState->baseMaterial == INVALID_MATERIAL) {
+		console->log("[ERROR]: Material limit of " + std::to_string(MAX_MATERIALS) + " reached, " + info.texturePath + " draws untextured");
+		return defaultState->baseMaterial;
+	}
 
-		mainDeletionQueue.pushFunction([=]() {
-			vkDestroySampler(device, sampler, nullptr);
-		});
+	if (bindState->textureSet == VK_NULL_HANDLE) {
+		bindState->textureSet = allocateTextureSet();
+		materialTextures[bindState] = model.textureHandle;
+		if (bindState->textureSet != VK_NULL_HANDLE) {
+			writeTextureSet(bindState->textureSet, *texture);
+		}
+	}
+
+	return bindState->baseMaterial;
+}
+
+void Renderer::writeTextureSet(VkDescriptorSet set, const Texture& texture) {
+	DescriptorData data;
+	data.image = { textureSampler, texture.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	descriptorWriter.writeTemplate(set, textureSetTemplate, &data, 1);
+}
+
+void Renderer::releaseModel(Model& model) {
+	//only a material loadModel made for the model is released, base materials are left to their bind state
+	releaseMaterial(model.material);
+	meshManager.meshes.release(model.meshHandle, *pFrameNumber);
+	textureManager.loadedTextures.release(model.textureHandle, *pFrameNumber);
+
+	model.meshHandle = {};
+	model.textureHandle = {};
+	model.mesh = nullptr;
+	model.material = INVALID_MATERIAL;
+}
+
+VkDescriptorSet Renderer::allocateTextureSet() {
+	if (!retiredTextureSets.empty()) {
+		uint64_t completedValue = 0;
+		VK_CHECK(vkGetSemaphoreCounterValue(device, frameTimeline, &completedValue), *console);
+		if (retiredTextureSets.front().timelineValue <= completedValue) {
+			VkDescriptorSet set = retiredTextureSets.front().set;
+			retiredTextureSets.pop_front();
+			return set;
+		}
+	}
 
-		VkDescriptorSetAllocateInfo allocInfo = {};
-		allocInfo.pNext = nullptr;
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = descriptorPool;
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = &singleTextureSetLayout;
+	VkDescriptorSet set = descriptorAllocator.allocate(singleTextureSetLayout);
+	if (set == VK_NULL_HANDLE) {
+		console->log("[ERROR]: Failed to allocate a texture descriptor set");
+	}
+
+	return set;
+}
 
-		vkAllocateDescriptorSets(device, &allocInfo, &model.material->textureSet);
+void Renderer::writeCullDescriptor(FrameData& frame) {
+	//written fresh every frame from the frame's transient pools, so it always samples the current depth pyramid without tracking resizes
+	frame.cullDescriptor = allocateTransientSet(cullSetLayout);
+	if (frame.cullDescriptor == VK_NULL_HANDLE) {
+		return;
+	}
 
-		VkDescriptorImageInfo imageBufferInfo;
-		imageBufferInfo.sampler = sampler;
-		imageBufferInfo.imageView = texture->imageView;
-		imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	descriptorWriter.writeBuffer(frame.cullDescriptor, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objectBuffer.buffer, 0, sizeof(GPUModelData) * MAX_RENDER_OBJECTS);
+	descriptorWriter.writeBuffer(frame.cullDescriptor, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.drawCommandBuffer.buffer, 0, sizeof(GPUDrawCommand) * MAX_RENDER_OBJECTS);
+	descriptorWriter.writeBuffer(frame.cullDescriptor, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.lateDrawCommandBuffer.buffer, 0, sizeof(GPUDrawCommand) * MAX_RENDER_OBJECTS);
+	descriptorWriter.writeBuffer(frame.cullDescriptor, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullStatsBuffer.buffer, 0, sizeof(GPUCullStats));
+	descriptorWriter.writeImage(
+		frame.cullDescriptor, 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depthPyramidSampler, depthPyramidView, VK_IMAGE_LAYOUT_GENERAL
+	);
+}
 
-		VkWriteDescriptorSet textureDescriptorSet = vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, model.material->textureSet, &imageBufferInfo, 0);
-		vkUpdateDescriptorSets(device, 1, &textureDescriptorSet, 0, nullptr);
+VkDescriptorSet Renderer::allocateTransientSet(VkDescriptorSetLayout layout) {
+	VkDescriptorSet set = getCurrentFrame().transientDescriptors.allocate(layout);
+	if (set == VK_NULL_HANDLE) {
+		console->log("[ERROR]: Failed to allocate a transient descriptor set");
 	}
+
+	return set;
 }
 
-Mesh* Renderer::loadMesh(const char* filename) {
-	Mesh* mesh = meshManager.loadMesh(filename);
-	uploadMesh(*mesh);
-	return mesh;
+MeshHandle Renderer::loadMesh(const char* filename) {
+	MeshHandle handle = meshManager.loadMesh(filename, *pFrameNumber);
+	Mesh* mesh = meshManager.getMesh(handle);
+
+	// meshes are shared between models, so only the first load needs to upload
+	if (mesh && mesh->vertexBuffer.buffer == VK_NULL_HANDLE && !uploadMesh(*mesh)) {
+		console->log("[ERROR]: Failed to upload mesh " + std::string(filename));
+		meshManager.meshes.remove(handle);
+		return {};
+	}
+
+	return handle;
 }
 
 AllocatedBuffer Renderer::createBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) {
@@ -920,73 +2882,440 @@ AllocatedBuffer Renderer::createBuffer(size_t allocSize, VkBufferUsageFlags usag
 	return newBuffer;
 }
 
-void Renderer::uploadMesh(Mesh& mesh) {
-	const size_t bufferSize = mesh.vertices.size() * sizeof(Vertex);
-	//allocate staging buffer
-	VkBufferCreateInfo stagingBufferInfo = {};
-	stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	stagingBufferInfo.pNext = nullptr;
+bool Renderer::uploadMesh(Mesh& mesh) {
+	mesh.vertexBuffer = uploadBuffer(
+		mesh.vertices.data(),
+		mesh.vertices.size() * sizeof(Vertex),
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+	);
 
-	stagingBufferInfo.size = bufferSize;
-	stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	//depth only passes read a separate, tightly packed position stream to keep their vertex fetch small.
+	//it is gathered from the vertices straight into staging memory rather than into a copy of its own first
+	mesh.positionBuffer = uploadBuffer(
+		[&](void* destination, VkDeviceSize offset, VkDeviceSize size) {
+			const size_t firstVertex = offset / sizeof(glm::vec3);
+			const size_t vertexCount = size / sizeof(glm::vec3);
+			glm::vec3* positions = (glm::vec3*)destination;
+			for (size_t i = 0; i < vertexCount; ++i) {
+				positions[i] = mesh.vertices[firstVertex + i].position;
+			}
+			return true;
+		},
+		mesh.vertices.size() * sizeof(glm::vec3),
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		sizeof(glm::vec3)
+	);
 
-	//let the VMA library know that this data should be on CPU RAM
-	VmaAllocationCreateInfo vmaallocInfo = {};
-	vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	if (!mesh.indices.empty()) {
+		mesh.indexBuffer = uploadBuffer(
+			mesh.indices.data(),
+			mesh.indices.size() * sizeof(uint32_t),
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+		);
+	}
 
-	AllocatedBuffer stagingBuffer;
+	//a mesh is only drawn with all of its buffers, so one that failed takes the others down with it
+	const bool uploaded = mesh.vertexBuffer.buffer != VK_NULL_HANDLE && mesh.positionBuffer.buffer != VK_NULL_HANDLE &&
+		(mesh.indices.empty() || mesh.indexBuffer.buffer != VK_NULL_HANDLE);
+	if (!uploaded) {
+		releaseMesh(mesh);
+	}
 
-	//allocate the buffer
-	VK_CHECK(vmaCreateBuffer(allocator, &stagingBufferInfo, &vmaallocInfo,
-		&stagingBuffer.buffer,
-		&stagingBuffer.allocation,
-		nullptr), *console);
+	return uploaded;
+}
 
-	void* data;
-	vmaMapMemory(allocator, stagingBuffer.allocation, &data);
-	memcpy(data, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
-	vmaUnmapMemory(allocator, stagingBuffer.allocation);
-
-	VkBufferCreateInfo vertexBufferInfo = {};
-	vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	vertexBufferInfo.pNext = nullptr;
-	vertexBufferInfo.size = bufferSize;
-	vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+void Renderer::releaseMesh(Mesh& mesh) {
+	destroyDeferred(mesh.vertexBuffer);
+	destroyDeferred(mesh.positionBuffer);
+	destroyDeferred(mesh.indexBuffer);
+
+	mesh.vertexBuffer = {};
+	mesh.positionBuffer = {};
+	mesh.indexBuffer = {};
+}
+
+void Renderer::releaseTexture(Texture& texture) {
+	destroyDeferred(texture.imageView);
+	destroyDeferred(texture.image);
+
+	texture.imageView = VK_NULL_HANDLE;
+	texture.image = {};
+}
+
+void Renderer::evictAssets() {
+	const size_t cpuBudget = (size_t)assetBudget.cpuMegabytes * 1048576;
+	const size_t gpuBudget = (size_t)assetBudget.gpuMegabytes * 1048576;
+
+	while (true) {
+		const AssetMemory& meshMemory = meshManager.meshes.getUsage();
+		const AssetMemory& textureMemory = textureManager.loadedTextures.getUsage();
+		const bool overCPU = meshMemory.cpuBytes + textureMemory.cpuBytes > cpuBudget;
+		const bool overGPU = meshMemory.gpuBytes + textureMemory.gpuBytes > gpuBudget;
+		if (!overCPU && !overGPU) {
+			return;
+		}
+
+		MeshHandle mesh = meshManager.meshes.leastRecentlyUsed();
+		TextureHandle texture = textureManager.loadedTextures.leastRecentlyUsed();
+
+		//textures only take up GPU memory, so they only help once that is over as well
+		if (!overGPU) {
+			texture = {};
+		}
+		if (!mesh.isValid() && !texture.isValid()) {
+			//everything left is still referenced
+			return;
+		}
+
+		if (!texture.isValid() || (mesh.isValid() && meshManager.meshes.getLastUsed(mesh) <= textureManager.loadedTextures.getLastUsed(texture))) {
+			evictMesh(mesh);
+		} else {
+			evictTexture(texture);
+		}
+	}
+}
+
+void Renderer::evictMesh(MeshHandle handle) {
+	releaseMesh(*meshManager.getMesh(handle));
+	meshManager.meshes.remove(handle);
+	++assetStats.evictedMeshes;
+}
+
+void Renderer::evictTexture(TextureHandle handle) {
+	//textured bind states are named after their texture
+	const std::string& name = textureManager.loadedTextures.getName(handle);
+	MaterialBindState* bindState = materialManager.findBindState(name);
+	if (bindState) {
+		if (bindState->textureSet != VK_NULL_HANDLE) {
+			retiredTextureSets.push_back({ frameTimelineValue, bindState->textureSet });
+		}
+		materialTextures.erase(bindState);
+		materialManager.removeBindState(name);
+	}
+
+	releaseTexture(*textureManager.getTexture(handle));
+	textureManager.loadedTextures.remove(handle);
+	++assetStats.evictedTextures;
+}
+
+void Renderer::updateDefragmentation(uint64_t completedValue) {
+	if (defragmentationMoves.recorded) {
+		if (completedValue < defragmentationMoves.copyValue) {
+			return;
+		}
+		applyDefragmentationMoves();
+	}
+
+	const uint32_t evictions = assetStats.evictedMeshes + assetStats.evictedTextures;
+	if (memoryDefragmenter.settings.automatic && evictions != defragmentedEvictions && !memoryDefragmenter.isActive()) {
+		defragmentedEvictions = evictions;
+		memoryDefragmenter.start();
+	}
+
+	VmaDefragmentationPassMoveInfo* pass = memoryDefragmenter.beginPass(completedValue);
+	if (!pass) {
+		return;
+	}
+
+	//only meshes and textures know how to follow their memory, everything else stays where it is
+	struct MoveTarget {
+		AllocatedBuffer* buffer{ nullptr };
+		VkDeviceSize size{ 0 };
+		VkBufferUsageFlags usage{ 0 };
+		Texture* texture{ nullptr };
+	};
+	std::unordered_map<VmaAllocation, MoveTarget> targets;
+	auto addBuffer = [&](AllocatedBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage) {
+		if (buffer.allocation != VK_NULL_HANDLE) {
+			targets[buffer.allocation] = { &buffer, size, usage };
+		}
+	};
+	auto addMesh = [&](Mesh& mesh) {
+		addBuffer(mesh.vertexBuffer, mesh.vertices.size() * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		addBuffer(mesh.positionBuffer, mesh.vertices.size() * sizeof(glm::vec3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		addBuffer(mesh.indexBuffer, mesh.indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	};
+	meshManager.meshes.forEach(addMesh);
+	for (std::unique_ptr<Mesh>& mesh : staticBatchMeshes) {
+		addMesh(*mesh);
+	}
+	textureManager.loadedTextures.forEach([&](Texture& texture) {
+		targets[texture.image.allocation] = { nullptr, 0, 0, &texture };
+	});
+
+	//the new resources are bound to memory VMA has set aside, the moves past the time budget wait for a later pass
+	const auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < pass->moveCount; ++i) {
+		VmaDefragmentationMove& move = pass->pMoves[i];
+		auto target = targets.find(move.srcAllocation);
+		const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		if (target == targets.end() || elapsed > memoryDefragmenter.settings.timeBudget) {
+			move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+			continue;
+		}
+
+		if (target->second.buffer) {
+			VkBufferCreateInfo bufferInfo = {};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.pNext = nullptr;
+			bufferInfo.size = target->second.size;
+			bufferInfo.usage = target->second.usage | UPLOAD_BUFFER_USAGE;
+
+			VkBuffer buffer;
+			// VMA destroys it later, with the allocation callbacks it was given
+			VK_CHECK(vkCreateBuffer(device, &bufferInfo, allocationtracker::getVulkanCallbacks(), &buffer), *console);
+			VK_CHECK(vmaBindBufferMemory(allocator, move.dstTmpAllocation, buffer), *console);
+			defragmentationMoves.buffers.push_back({ target->second.buffer, buffer, target->second.size });
+		} else {
+			VkImageCreateInfo imageInfo = vkinit::imageCreateInfo(VK_FORMAT_R8G8B8A8_SRGB, TEXTURE_USAGE, target->second.texture->extent);
+
+			VkImage image;
+			VK_CHECK(vkCreateImage(device, &imageInfo, allocationtracker::getVulkanCallbacks(), &image), *console);
+			VK_CHECK(vmaBindImageMemory(allocator, move.dstTmpAllocation, image), *console);
+
+			VkImageView view;
+			VkImageViewCreateInfo viewInfo = vkinit::imageviewCreateInfo(VK_FORMAT_R8G8B8A8_SRGB, image, VK_IMAGE_ASPECT_COLOR_BIT);
+			VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &view), *console);
+			defragmentationMoves.textures.push_back({ target->second.texture, image, view });
+		}
+	}
+
+	//with nothing to copy the pass is over straight away, it never moved anything the frames in flight read
+	if (defragmentationMoves.empty()) {
+		memoryDefragmenter.endPass(frameTimelineValue);
+	}
+}
+
+void Renderer::addDefragmentationPass(RenderGraphResource sceneColor) {
+	if (defragmentationMoves.empty() || defragmentationMoves.recorded) {
+		return;
+	}
+
+	//the copies are swapped in once the value this frame signals has been reached
+	defragmentationMoves.recorded = true;
+	defragmentationMoves.copyValue = frameTimelineValue + 1;
+
+	//the meshes are only ever read, so copying out of them needs no barrier against the frames drawing them
+	const RenderGraphState vertexInput = { VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT };
+	const RenderGraphState sampled = { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+	//materials sample their textures without the graph knowing, so reading the finished scene color orders the copies after every pass drawing them.
+	//The frames up to the swap keep sampling the old textures, so they go back to being sampled along with the copies
+	RenderGraphPassBuilder copyPass = renderGraph.addPass("Defragment", [&](VkCommandBuffer cmd) {
+		for (const DefragmentationBufferMove& move : defragmentationMoves.buffers) {
+			VkBufferCopy copy = {};
+			copy.size = move.size;
+			vkCmdCopyBuffer(cmd, move.target->buffer, move.buffer, 1, &copy);
+		}
+
+		for (const DefragmentationTextureMove& move : defragmentationMoves.textures) {
+			VkImageCopy region = {};
+			region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			region.extent = move.target->extent;
+			vkCmdCopyImage(cmd, move.target->image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, move.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		}
+	});
+	copyPass.read(sceneColor, USAGE_TRANSFER_SRC);
+
+	for (const DefragmentationBufferMove& move : defragmentationMoves.buffers) {
+		RenderGraphResource source = renderGraph.importBuffer("Defragment Source", move.target->buffer, vertexInput);
+		RenderGraphResource destination = renderGraph.importBuffer("Defragment Destination", move.buffer, {});
+		renderGraph.markOutput(destination, USAGE_VERTEX_INPUT);
+		copyPass
+			.read(source, USAGE_TRANSFER_SRC)
+			.write(destination, USAGE_TRANSFER_DST);
+	}
+
+	for (const DefragmentationTextureMove& move : defragmentationMoves.textures) {
+		RenderGraphResource source = renderGraph.importImage("Defragment Source", move.target->image.image, VK_IMAGE_ASPECT_COLOR_BIT, sampled);
+		RenderGraphResource destination = renderGraph.importImage("Defragment Destination", move.image, VK_IMAGE_ASPECT_COLOR_BIT, {});
+		renderGraph.markOutput(source, USAGE_FRAGMENT_SAMPLED);
+		renderGraph.markOutput(destination, USAGE_FRAGMENT_SAMPLED);
+		copyPass
+			.read(source, USAGE_TRANSFER_SRC)
+			.write(destination, USAGE_TRANSFER_DST);
+	}
+}
+
+void Renderer::applyDefragmentationMoves() {
+	//the old handles are dropped without their allocations, which now belong to the new resources
+	for (const DefragmentationBufferMove& move : defragmentationMoves.buffers) {
+		destroyDeferred(AllocatedBuffer{ move.target->buffer, VK_NULL_HANDLE });
+		move.target->buffer = move.buffer;
+	}
+
+	for (const DefragmentationTextureMove& move : defragmentationMoves.textures) {
+		Texture& texture = *move.target;
+		destroyDeferred(texture.imageView);
+		destroyDeferred(AllocatedImage{ texture.image.image, VK_NULL_HANDLE });
+		texture.image.image = move.image;
+		texture.imageView = move.view;
+
+		//frames in flight still have the old sets bound, so the bind states get new ones and the old ones retire like evicted ones do
+		for (auto& [bindState, handle] : materialTextures) {
+			if (textureManager.getTexture(handle) != &texture || bindState->textureSet == VK_NULL_HANDLE) {
+				continue;
+			}
+
+			retiredTextureSets.push_back({ frameTimelineValue, bindState->textureSet });
+			bindState->textureSet = allocateTextureSet();
+			if (bindState->textureSet != VK_NULL_HANDLE) {
+				writeTextureSet(bindState->textureSet, texture);
+			}
+		}
+	}
+
+	memoryDefragmenter.endPass(frameTimelineValue);
+	defragmentationMoves = {};
+}
+
+AllocatedBuffer Renderer::uploadBuffer(const void* source, size_t bufferSize, VkBufferUsageFlags usage) {
+	return uploadBuffer([&](void* destination, VkDeviceSize offset, VkDeviceSize size) {
+		memcpy(destination, (const uint8_t*)source + offset, size);
+		return true;
+	}, bufferSize, usage);
+}
+
+AllocatedBuffer Renderer::uploadBuffer(const StagedReadFunction& read, size_t bufferSize, VkBufferUsageFlags usage, VkDeviceSize granularity) {
+	VmaAllocationCreateInfo vmaallocInfo = {};
+
+	VkBufferCreateInfo gpuBufferInfo = {};
+	gpuBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	gpuBufferInfo.pNext = nullptr;
+	gpuBufferInfo.size = bufferSize;
+	gpuBufferInfo.usage = usage | UPLOAD_BUFFER_USAGE;
 	vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
+	AllocatedBuffer gpuBuffer;
+
 	//allocate the buffer
-	VK_CHECK(vmaCreateBuffer(allocator, &vertexBufferInfo, &vmaallocInfo,
-		&mesh.vertexBuffer.buffer,
-		&mesh.vertexBuffer.allocation,
+	VK_CHECK(vmaCreateBuffer(allocator, &gpuBufferInfo, &vmaallocInfo,
+		&gpuBuffer.buffer,
+		&gpuBuffer.allocation,
 		nullptr), *console);
 
-	immediateSubmit([=](VkCommandBuffer cmd) {
-		VkBufferCopy copy;
-		copy.dstOffset = 0;
-		copy.srcOffset = 0;
-		copy.size = bufferSize;
-		vkCmdCopyBuffer(cmd, stagingBuffer.buffer, mesh.vertexBuffer.buffer, 1, &copy);
+	const bool uploaded = stageUpload(read, bufferSize, granularity, [&](VkCommandBuffer cmd, const StagedCopy* copies, uint32_t copyCount, bool, bool) {
+		for (uint32_t i = 0; i < copyCount; ++i) {
+			VkBufferCopy copy;
+			copy.srcOffset = 0;
+			copy.dstOffset = copies[i].dataOffset;
+			copy.size = copies[i].size;
+			vkCmdCopyBuffer(cmd, copies[i].buffer, gpuBuffer.buffer, 1, &copy);
+		}
 	});
 
-	mainDeletionQueue.pushFunction([=]() {
-		vmaDestroyBuffer(allocator, mesh.vertexBuffer.buffer, mesh.vertexBuffer.allocation);
-	});
+	if (!uploaded) {
+		//the copies submitted before the upload was abandoned have been waited on, so nothing reads the buffer anymore
+		vmaDestroyBuffer(allocator, gpuBuffer.buffer, gpuBuffer.allocation);
+		return {};
+	}
+
+	//the buffer belongs to the caller, it goes back through destroyDeferred once it is unloaded
+	return gpuBuffer;
+}
+
+bool Renderer::stageUpload(const void* source, VkDeviceSize size, VkDeviceSize granularity, const StagedCopyFunction& record) {
+	return stageUpload([&](void* destination, VkDeviceSize offset, VkDeviceSize readSize) {
+		memcpy(destination, (const uint8_t*)source + offset, readSize);
+		return true;
+	}, size, granularity, record);
+}
+
+bool Renderer::stageUpload(const StagedReadFunction& read, VkDeviceSize size, VkDeviceSize granularity, const StagedCopyFunction& record) {
+	std::vector<StagingChunk*> chunks;
+	std::vector<StagedCopy> copies;
+	bool first = true;
+
+	auto submit = [&](bool last) {
+		immediateSubmit([&](VkCommandBuffer cmd) {
+			record(cmd, copies.data(), (uint32_t)copies.size(), first, last);
+		});
+
+		for (StagingChunk* chunk : chunks) {
+			stagingPool.release(chunk, uploadContext.submitValue);
+		}
+		stagingPool.recycle(uploadContext.completedValue);
+
+		chunks.clear();
+		copies.clear();
+		first = false;
+	};
+
+	//nothing reads the chunks filled so far, so they can go straight back to the pool
+	auto abandon = [&]() {
+		for (StagingChunk* chunk : chunks) {
+			stagingPool.release(chunk, 0);
+		}
+		stagingPool.recycle(uploadContext.completedValue);
+		return false;
+	};
+
+	VkDeviceSize offset = 0;
+	while (offset < size) {
+		StagingChunk* chunk = stagingPool.acquire(size - offset);
+		if (!chunk) {
+			if (chunks.empty()) {
+				console->log("[ERROR]: Failed to get a staging chunk for an upload of " + std::to_string(size) + " bytes");
+				return false;
+			}
 
-	vmaDestroyBuffer(allocator, stagingBuffer.buffer, stagingBuffer.allocation);
+			//the pool is at its cap, the chunks filled so far have to finish copying before they can take the rest
+			submit(false);
+			continue;
+		}
+		chunks.push_back(chunk);
+
+		//a chunk only takes whole multiples of the granularity, so an image copy never splits a row between two chunks
+		const VkDeviceSize copySize = std::min(size - offset, chunk->size / granularity * granularity);
+		if (copySize == 0) {
+			console->log("[ERROR]: Upload granularity of " + std::to_string(granularity) + " bytes doesn't fit in a staging chunk");
+			return abandon();
+		}
+
+		//the source fills the mapped chunk directly, so at no point is more than the staging window of it held on the host
+		if (!read(chunk->mapped, offset, copySize)) {
+			console->log("[ERROR]: Failed to read bytes " + std::to_string(offset) + " to " + std::to_string(offset + copySize) + " of an upload");
+			return abandon();
+		}
+
+		copies.push_back({ chunk->buffer.buffer, offset, copySize });
+		offset += copySize;
+	}
+
+	submit(true);
+	return true;
 }
 
 FrameData& Renderer::getCurrentFrame()
 {
-	return frames[*pFrameNumber % FRAME_OVERLAP];
+	return frames[*pFrameNumber % framesInFlight];
 }
 
 void Renderer::cleanup() {
 	if (isInitialised) {
-		for (uint8_t i = 0; i < FRAME_OVERLAP; ++i) {
-			vkWaitForFences(device, 1, &frames[i].renderFence, true, ONE_SECOND);
+		//everything below frees what the frames and uploads still in flight may use, so nothing can go until the device is really done,
+		//however long the last submits take
+		VK_CHECK(vkDeviceWaitIdle(device), *console);
+		//a pass already copied can be swapped in now the GPU is done, before the run ends and VMA takes back the memory it set aside
+		if (defragmentationMoves.recorded) {
+			applyDefragmentationMoves();
+		}
+		memoryDefragmenter.stop();
+
+		//assets are released the same way as at runtime, and everything destroyDeferred was handed can go straight away now the GPU is done
+		meshManager.meshes.forEach([&](Mesh& mesh) {
+			releaseMesh(mesh);
+		});
+		for (std::unique_ptr<Mesh>& mesh : staticBatchMeshes) {
+			releaseMesh(*mesh);
 		}
+		textureManager.loadedTextures.forEach([&](Texture& texture) {
+			releaseTexture(texture);
+		});
 
 		mainDeletionQueue.flush();
+		frameDeletionQueue.flush();
 
 		vmaDestroyAllocator(allocator);
 		vkDestroyDevice(device, nullptr);
@@ -994,6 +3323,10 @@ void Renderer::cleanup() {
 		vkb::destroy_debug_utils_messenger(instance, debugMessenger);
 		vkDestroyInstance(instance, nullptr);
 		window->cleanup();
+
+		for (LinearArena& arena : frameArenas) {
+			arena.cleanup();
+		}
 	}
 }
 
@@ -1012,8 +3345,12 @@ void Renderer::immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& functi
 
 	VkSubmitInfo submit = vkinit::submitInfo(&cmd);
 	VK_CHECK(vkQueueSubmit(graphicsQueue, 1, &submit, uploadContext.uploadFence), *console);
+	++uploadContext.submitValue;
 
-	vkWaitForFences(device, 1, &uploadContext.uploadFence, true, ONE_SECOND);
+	//staging chunks read by the submit are only recycled once the wait has actually seen it finish
+	if (vkWaitForFences(device, 1, &uploadContext.uploadFence, true, ONE_SECOND) == VK_SUCCESS) {
+		uploadContext.completedValue = uploadContext.submitValue;
+	}
 	vkResetFences(device, 1, &uploadContext.uploadFence);
 
 	// reset the command buffers inside the command pool
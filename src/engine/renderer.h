@@ -2,6 +2,7 @@
 
 class Window;
 class Console;
+class JobSystem;
 struct Model;
 
 #include <utils/types.h>
@@ -11,10 +12,27 @@ struct Model;
 #include <vector>
 #include <deque>
 #include <functional>
+#include <memory>
+#include <unordered_map>
 
 #include "camera.h"
 #include "meshmanager.h"
+#include "materialmanager.h"
 #include "texturemanager.h"
+#include "renderobjectmanager.h"
+#include "occlusionculler.h"
+#include "pipelinecache.h"
+#include "pipelineregistry.h"
+#include "rendergraph.h"
+#include "dynamicresolution.h"
+#include "lightmanager.h"
+#include "shadowcascades.h"
+#include "framedeletionqueue.h"
+#include "memorydefragmenter.h"
+#include "framearena.h"
+#include "descriptorallocator.h"
+#include "descriptorwriter.h"
+#include "stagingpool.h"
 
 struct GPUCameraData {
 	glm::mat4 view;
@@ -28,31 +46,145 @@ struct GPUSceneData {
 	glm::vec4 ambientColor;
 	glm::vec4 sunDirection;
 	glm::vec4 sunColor;
+	// xy turn a pixel into its cluster, zw the view depth's log into its slice
+	glm::vec4 clusterScale;
+	// x shows the lights per cluster as a heatmap
+	glm::uvec4 clusterOptions;
+	glm::mat4 cascadeMatrices[SHADOW_CASCADES];
+	// the view depth each cascade ends at
+	glm::vec4 cascadeSplits;
 };
 
 struct GPUModelData {
 	glm::mat4 matrix;
+	// world space bounds, read by the GPU occlusion cull
+	glm::vec4 boundsMin;
+	glm::vec4 boundsMax;
+	// index into the material buffer, the padding keeps the size at the shaders' array stride
+	uint32_t material;
+	uint32_t padding[3];
+};
+
+// Matches DrawCommand in occlusioncull.comp. Non-indexed meshes store a VkDrawIndirectCommand in the same space,
+// instanceCount sits at the same offset in both and is the only field the cull writes
+struct GPUDrawCommand {
+	union {
+		VkDrawIndexedIndirectCommand indexed;
+		VkDrawIndirectCommand nonIndexed;
+	};
+	uint32_t objectIndex;
+};
+
+struct GPUCullConstants {
+	glm::mat4 viewProjection;
+	glm::vec2 pyramidSize;
+	uint32_t drawCount;
+	uint32_t phase;
+	uint32_t pyramidValid;
+};
+
+// written by occlusioncull.comp and read back once the frame's timeline value has been reached
+struct GPUCullStats {
+	uint32_t tested{ 0 };
+	uint32_t earlyDrawn{ 0 };
+	uint32_t lateDrawn{ 0 };
+	uint32_t occluded{ 0 };
+};
+
+// the froxel grid lights are binned into, must match lightcull.comp and default.frag
+constexpr uint32_t CLUSTER_X = 16;
+constexpr uint32_t CLUSTER_Y = 9;
+constexpr uint32_t CLUSTER_Z = 24;
+constexpr uint32_t CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+constexpr uint32_t MAX_LIGHTS = 4096;
+
+struct GPULightCullConstants {
+	glm::mat4 view;
+	// x and y are the projection's scale on each axis, z and w the near and far planes
+	glm::vec4 projection;
+	uint32_t lightCount;
+};
+
+// written by lightcull.comp, read back the same way as the cull stats
+struct GPULightStats {
+	uint32_t activeClusters{ 0 };
+	uint32_t lightReferences{ 0 };
+	uint32_t maxLights{ 0 };
+	uint32_t overflowedClusters{ 0 };
+
+	float averageLights() const { return activeClusters > 0 ? (float)lightReferences / activeClusters : 0.f; }
 };
 
 struct FrameData {
 	VkSemaphore presentSemaphore, renderSemaphore;
-	VkFence renderFence;
+	// the frame timeline value signalled by this frame's last submit
+	uint64_t timelineValue{ 0 };
 
 	VkCommandPool commandPool;
 	VkCommandBuffer mainCommandBuffer;
 
+	VkQueryPool timestampPool;
+	bool timestampsWritten{ false };
+
 	AllocatedBuffer cameraBuffer;
 	AllocatedBuffer modelBuffer;
+	AllocatedBuffer objectStagingBuffer;
 	VkDescriptorSet globalDescriptor;
 	VkDescriptorSet modelDescriptor;
+
+	AllocatedBuffer drawCommandBuffer;
+	AllocatedBuffer lateDrawCommandBuffer;
+	AllocatedBuffer cullStatsBuffer;
+	// allocated from transientDescriptors every frame
+	VkDescriptorSet cullDescriptor{ VK_NULL_HANDLE };
+	bool cullStatsWritten{ false };
+
+	// the light list is only copied in when it changed since this frame's last use
+	AllocatedBuffer lightBuffer;
+	uint64_t lightVersion{ UINT64_MAX };
+	// same for the material parameters
+	AllocatedBuffer materialBuffer;
+	uint64_t materialVersion{ UINT64_MAX };
+	AllocatedBuffer clusterBuffer;
+	AllocatedBuffer lightStatsBuffer;
+	VkDescriptorSet lightCullDescriptor;
+	bool lightStatsWritten{ false };
+
+	// whether the static shadow cache was redrawn or the depth pre-pass ran, their timestamps are only worth reading back then
+	bool shadowCacheRefreshed{ false };
+	bool depthPrepassMeasured{ false };
+
+	// set when the images behind the frame's sets were rebuilt, they are only rewritten once the frame is no longer in flight
+	bool imageDescriptorsStale{ true };
+
+	// sets that only live for the frame, the pools are reset once it has retired
+	DescriptorAllocator transientDescriptors;
 };
 
 struct UploadContext {
 	VkFence uploadFence;
 	VkCommandPool commandPool;
 	VkCommandBuffer commandBuffer;
+	// counts the submits, and the last one the fence was seen to signal
+	uint64_t submitValue{ 0 };
+	uint64_t completedValue{ 0 };
+};
+
+// One staging chunk's part of a transfer, dataOffset is where its bytes start in the source and the destination
+struct StagedCopy {
+	VkBuffer buffer;
+	VkDeviceSize dataOffset;
+	VkDeviceSize size;
 };
 
+// Records the copies out of one submit's chunks. first and last are set on the transfer's first and last submits,
+// for anything that has to happen once around the copies like layout transitions
+typedef std::function<void(VkCommandBuffer cmd, const StagedCopy* copies, uint32_t copyCount, bool first, bool last)> StagedCopyFunction;
+// Writes `size` bytes of the source, starting at `offset`, straight into mapped staging memory. Sources that can produce their
+// bytes piece by piece never need the whole transfer in host memory, returning false abandons the upload
+typedef std::function<bool(void* destination, VkDeviceSize offset, VkDeviceSize size)> StagedReadFunction;
+
 struct DeletionQueue {
 	std::deque<std::function<void()>> deletors;
 
@@ -70,24 +202,146 @@ struct DeletionQueue {
 	}
 };
 
+struct StaticBatchStats {
+	uint32_t sourceObjects{ 0 };
+	uint32_t batches{ 0 };
+	uint32_t dynamicObjects{ 0 };
+	size_t sourceBytes{ 0 };
+	size_t batchedBytes{ 0 };
+};
+
 struct LoadModelInfo {
 	std::string filePath;
 	bool textured{ false };
 	std::string texturePath;
+	// anything but the defaults gives the model its own material on top of the texture's
+	glm::vec4 color{ 1.f };
+	glm::vec3 emissive{ 0.f };
+	float emissiveStrength{ 0.f };
+};
+
+// Unreferenced meshes and textures are evicted, oldest first, while the loaded ones take up more than this
+struct AssetBudget {
+	uint32_t cpuMegabytes{ 512 };
+	uint32_t gpuMegabytes{ 1024 };
+};
+
+struct AssetStats {
+	uint32_t evictedMeshes{ 0 };
+	uint32_t evictedTextures{ 0 };
 };
 
-constexpr uint32_t FRAME_OVERLAP = 2;
+// a texture set whose bind state was evicted, handed out again once the frames that may have bound it have retired
+struct RetiredDescriptorSet {
+	uint64_t timelineValue;
+	VkDescriptorSet set;
+};
+
+// a mesh buffer or texture recreated on the memory a defragmentation pass moves it to
+struct DefragmentationBufferMove {
+	AllocatedBuffer* target;
+	VkBuffer buffer;
+	VkDeviceSize size;
+};
+
+struct DefragmentationTextureMove {
+	Texture* target;
+	VkImage image;
+	VkImageView view;
+};
+
+// the moves of the current defragmentation pass, copied by one frame and swapped in once that frame has finished
+struct DefragmentationMoves {
+	std::vector<DefragmentationBufferMove> buffers;
+	std::vector<DefragmentationTextureMove> textures;
+	bool recorded{ false };
+	// the timeline value of the frame the copies were recorded into
+	uint64_t copyValue{ 0 };
+
+	bool empty() const { return buffers.empty() && textures.empty(); }
+};
+
+struct FramePacingStats {
+	// how long the CPU blocked waiting for a frame to become free
+	float cpuWait{ 0.f };
+	// the gap on the GPU between the end of one frame and the start of the next
+	float gpuIdle{ 0.f };
+};
+
+struct GPUTimings {
+	float depthPrepass{ 0.f };
+	float mainPass{ 0.f };
+	float total{ 0.f };
+	float cascades[SHADOW_CASCADES]{};
+	// only measured on frames that redraw the cache, so it holds the last refresh
+	float shadowCacheRefresh{ 0.f };
+};
+
+// how many frames the CPU may record ahead of the GPU, from lowest latency to the most overlap
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+// the frame's begin and end, then a begin and end query for the depth pre-pass, the main pass, each cascade and the static cache refresh.
+// The graph is free to reorder passes, so every pass measured gets its own pair instead of sharing a boundary with its neighbour
+constexpr uint32_t TIMESTAMP_FRAME = 0;
+constexpr uint32_t TIMESTAMP_DEPTH_PREPASS = 2;
+constexpr uint32_t TIMESTAMP_MAIN = 4;
+constexpr uint32_t TIMESTAMP_CASCADES = 6;
+constexpr uint32_t TIMESTAMP_SHADOW_CACHE = TIMESTAMP_CASCADES + 2 * SHADOW_CASCADES;
+constexpr uint32_t TIMESTAMP_COUNT = TIMESTAMP_SHADOW_CACHE + 2;
 
 class Renderer {
 public:
-	void init(Window& window, uint32_t* pFrameNumber, Console& console);
+	void init(Window& window, uint32_t* pFrameNumber, Console& console, JobSystem& jobSystem);
 	void draw();
 	void drawDebug();
 	void cleanup();
+	// Resets this frame's arena and rebinds the per-frame containers to it, called before anything is queued for the frame
+	void beginFrame();
 
+	// The model holds a reference on its mesh and texture, and on the material made for its color and emissive, until it is passed to releaseModel
 	void loadModel(Model& model, LoadModelInfo info);
+	// Gives back the model's references, its render objects have to be removed first. The assets stay loaded until the budget needs them evicted
+	void releaseModel(Model& model);
+	// Returns the variant's base material straight away, it draws with the default material's pipelines until its own are compiled
+	MaterialId loadMaterialVariant(const std::string& name, const char* vertexShaderPath, const char* fragmentShaderPath);
+	// Shares the pipelines and sets of `base`, so objects using either still draw in the same batches. Returns INVALID_MATERIAL past MAX_MATERIALS.
+	// Holds a reference on the base's texture until it is released, so its bind state can't be evicted from under it
+	MaterialId createMaterial(MaterialId base, const MaterialParameters& parameters);
+	void setMaterialParameters(MaterialId material, const MaterialParameters& parameters);
+	const MaterialParameters* getMaterialParameters(MaterialId material) const;
+	// Gives back the reference createMaterial returned with, the material is freed once static batches drawing with it let go as well.
+	// Anything else still drawing with it has to be moved off it first
+	void releaseMaterial(MaterialId material);
 	void addToModelQueue(Model& model);
+
+	RenderObjectHandle addRenderObject(const Model& model, bool isStatic = false);
+	void updateRenderObjectTransform(RenderObjectHandle handle, const glm::mat4& transform);
+	void updateRenderObjectMaterial(RenderObjectHandle handle, MaterialId material);
+	void removeRenderObject(RenderObjectHandle handle);
+	// Merges every static render object into world space batches per material and chunk. Meant to be called once a scene has finished loading
+	void buildStaticBatches(float chunkSize = 32.f);
+	// Occluders are CPU only, so a cheap low-poly stand-in for the visible mesh should be used
+	uint32_t addOccluder(const char* filePath, const glm::mat4& transform);
+	void setOccluderTransform(uint32_t occluder, const glm::mat4& transform);
+	void removeOccluder(uint32_t occluder);
+	// Point and spot lights, shaded per cluster so each fragment only loops over the lights reaching it. Returns UINT32_MAX past MAX_LIGHTS
+	uint32_t addLight(const Light& light);
+	void setLight(uint32_t light, const Light& properties);
+	void removeLight(uint32_t light);
+	// Takes effect when the swapchain is next recreated, falling back to a supported mode if the device lacks it
+	void setPresentMode(VkPresentModeKHR mode);
+	VkPresentModeKHR getRequestedPresentMode() const { return requestedPresentMode; }
+	VkPresentModeKHR getPresentMode() const { return activePresentMode; }
+	static const char* presentModeName(VkPresentModeKHR mode);
 	void immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function);
+	// Copies the source through pooled staging chunks, each holding whole multiples of granularity. When the pool reaches its cap
+	// the copies so far are submitted and waited on so their chunks can be reused, so a transfer of any size streams through a
+	// bounded window over several submits. Returns false if it was abandoned, the copies submitted before that are still carried out
+	bool stageUpload(const StagedReadFunction& read, VkDeviceSize size, VkDeviceSize granularity, const StagedCopyFunction& record);
+	bool stageUpload(const void* source, VkDeviceSize size, VkDeviceSize granularity, const StagedCopyFunction& record);
+	// Destroys the resource once every frame submitted so far has retired, so it can be released while frames are in flight
+	template<typename T>
+	void destroyDeferred(const T& resource) { frameDeletionQueue.push(frameTimelineValue, resource); }
+	AssetBudget assetBudget;
 
 	VkInstance instance; // Vulkan library handle
 	VkDebugUtilsMessengerEXT debugMessenger; // Vulkan debug output handle
@@ -100,6 +354,7 @@ public:
 	bool framebufferResized{ false };
 	Window* window;
 	Console* console;
+	JobSystem* jobSystem;
 	Camera camera;
 	VmaAllocator allocator;
 	AllocatedBuffer createBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
@@ -115,24 +370,89 @@ protected:
 	void initSyncStructure();
 	void initDescriptors();
 	void initPipelines();
-
+	void initDepthPyramid();
+	void initShadows();
+	void initFrames();
+	void cleanupFrames();
+	// Points the frame's sets at the depth pyramid and shadow map, which outlive the frames or get rebuilt on their own
+	void writeFrameImageDescriptors(FrameData& frame);
+	// Waits for the GPU to go idle and rebuilds the frames with the requested count
+	void applyFramesInFlight();
+
+	// Builds the new swapchain from the old one without waiting on the GPU, the old resources retire with the frames still using them
 	void recreateSwapchain();
+	// The cleanups destroy their resources through destroyDeferred, so they are safe to call with frames in flight
 	void cleanupSwapchain();
 	void cleanupFramebuffers();
-
-	Mesh* loadMesh(const char* filename);
-
-	bool loadShaderModule(const char* filePath, VkShaderModule* outShaderModule);
-	void uploadMesh(Mesh& mesh);
+	void cleanupDepthPyramid();
+
+	MeshHandle loadMesh(const char* filename);
+	// Reuses the set of an evicted bind state when one has retired, the pools can't free sets on their own
+	VkDescriptorSet allocateTextureSet();
+	// The set is only valid until this frame comes around again
+	VkDescriptorSet allocateTransientSet(VkDescriptorSetLayout layout);
+	void writeCullDescriptor(FrameData& frame);
+
+	// Returns false with none of the mesh's buffers left behind if any of them failed to upload
+	bool uploadMesh(Mesh& mesh);
+	// Release the GPU resources through destroyDeferred, the caller makes sure nothing draws with them anymore
+	void releaseMesh(Mesh& mesh);
+	void releaseTexture(Texture& texture);
+	// Evicts unreferenced assets, least recently used first, until the loaded ones fit the budget
+	void evictAssets();
+	void evictMesh(MeshHandle handle);
+	void evictTexture(TextureHandle handle);
+	// Loads the model's texture and bind state, returning the base material it draws with
+	MaterialId loadModelMaterial(Model& model, const LoadModelInfo& info);
+	void writeTextureSet(VkDescriptorSet set, const Texture& texture);
+	// Swaps in the last pass's moves once the frame copying them has finished, then starts the next pass,
+	// recreating mesh buffers and textures on their new memory within the time budget
+	void updateDefragmentation(uint64_t completedValue);
+	// Adds the pass copying this frame's moves, ordered after the scene passes that sample the textures being moved
+	void addDefragmentationPass(RenderGraphResource sceneColor);
+	// Points the meshes, textures and their sets at the copies, the old handles and memory retire with the frames still using them
+	void applyDefragmentationMoves();
+	void drawMemoryDebug();
+	AllocatedBuffer uploadBuffer(const void* source, size_t bufferSize, VkBufferUsageFlags usage);
+	// Each read covers whole multiples of granularity, for sources that produce their bytes an element at a time
+	AllocatedBuffer uploadBuffer(const StagedReadFunction& read, size_t bufferSize, VkBufferUsageFlags usage, VkDeviceSize granularity = 1);
 	FrameData& getCurrentFrame();
 
+	void updateSceneBuffers();
+	void bindMaterial(VkCommandBuffer cmd, MaterialBindState& bindState, VkDescriptorSet modelDescriptor);
+	void bindMesh(VkCommandBuffer cmd, Mesh& mesh, bool positionsOnly = false);
+	void drawMesh(VkCommandBuffer cmd, Mesh& mesh, uint32_t firstInstance);
+	void uploadModelQueue();
 	void drawModelsInQueue(VkCommandBuffer cmd);
+	void uploadDirtyRenderObjects();
+	void cullRenderObjects();
+	void drawDepthPrepass(VkCommandBuffer cmd);
+	void drawRenderObjects(VkCommandBuffer cmd);
+	void writeDrawCommands();
+	void dispatchOcclusionCull(VkCommandBuffer cmd, uint32_t phase);
+	void buildDepthPyramid(VkCommandBuffer cmd);
+	void drawRenderObjectsIndirect(VkCommandBuffer cmd, VkBuffer drawCommandBuffer);
+	void readCullStats(FrameData& frame);
+	void uploadLights();
+	void uploadMaterials();
+	void dispatchLightCull(VkCommandBuffer cmd);
+	void readLightStats(FrameData& frame);
+	void drawShadowCasters(VkCommandBuffer cmd, const std::vector<uint32_t>& casters, const glm::mat4& viewProjection, bool drawModelQueue);
+	void readFrameTimestamps(FrameData& frame);
+	// Picks this frame's render resolution from the GPU time just read back
+	void updateRenderExtent();
 	size_t padUniformBufferSize(size_t originalSize);
 
 	ImGui_ImplVulkanH_Window ImGuiWindowData;
 
 
-	VkSwapchainKHR swapchain; // from other articles
+	VkSwapchainKHR swapchain{ VK_NULL_HANDLE }; // from other articles
+	// the swapchain still works but no longer matches the surface, it gets rebuilt before the next acquire
+	bool swapchainOutdated{ false };
+	// vsync by default, the debug window can switch to mailbox or immediate
+	VkPresentModeKHR requestedPresentMode{ VK_PRESENT_MODE_FIFO_KHR };
+	VkPresentModeKHR activePresentMode{ VK_PRESENT_MODE_FIFO_KHR };
+	bool presentModeChanged{ false };
 	VkFormat swapchainImageFormat;
 	std::vector<VkImage> swapchainImages;
 	std::vector<VkImageView> swapchainImageViews;
@@ -143,23 +463,139 @@ protected:
 	GPUSceneData sceneProps;
 	AllocatedBuffer scenePropsBuffer;
 
-	FrameData frames[FRAME_OVERLAP];
+	std::vector<FrameData> frames;
+	uint32_t framesInFlight{ 2 };
+	// set from the debug window, the frames are rebuilt at the start of the next draw
+	uint32_t requestedFramesInFlight{ 2 };
+	// the frames' own sets, kept apart so they can be rebuilt without touching anything else
+	DescriptorAllocator frameDescriptors;
+	VkSemaphore frameTimeline;
+	uint64_t frameTimelineValue{ 0 };
+	// released resources wait here until the timeline passes the last frame submitted when they were released
+	FrameDeletionQueue frameDeletionQueue;
+	FramePacingStats framePacingStats;
+	uint64_t gpuFrameEnd{ 0 };
+	bool gpuFrameEndValid{ false };
 	uint32_t* pFrameNumber;
 
-	VkRenderPass renderPass;
+	// draws the ui straight onto the swapchain image after the scene has been upscaled into it.
+	// The scene passes use dynamic rendering, this one and its framebuffers are only kept for the imgui backend
+	VkRenderPass uiRenderPass;
 	std::vector<VkFramebuffer> framebuffers;
 	VkImageView depthImageView;
 	AllocatedImage depthImage;
 	VkFormat depthFormat;
 
+	// the scene is drawn into the top left renderExtent of the window sized depth and scene color images, then scaled up to the swapchain
+	VkExtent2D renderExtent;
+	DynamicResolution dynamicResolution;
+
 	VkDescriptorSetLayout globalSetLayout;
 	VkDescriptorSetLayout modelSetLayout;
 	VkDescriptorSetLayout singleTextureSetLayout;
-	VkDescriptorPool descriptorPool;
+	// every textured material samples through this one
+	VkSampler textureSampler;
+	DescriptorAllocator descriptorAllocator;
+	DescriptorLayoutCache descriptorLayoutCache;
+	// writes queued outside of init are flushed once per frame, before anything is recorded
+	DescriptorWriter descriptorWriter;
+	// material texture sets are written through a template, scene loads create thousands of them
+	VkDescriptorUpdateTemplate textureSetTemplate;
+
+	PipelineCache pipelineCache;
+	PipelineRegistry pipelineRegistry;
+	PipelineBuilder meshPipelineBuilder;
+	VertexInputDescription meshVertexDescription;
+
+	RenderGraph renderGraph;
 
 	UploadContext uploadContext;
+	StagingPool stagingPool;
 
 	MeshManager meshManager;
 	TextureManager textureManager;
-	std::vector<Model*> modelQueue;
+	MaterialManager materialManager;
+	// the texture each textured bind state samples, the bind state and its materials are evicted along with it
+	std::unordered_map<MaterialBindState*, TextureHandle> materialTextures;
+	std::deque<RetiredDescriptorSet> retiredTextureSets;
+	AssetStats assetStats;
+
+	// memory budgets per heap come from VK_EXT_memory_budget when the device has it, VMA estimates them otherwise
+	bool memoryBudgetSupported{ false };
+	MemoryDefragmenter memoryDefragmenter;
+	DefragmentationMoves defragmentationMoves;
+	// the eviction count the last automatic defragmentation started at
+	uint32_t defragmentedEvictions{ 0 };
+	// the render queue, culling results and upload regions live here and are dropped wholesale at the start of the frame.
+	// One per frame in flight, so the arena being reset is never the one the previous frame's data came from
+	LinearArena frameArenas[MAX_FRAMES_IN_FLIGHT];
+	FrameVector<Model*> modelQueue;
+
+	RenderObjectManager renderObjects;
+	AllocatedBuffer objectBuffer;
+	VkDescriptorSet objectDescriptor;
+	FrameVector<VkBufferCopy> objectCopyRegions;
+	uint32_t objectsUploadedLastFrame{ 0 };
+	uint32_t renderObjectsDrawn{ 0 };
+	FrameVector<uint32_t> visibleRenderObjects;
+	FrameVector<uint8_t> occludedRenderObjects;
+
+	OcclusionCuller occlusionCuller;
+	bool occlusionCullingEnabled{ true };
+	OcclusionStats occlusionStats;
+
+	// toggled from the debug window, depthPrepassActive holds the setting for the frame being recorded
+	bool depthPrepassEnabled{ false };
+	bool depthPrepassActive{ false };
+	VkPipeline depthPrepassPipeline;
+	VkPipelineLayout depthPrepassPipelineLayout;
+	GPUTimings gpuTimings;
+
+	// two phase GPU occlusion culling against a hierarchical depth pyramid built from the depth image
+	bool gpuOcclusionEnabled{ true };
+	bool gpuOcclusionActive{ false };
+	uint32_t indirectDrawCount{ 0 };
+	GPUCullStats gpuCullStats;
+	VkDescriptorSetLayout cullSetLayout;
+	VkPipelineLayout cullPipelineLayout;
+	VkPipeline cullPipeline;
+
+	AllocatedImage depthPyramid;
+	VkImageView depthPyramidView;
+	std::vector<VkImageView> depthPyramidMips;
+	uint32_t depthPyramidWidth;
+	uint32_t depthPyramidHeight;
+	uint32_t depthPyramidLevels;
+	bool depthPyramidValid{ false };
+	// a rebuilt pyramid starts out undefined, the render graph moves it into the general layout the first time the cull uses it
+	VkImageLayout depthPyramidLayout{ VK_IMAGE_LAYOUT_UNDEFINED };
+	VkSampler depthPyramidSampler;
+	VkDescriptorPool depthPyramidDescriptorPool;
+	std::vector<VkDescriptorSet> depthPyramidDescriptors;
+	VkDescriptorSetLayout depthPyramidSetLayout;
+	VkPipelineLayout depthPyramidPipelineLayout;
+	VkPipeline depthPyramidPipeline;
+
+	// clustered forward lighting, the lights are binned into the froxel grid every frame before the main pass
+	LightManager lightManager;
+	GPULightStats lightStats;
+	bool clusterHeatmapEnabled{ false };
+	VkDescriptorSetLayout lightCullSetLayout;
+	VkPipelineLayout lightCullPipelineLayout;
+	VkPipeline lightCullPipeline;
+
+	// cascaded shadow maps for the sun. The far cascades copy their static casters' depth in from the cache and only draw dynamic casters
+	ShadowCascades shadowCascades;
+	AllocatedImage shadowMap;
+	VkImageView shadowMapView;
+	VkImageView shadowLayerViews[SHADOW_CASCADES];
+	AllocatedImage shadowCache;
+	VkImageView shadowCacheLayerViews[SHADOW_CACHED_CASCADES];
+	VkImageLayout shadowCacheLayout{ VK_IMAGE_LAYOUT_UNDEFINED };
+	VkSampler shadowSampler;
+	VkPipeline shadowPipeline;
+	VkPipelineLayout shadowPipelineLayout;
+
+	std::vector<std::unique_ptr<Mesh>> staticBatchMeshes;
+	StaticBatchStats staticBatchStats;
 };
\ No newline at end of file
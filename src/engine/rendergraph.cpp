@@ -0,0 +1,686 @@
+#include "rendergraph.h"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "vulkankinitialisers.h"
+#include "console.h"
+#include "framedeletionqueue.h"
+
+struct UsageInfo {
+	VkPipelineStageFlags2 stages;
+	VkAccessFlags2 readAccess;
+	VkAccessFlags2 writeAccess;
+	VkImageLayout layout;
+};
+
+static UsageInfo getUsageInfo(RenderGraphUsage usage) {
+	switch (usage) {
+	case USAGE_TRANSFER_SRC:
+		return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+	case USAGE_TRANSFER_DST:
+		return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+	case USAGE_HOST:
+		return { VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT, VK_ACCESS_2_HOST_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+	case USAGE_INDIRECT:
+		return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED };
+	case USAGE_VERTEX_INPUT:
+		return {
+			VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT,
+			VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT,
+			VK_ACCESS_2_NONE,
+			VK_IMAGE_LAYOUT_UNDEFINED
+		};
+	case USAGE_VERTEX_STORAGE:
+		return { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+	case USAGE_COMPUTE_STORAGE:
+		return {
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+			VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_IMAGE_LAYOUT_GENERAL
+		};
+	case USAGE_COMPUTE_SAMPLED:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	case USAGE_FRAGMENT_SAMPLED:
+		return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	case USAGE_FRAGMENT_STORAGE:
+		return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+	case USAGE_COLOR_ATTACHMENT:
+		return {
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+		};
+	case USAGE_DEPTH_ATTACHMENT:
+		return {
+			VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+		};
+	case USAGE_PRESENT:
+	default:
+		// the semaphore signalled at the end of the submit already waits for everything, the barrier only has to change the layout
+		return { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+	}
+}
+
+// a starting size, the arena grows to fit the biggest frame it has seen
+constexpr size_t ARENA_SIZE = 64 * 1024;
+
+constexpr VkAccessFlags2 WRITE_ACCESS_MASK =
+	VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+	VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+template<typename T>
+static void hashCombine(uint64_t& seed, const T& value) {
+	seed ^= std::hash<T>{}(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::read(RenderGraphResource resource, RenderGraphUsage usage) {
+	graph.addAccess(pass, resource, usage, true, false);
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::write(RenderGraphResource resource, RenderGraphUsage usage) {
+	graph.addAccess(pass, resource, usage, false, true);
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::sideEffect() {
+	graph.passes[pass].sideEffect = true;
+	return *this;
+}
+
+void RenderGraph::init(VkDevice device, VmaAllocator allocator, Console& console) {
+	this->device = device;
+	this->allocator = allocator;
+	this->console = &console;
+	arena.init(ARENA_SIZE);
+}
+
+void RenderGraph::setDeletionQueue(FrameDeletionQueue& queue, const uint64_t* retireValue) {
+	this->deletionQueue = &queue;
+	this->retireValue = retireValue;
+}
+
+void RenderGraph::cleanup() {
+	reset();
+	arena.cleanup();
+	releaseTransients();
+}
+
+void RenderGraph::reset() {
+	for (Pass& pass : passes) {
+		pass.execute.destroy(pass.execute.callable);
+	}
+
+	passes.clear();
+	resources.clear();
+	executionOrder.clear();
+	requestedTransients.clear();
+	arena.reset();
+}
+
+RenderGraphResource RenderGraph::importImage(const char* name, VkImage image, VkImageAspectFlags aspect, const RenderGraphState& state) {
+	Resource resource;
+	resource.name = name;
+	resource.image = image;
+	resource.aspect = aspect;
+	resource.initialState = state;
+	resources.push_back(resource);
+	return (RenderGraphResource)resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::importBuffer(const char* name, VkBuffer buffer, const RenderGraphState& state) {
+	Resource resource;
+	resource.name = name;
+	resource.buffer = buffer;
+	resource.initialState = state;
+	resources.push_back(resource);
+	return (RenderGraphResource)resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::createImage(const char* name, const RenderGraphImageInfo& info) {
+	Resource resource;
+	resource.name = name;
+	resource.aspect = info.aspect;
+	resource.transient = true;
+	resource.transientIndex = (uint32_t)requestedTransients.size();
+	resources.push_back(resource);
+
+	TransientImage transient;
+	transient.name = name;
+	transient.info = info;
+	requestedTransients.push_back(transient);
+
+	return (RenderGraphResource)resources.size() - 1;
+}
+
+void RenderGraph::markOutput(RenderGraphResource resource, RenderGraphUsage finalUsage) {
+	resources[resource].output = true;
+	resources[resource].finalUsage = finalUsage;
+}
+
+RenderGraphPassBuilder RenderGraph::pushPass(Pass&& pass) {
+	pass.accesses = FrameVector<Access>(arena);
+	passes.push_back(std::move(pass));
+	return RenderGraphPassBuilder(*this, (uint32_t)passes.size() - 1);
+}
+
+void RenderGraph::addAccess(uint32_t pass, RenderGraphResource resource, RenderGraphUsage usage, bool read, bool write) {
+	const UsageInfo info = getUsageInfo(usage);
+	if ((read && info.readAccess == VK_ACCESS_2_NONE) || (write && info.writeAccess == VK_ACCESS_2_NONE)) {
+		console->log(std::string("[WARN]: Render graph pass ") + passes[pass].name + " uses " + resources[resource].name + " in a way its usage doesn't allow");
+	}
+
+	for (Access& access : passes[pass].accesses) {
+		if (access.resource != resource) {
+			continue;
+		}
+
+		if (access.usage == usage) {
+			access.read |= read;
+			access.write |= write;
+			return;
+		}
+
+		if (resources[resource].buffer == VK_NULL_HANDLE && getUsageInfo(access.usage).layout != info.layout) {
+			console->log(std::string("[ERROR]: Render graph pass ") + passes[pass].name + " needs " + resources[resource].name + " in two different layouts");
+		}
+	}
+
+	passes[pass].accesses.push_back({ resource, usage, read, write });
+}
+
+void RenderGraph::compile() {
+	cullPasses();
+	sortPasses();
+	allocateTransients();
+
+	stats.passes = (uint32_t)executionOrder.size();
+	stats.culledPasses = (uint32_t)(passes.size() - executionOrder.size());
+}
+
+void RenderGraph::cullPasses() {
+	// every read depends on whichever pass wrote the resource last, walking that backwards from the outputs finds everything that matters
+	FrameVector<FrameVector<uint32_t>> producers(passes.size(), FrameVector<uint32_t>(arena), arena);
+	FrameVector<int32_t> lastWriter(resources.size(), -1, arena);
+
+	for (uint32_t p = 0; p < (uint32_t)passes.size(); ++p) {
+		for (const Access& access : passes[p].accesses) {
+			if (access.read && lastWriter[access.resource] >= 0) {
+				producers[p].push_back((uint32_t)lastWriter[access.resource]);
+			}
+		}
+
+		for (const Access& access : passes[p].accesses) {
+			if (access.write) {
+				lastWriter[access.resource] = (int32_t)p;
+			}
+		}
+	}
+
+	for (Pass& pass : passes) {
+		pass.live = pass.sideEffect;
+	}
+
+	for (uint32_t r = 0; r < (uint32_t)resources.size(); ++r) {
+		if (resources[r].output && lastWriter[r] >= 0) {
+			passes[lastWriter[r]].live = true;
+		}
+	}
+
+	for (int32_t p = (int32_t)passes.size() - 1; p >= 0; --p) {
+		if (!passes[p].live) {
+			continue;
+		}
+
+		for (uint32_t producer : producers[p]) {
+			passes[producer].live = true;
+		}
+	}
+}
+
+void RenderGraph::sortPasses() {
+	// a pass can only run once everything it depends on has, so its level is one past its deepest dependency.
+	// Passes sharing a level are independent of each other and get all of their barriers in one batch
+	FrameVector<int32_t> lastWriter(resources.size(), -1, arena);
+	FrameVector<FrameVector<uint32_t>> readers(resources.size(), FrameVector<uint32_t>(arena), arena);
+	FrameVector<VkImageLayout> layouts(resources.size(), VK_IMAGE_LAYOUT_UNDEFINED, arena);
+
+	for (uint32_t r = 0; r < (uint32_t)resources.size(); ++r) {
+		layouts[r] = resources[r].transient ? VK_IMAGE_LAYOUT_UNDEFINED : resources[r].initialState.layout;
+	}
+
+	for (uint32_t p = 0; p < (uint32_t)passes.size(); ++p) {
+		Pass& pass = passes[p];
+		if (!pass.live) {
+			continue;
+		}
+
+		pass.level = 0;
+		auto dependOn = [&](int32_t other) {
+			if (other >= 0 && (uint32_t)other != p) {
+				pass.level = std::max(pass.level, passes[other].level + 1);
+			}
+		};
+
+		for (const Access& access : pass.accesses) {
+			const bool isImage = resources[access.resource].buffer == VK_NULL_HANDLE;
+			const bool modifies = access.write || (isImage && layouts[access.resource] != getUsageInfo(access.usage).layout);
+
+			dependOn(lastWriter[access.resource]);
+			if (modifies) {
+				for (uint32_t reader : readers[access.resource]) {
+					dependOn((int32_t)reader);
+				}
+			}
+		}
+
+		for (const Access& access : pass.accesses) {
+			const bool isImage = resources[access.resource].buffer == VK_NULL_HANDLE;
+			const VkImageLayout layout = getUsageInfo(access.usage).layout;
+
+			if (access.write || (isImage && layouts[access.resource] != layout)) {
+				lastWriter[access.resource] = (int32_t)p;
+				readers[access.resource].clear();
+				if (isImage) {
+					layouts[access.resource] = layout;
+				}
+			} else {
+				readers[access.resource].push_back(p);
+			}
+		}
+
+		executionOrder.push_back(p);
+	}
+
+	// ties go by pass index, which keeps the order stable without the buffer std::stable_sort allocates
+	std::sort(executionOrder.begin(), executionOrder.end(), [&](uint32_t a, uint32_t b) {
+		return passes[a].level != passes[b].level ? passes[a].level < passes[b].level : a < b;
+	});
+}
+
+void RenderGraph::allocateTransients() {
+	for (TransientImage& transient : requestedTransients) {
+		transient.firstLevel = UINT32_MAX;
+		transient.lastLevel = 0;
+	}
+
+	for (uint32_t p : executionOrder) {
+		for (const Access& access : passes[p].accesses) {
+			const Resource& resource = resources[access.resource];
+			if (resource.transient) {
+				TransientImage& transient = requestedTransients[resource.transientIndex];
+				transient.firstLevel = std::min(transient.firstLevel, passes[p].level);
+				transient.lastLevel = std::max(transient.lastLevel, passes[p].level);
+			}
+		}
+	}
+
+	uint64_t signature = requestedTransients.size();
+	for (const TransientImage& transient : requestedTransients) {
+		hashCombine(signature, std::string_view(transient.name));
+		hashCombine(signature, transient.info.format);
+		hashCombine(signature, transient.info.extent.width);
+		hashCombine(signature, transient.info.extent.height);
+		hashCombine(signature, transient.info.usage);
+		hashCombine(signature, transient.firstLevel);
+		hashCombine(signature, transient.lastLevel);
+	}
+
+	if (signature != transientSignature) {
+		// only happens when the passes or their targets change, like a resize or toggling a feature.
+		// Frames in flight may still be using the old images, so they retire with those frames when there is a queue to hand them to
+		if (!transients.empty()) {
+			if (deletionQueue) {
+				retireTransients();
+			} else {
+				vkDeviceWaitIdle(device);
+				releaseTransients();
+			}
+		}
+
+		transients = requestedTransients;
+		transientSignature = signature;
+
+		std::vector<uint32_t> bySize;
+		for (uint32_t i = 0; i < (uint32_t)transients.size(); ++i) {
+			TransientImage& transient = transients[i];
+			if (transient.firstLevel == UINT32_MAX) {
+				continue;
+			}
+
+			VkExtent3D extent = { transient.info.extent.width, transient.info.extent.height, 1 };
+			VkImageCreateInfo imageInfo = vkinit::imageCreateInfo(transient.info.format, transient.info.usage, extent);
+			VK_CHECK(vkCreateImage(device, &imageInfo, nullptr, &transient.image), *console);
+			vkGetImageMemoryRequirements(device, transient.image, &transient.requirements);
+			bySize.push_back(i);
+		}
+
+		// biggest first, each image goes into the first slot it fits in without overlapping an image already there
+		std::sort(bySize.begin(), bySize.end(), [&](uint32_t a, uint32_t b) {
+			return transients[a].requirements.size > transients[b].requirements.size;
+		});
+
+		std::vector<VkDeviceSize> alignments;
+		for (uint32_t index : bySize) {
+			TransientImage& transient = transients[index];
+
+			uint32_t slotIndex = 0;
+			for (; slotIndex < (uint32_t)slots.size(); ++slotIndex) {
+				MemorySlot& slot = slots[slotIndex];
+				if ((slot.memoryTypeBits & transient.requirements.memoryTypeBits) == 0) {
+					continue;
+				}
+
+				bool overlaps = false;
+				for (const auto& [first, last] : slot.lifetimes) {
+					if (transient.firstLevel <= last && first <= transient.lastLevel) {
+						overlaps = true;
+						break;
+					}
+				}
+
+				if (!overlaps) {
+					break;
+				}
+			}
+
+			if (slotIndex == (uint32_t)slots.size()) {
+				MemorySlot slot;
+				slot.memoryTypeBits = transient.requirements.memoryTypeBits;
+				slots.push_back(slot);
+				alignments.push_back(1);
+			}
+
+			MemorySlot& slot = slots[slotIndex];
+			slot.size = std::max(slot.size, transient.requirements.size);
+			slot.memoryTypeBits &= transient.requirements.memoryTypeBits;
+			slot.lifetimes.push_back({ transient.firstLevel, transient.lastLevel });
+			alignments[slotIndex] = std::max(alignments[slotIndex], transient.requirements.alignment);
+			transient.slot = slotIndex;
+		}
+
+		for (uint32_t s = 0; s < (uint32_t)slots.size(); ++s) {
+			VkMemoryRequirements requirements;
+			requirements.size = slots[s].size;
+			requirements.alignment = alignments[s];
+			requirements.memoryTypeBits = slots[s].memoryTypeBits;
+
+			VmaAllocationCreateInfo allocationInfo = {};
+			allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+			VK_CHECK(vmaAllocateMemory(allocator, &requirements, &allocationInfo, &slots[s].allocation, nullptr), *console);
+		}
+
+		stats.transientImages = 0;
+		stats.transientBytes = 0;
+		stats.allocatedBytes = 0;
+
+		for (uint32_t index : bySize) {
+			TransientImage& transient = transients[index];
+			VK_CHECK(vmaBindImageMemory(allocator, slots[transient.slot].allocation, transient.image), *console);
+
+			VkImageViewCreateInfo viewInfo = vkinit::imageviewCreateInfo(transient.info.format, transient.image, transient.info.aspect);
+			VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &transient.view), *console);
+
+			++stats.transientImages;
+			stats.transientBytes += transient.requirements.size;
+		}
+
+		for (const MemorySlot& slot : slots) {
+			stats.allocatedBytes += slot.size;
+		}
+
+		if (!bySize.empty()) {
+			console->log(
+				"Render graph placed " + std::to_string(stats.transientImages) + " transient images in " + std::to_string(slots.size()) +
+				" allocations (" + std::to_string(stats.allocatedBytes / 1024) + "KB, " + std::to_string(stats.savedBytes() / 1024) + "KB saved by aliasing)"
+			);
+		}
+	}
+
+	for (Resource& resource : resources) {
+		if (resource.transient) {
+			resource.image = transients[resource.transientIndex].image;
+		}
+	}
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd) {
+	stats.barriers = 0;
+	stats.barrierBatches = 0;
+
+	states.assign(resources.size(), TrackedState{});
+	for (uint32_t r = 0; r < (uint32_t)resources.size(); ++r) {
+		const RenderGraphState& initial = resources[r].initialState;
+		TrackedState& state = states[r];
+		if (resources[r].transient) {
+			continue;
+		}
+
+		if (initial.access & WRITE_ACCESS_MASK) {
+			state.writeStages = initial.stages;
+			state.writeAccess = initial.access;
+		} else {
+			state.readStages = initial.stages;
+		}
+		state.layout = initial.layout;
+	}
+
+	size_t levelStart = 0;
+	while (levelStart < executionOrder.size()) {
+		const uint32_t level = passes[executionOrder[levelStart]].level;
+		size_t levelEnd = levelStart;
+		while (levelEnd < executionOrder.size() && passes[executionOrder[levelEnd]].level == level) {
+			++levelEnd;
+		}
+
+		for (size_t i = levelStart; i < levelEnd; ++i) {
+			for (const Access& access : passes[executionOrder[i]].accesses) {
+				transition(access.resource, access.usage, access.read, access.write);
+			}
+		}
+		flushBarriers(cmd);
+
+		for (size_t i = levelStart; i < levelEnd; ++i) {
+			const PassCallback& callback = passes[executionOrder[i]].execute;
+			callback.invoke(callback.callable, cmd);
+		}
+
+		levelStart = levelEnd;
+	}
+
+	for (uint32_t r = 0; r < (uint32_t)resources.size(); ++r) {
+		if (resources[r].output) {
+			transition(r, resources[r].finalUsage, true, false);
+		}
+	}
+	flushBarriers(cmd);
+}
+
+void RenderGraph::transition(RenderGraphResource resource, RenderGraphUsage usage, bool read, bool write) {
+	const UsageInfo info = getUsageInfo(usage);
+	const Resource& target = resources[resource];
+	TrackedState& state = states[resource];
+
+	// an image moving into aliased memory has to wait for whatever used that memory last, its old contents are thrown away
+	if (target.transient && !state.touched) {
+		MemorySlot& slot = slots[transients[target.transientIndex].slot];
+		state.writeStages = slot.lastStages;
+		slot.lastStages = VK_PIPELINE_STAGE_2_NONE;
+	}
+	if (target.transient) {
+		slots[transients[target.transientIndex].slot].lastStages |= info.stages;
+	}
+	state.touched = true;
+
+	const VkAccessFlags2 access = (read ? info.readAccess : VK_ACCESS_2_NONE) | (write ? info.writeAccess : VK_ACCESS_2_NONE);
+	const bool isImage = target.image != VK_NULL_HANDLE;
+	const bool layoutChange = isImage && state.layout != info.layout;
+
+	VkPipelineStageFlags2 srcStages;
+	VkAccessFlags2 srcAccess;
+	VkImageLayout oldLayout = state.layout;
+
+	if (write || layoutChange) {
+		// writes and layout changes wait for the last write and every read since, so nothing still reads what gets overwritten
+		srcStages = state.writeStages | state.readStages;
+		srcAccess = state.writeAccess;
+
+		state.writeStages = info.stages;
+		state.writeAccess = write ? info.writeAccess : VK_ACCESS_2_NONE;
+		state.readStages = VK_PIPELINE_STAGE_2_NONE;
+		state.visibleStages = info.stages;
+		state.visibleAccess = access;
+		if (isImage) {
+			state.layout = info.layout;
+		}
+
+		if (srcStages == VK_PIPELINE_STAGE_2_NONE && !layoutChange) {
+			return;
+		}
+	} else {
+		state.readStages |= info.stages;
+
+		// reads only wait for the last write, and only if an earlier barrier hasn't already made it visible to them
+		const bool visible = (state.visibleStages & info.stages) == info.stages && (state.visibleAccess & access) == access;
+		if (state.writeStages == VK_PIPELINE_STAGE_2_NONE || visible) {
+			return;
+		}
+
+		srcStages = state.writeStages;
+		srcAccess = state.writeAccess;
+		state.visibleStages |= info.stages;
+		state.visibleAccess |= access;
+	}
+
+	if (isImage) {
+		for (VkImageMemoryBarrier2& barrier : imageBarriers) {
+			if (barrier.image == target.image) {
+				barrier.srcStageMask |= srcStages;
+				barrier.srcAccessMask |= srcAccess;
+				barrier.dstStageMask |= info.stages;
+				barrier.dstAccessMask |= access;
+				barrier.newLayout = info.layout;
+				return;
+			}
+		}
+
+		VkImageMemoryBarrier2 barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.pNext = nullptr;
+		barrier.srcStageMask = srcStages;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstStageMask = info.stages;
+		barrier.dstAccessMask = access;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = info.layout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = target.image;
+		barrier.subresourceRange = { target.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+		imageBarriers.push_back(barrier);
+	} else {
+		for (VkBufferMemoryBarrier2& barrier : bufferBarriers) {
+			if (barrier.buffer == target.buffer) {
+				barrier.srcStageMask |= srcStages;
+				barrier.srcAccessMask |= srcAccess;
+				barrier.dstStageMask |= info.stages;
+				barrier.dstAccessMask |= access;
+				return;
+			}
+		}
+
+		VkBufferMemoryBarrier2 barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+		barrier.pNext = nullptr;
+		barrier.srcStageMask = srcStages;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstStageMask = info.stages;
+		barrier.dstAccessMask = access;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = target.buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		bufferBarriers.push_back(barrier);
+	}
+}
+
+void RenderGraph::flushBarriers(VkCommandBuffer cmd) {
+	if (imageBarriers.empty() && bufferBarriers.empty()) {
+		return;
+	}
+
+	VkDependencyInfo dependencyInfo = {};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.pNext = nullptr;
+	dependencyInfo.bufferMemoryBarrierCount = (uint32_t)bufferBarriers.size();
+	dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+	dependencyInfo.imageMemoryBarrierCount = (uint32_t)imageBarriers.size();
+	dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+	vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+	stats.barriers += (uint32_t)(bufferBarriers.size() + imageBarriers.size());
+	++stats.barrierBatches;
+
+	bufferBarriers.clear();
+	imageBarriers.clear();
+}
+
+VkImage RenderGraph::getImage(RenderGraphResource resource) const {
+	return resources[resource].image;
+}
+
+VkImageView RenderGraph::getImageView(RenderGraphResource resource) const {
+	const Resource& target = resources[resource];
+	return target.transient ? transients[target.transientIndex].view : VK_NULL_HANDLE;
+}
+
+void RenderGraph::releaseTransients() {
+	for (TransientImage& transient : transients) {
+		if (transient.view != VK_NULL_HANDLE) {
+			vkDestroyImageView(device, transient.view, nullptr);
+		}
+		if (transient.image != VK_NULL_HANDLE) {
+			vkDestroyImage(device, transient.image, nullptr);
+		}
+	}
+
+	for (MemorySlot& slot : slots) {
+		if (slot.allocation != VK_NULL_HANDLE) {
+			vmaFreeMemory(allocator, slot.allocation);
+		}
+	}
+
+	clearTransients();
+}
+
+void RenderGraph::retireTransients() {
+	// views before their images, and the images before the memory they are bound to
+	for (TransientImage& transient : transients) {
+		deletionQueue->push(*retireValue, transient.view);
+		deletionQueue->push(*retireValue, AllocatedImage{ transient.image, VK_NULL_HANDLE });
+	}
+
+	for (MemorySlot& slot : slots) {
+		deletionQueue->push(*retireValue, slot.allocation);
+	}
+
+	clearTransients();
+}
+
+void RenderGraph::clearTransients() {
+	transients.clear();
+	slots.clear();
+	transientSignature = 0;
+	stats.transientImages = 0;
+	stats.transientBytes = 0;
+	stats.allocatedBytes = 0;
+}
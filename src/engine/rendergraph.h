@@ -0,0 +1,228 @@
+#pragma once
+
+class Console;
+class FrameDeletionQueue;
+
+#include <utils/types.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "framearena.h"
+
+typedef uint32_t RenderGraphResource;
+
+// How a pass touches a resource. Each usage maps to a pipeline stage, its read and write access, and the image layout it needs
+enum RenderGraphUsage
+{
+	USAGE_TRANSFER_SRC,
+	USAGE_TRANSFER_DST,
+	USAGE_HOST,
+	USAGE_INDIRECT,
+	// vertex and index buffers
+	USAGE_VERTEX_INPUT,
+	USAGE_VERTEX_STORAGE,
+	// storage buffers and images in the general layout, which covers sampling them as well
+	USAGE_COMPUTE_STORAGE,
+	USAGE_COMPUTE_SAMPLED,
+	USAGE_FRAGMENT_SAMPLED,
+	USAGE_FRAGMENT_STORAGE,
+	USAGE_COLOR_ATTACHMENT,
+	USAGE_DEPTH_ATTACHMENT,
+	USAGE_PRESENT
+};
+
+// The state a resource is in when it gets imported, normally whatever its last use in the previous frame was
+struct RenderGraphState {
+	VkPipelineStageFlags2 stages{ VK_PIPELINE_STAGE_2_NONE };
+	VkAccessFlags2 access{ VK_ACCESS_2_NONE };
+	VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+};
+
+struct RenderGraphImageInfo {
+	VkFormat format;
+	VkExtent2D extent;
+	VkImageUsageFlags usage;
+	VkImageAspectFlags aspect;
+};
+
+struct RenderGraphStats {
+	uint32_t passes{ 0 };
+	uint32_t culledPasses{ 0 };
+	uint32_t barriers{ 0 };
+	uint32_t barrierBatches{ 0 };
+	uint32_t transientImages{ 0 };
+	// what the transient images would take up on their own, and what they take up sharing memory
+	VkDeviceSize transientBytes{ 0 };
+	VkDeviceSize allocatedBytes{ 0 };
+
+	VkDeviceSize savedBytes() const { return transientBytes - allocatedBytes; }
+};
+
+class RenderGraph;
+
+// Returned by addPass to declare what the pass reads and writes. A pass that loads an attachment both reads and writes it
+class RenderGraphPassBuilder {
+public:
+	RenderGraphPassBuilder(RenderGraph& graph, uint32_t pass) : graph(graph), pass(pass) {}
+
+	RenderGraphPassBuilder& read(RenderGraphResource resource, RenderGraphUsage usage);
+	RenderGraphPassBuilder& write(RenderGraphResource resource, RenderGraphUsage usage);
+	// Keeps the pass even when nothing reads what it writes
+	RenderGraphPassBuilder& sideEffect();
+
+protected:
+	RenderGraph& graph;
+	uint32_t pass;
+};
+
+// Passes are added every frame in the order they would run, then compile culls the ones nothing depends on,
+// groups the rest into dependency levels and plans the synchronization2 barriers between them.
+// Transient images are created by the graph and share memory whenever their lifetimes don't overlap.
+// Everything built for a frame comes out of the graph's own arena, names aren't copied and have to outlive the frame
+class RenderGraph {
+public:
+	void init(VkDevice device, VmaAllocator allocator, Console& console);
+	// Transient images replaced by a later compile, like after a resize, go to the queue to retire at *retireValue
+	// instead of waiting for the device to go idle
+	void setDeletionQueue(FrameDeletionQueue& queue, const uint64_t* retireValue);
+	void cleanup();
+
+	// Drops the passes and resources of the last frame. Transient memory is kept for the next compile to reuse
+	void reset();
+
+	RenderGraphResource importImage(const char* name, VkImage image, VkImageAspectFlags aspect, const RenderGraphState& state);
+	RenderGraphResource importBuffer(const char* name, VkBuffer buffer, const RenderGraphState& state);
+	RenderGraphResource createImage(const char* name, const RenderGraphImageInfo& info);
+	// Passes writing an output are never culled, and the output ends the frame in the given usage
+	void markOutput(RenderGraphResource resource, RenderGraphUsage finalUsage);
+
+	// The callable is moved into the arena rather than a std::function, so however much it captures it never touches the heap
+	template<typename F>
+	RenderGraphPassBuilder addPass(const char* name, F&& execute) {
+		using Callable = std::decay_t<F>;
+		Pass pass;
+		pass.name = name;
+		pass.execute.callable = new (arena.allocate(sizeof(Callable), alignof(Callable))) Callable(std::forward<F>(execute));
+		pass.execute.invoke = [](void* callable, VkCommandBuffer cmd) { (*static_cast<Callable*>(callable))(cmd); };
+		pass.execute.destroy = [](void* callable) { static_cast<Callable*>(callable)->~Callable(); };
+		return pushPass(std::move(pass));
+	}
+
+	void compile();
+	void execute(VkCommandBuffer cmd);
+
+	VkImage getImage(RenderGraphResource resource) const;
+	// Only transient images get a view from the graph, imported ones keep using their owner's
+	VkImageView getImageView(RenderGraphResource resource) const;
+	// Frees every transient image, for when the GPU is already idle anyway, like on a swapchain rebuild
+	void releaseTransients();
+
+	const RenderGraphStats& getStats() const { return stats; }
+
+protected:
+	friend class RenderGraphPassBuilder;
+
+	struct Access {
+		RenderGraphResource resource;
+		RenderGraphUsage usage;
+		bool read;
+		bool write;
+	};
+
+	struct PassCallback {
+		void (*invoke)(void* callable, VkCommandBuffer cmd){ nullptr };
+		void (*destroy)(void* callable){ nullptr };
+		void* callable{ nullptr };
+	};
+
+	struct Pass {
+		const char* name;
+		PassCallback execute;
+		FrameVector<Access> accesses;
+		bool sideEffect{ false };
+		bool live{ false };
+		uint32_t level{ 0 };
+	};
+
+	struct Resource {
+		const char* name;
+		VkImage image{ VK_NULL_HANDLE };
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		VkImageAspectFlags aspect{ 0 };
+		bool transient{ false };
+		uint32_t transientIndex{ 0 };
+		bool output{ false };
+		RenderGraphUsage finalUsage{ USAGE_PRESENT };
+		RenderGraphState initialState;
+	};
+
+	// the tracked state while recording, the write is what later accesses have to wait for and see
+	struct TrackedState {
+		VkPipelineStageFlags2 writeStages{ VK_PIPELINE_STAGE_2_NONE };
+		VkAccessFlags2 writeAccess{ VK_ACCESS_2_NONE };
+		VkPipelineStageFlags2 readStages{ VK_PIPELINE_STAGE_2_NONE };
+		VkPipelineStageFlags2 visibleStages{ VK_PIPELINE_STAGE_2_NONE };
+		VkAccessFlags2 visibleAccess{ VK_ACCESS_2_NONE };
+		VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+		bool touched{ false };
+	};
+
+	struct TransientImage {
+		const char* name;
+		RenderGraphImageInfo info;
+		VkImage image{ VK_NULL_HANDLE };
+		VkImageView view{ VK_NULL_HANDLE };
+		VkMemoryRequirements requirements;
+		uint32_t slot{ 0 };
+		uint32_t firstLevel{ 0 };
+		uint32_t lastLevel{ 0 };
+	};
+
+	// one allocation shared by transient images whose lifetimes never overlap
+	struct MemorySlot {
+		VmaAllocation allocation{ VK_NULL_HANDLE };
+		VkDeviceSize size{ 0 };
+		uint32_t memoryTypeBits{ 0 };
+		std::vector<std::pair<uint32_t, uint32_t>> lifetimes;
+		// the last stages to touch the memory, which the next image placed in it has to wait for
+		VkPipelineStageFlags2 lastStages{ VK_PIPELINE_STAGE_2_NONE };
+	};
+
+	RenderGraphPassBuilder pushPass(Pass&& pass);
+	void addAccess(uint32_t pass, RenderGraphResource resource, RenderGraphUsage usage, bool read, bool write);
+	void cullPasses();
+	void sortPasses();
+	void allocateTransients();
+	// Hands the transient images and their memory to the deletion queue
+	void retireTransients();
+	void clearTransients();
+	void transition(RenderGraphResource resource, RenderGraphUsage usage, bool read, bool write);
+	void flushBarriers(VkCommandBuffer cmd);
+
+	VkDevice device;
+	VmaAllocator allocator;
+	Console* console;
+	FrameDeletionQueue* deletionQueue{ nullptr };
+	const uint64_t* retireValue{ nullptr };
+
+	// reset along with the graph, the passes and their callables, accesses and compile temporaries all live here
+	LinearArena arena;
+	std::vector<Pass> passes;
+	std::vector<Resource> resources;
+	std::vector<uint32_t> executionOrder;
+	std::vector<TrackedState> states;
+
+	// kept between frames, and only rebuilt when the transient images asked for change
+	std::vector<TransientImage> transients;
+	std::vector<MemorySlot> slots;
+	std::vector<TransientImage> requestedTransients;
+	uint64_t transientSignature{ 0 };
+
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+
+	RenderGraphStats stats;
+};
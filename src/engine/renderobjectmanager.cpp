@@ -0,0 +1,164 @@
+#include "renderobjectmanager.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#include "mesh.h"
+
+void RenderObjectManager::init(uint32_t capacity) {
+	this->capacity = capacity;
+	slots.reserve(capacity);
+}
+
+RenderObjectHandle RenderObjectManager::add(const RenderObject& object) {
+	uint32_t index;
+	if (!freeSlots.empty()) {
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	} else {
+		if (slots.size() >= capacity) {
+			return {};
+		}
+
+		index = (uint32_t)slots.size();
+		slots.emplace_back();
+	}
+
+	Slot& slot = slots[index];
+	slot.object = object;
+	slot.alive = true;
+	updateBounds(slot.object);
+	markDirty(index);
+
+	if (object.isStatic) {
+		++staticVersion;
+	}
+
+	++liveCount;
+	drawOrderDirty = true;
+	return { index, slot.generation };
+}
+
+void RenderObjectManager::remove(RenderObjectHandle handle) {
+	Slot* slot = getSlot(handle);
+	if (!slot) {
+		return;
+	}
+
+	slot->alive = false;
+	if (slot->object.isStatic) {
+		++staticVersion;
+	}
+	// bumping the generation invalidates any handles still pointing at this slot
+	++slot->generation;
+	freeSlots.push_back(handle.index);
+
+	--liveCount;
+	drawOrderDirty = true;
+}
+
+void RenderObjectManager::setTransform(RenderObjectHandle handle, const glm::mat4& transform) {
+	Slot* slot = getSlot(handle);
+	if (!slot) {
+		return;
+	}
+
+	slot->object.transformMatrix = transform;
+	updateBounds(slot->object);
+	markDirty(handle.index);
+
+	if (slot->object.isStatic) {
+		++staticVersion;
+	}
+}
+
+void RenderObjectManager::setMaterial(RenderObjectHandle handle, MaterialId material, MaterialBindState* bindState) {
+	Slot* slot = getSlot(handle);
+	if (!slot || slot->object.material == material) {
+		return;
+	}
+
+	// the material index lives in the object buffer, but the draw order only cares about what gets bound
+	slot->object.material = material;
+	markDirty(handle.index);
+	if (slot->object.bindState != bindState) {
+		slot->object.bindState = bindState;
+		drawOrderDirty = true;
+	}
+}
+
+RenderObject* RenderObjectManager::get(RenderObjectHandle handle) {
+	Slot* slot = getSlot(handle);
+	return slot ? &slot->object : nullptr;
+}
+
+const std::vector<uint32_t>& RenderObjectManager::getDrawOrder() {
+	if (!drawOrderDirty) {
+		return drawOrder;
+	}
+
+	drawOrder.clear();
+	for (uint32_t i = 0; i < slots.size(); ++i) {
+		if (slots[i].alive) {
+			drawOrder.push_back(i);
+		}
+	}
+
+	// sort so that objects sharing a bind state and mesh end up next to each other, keeping the binds in the draw loop down.
+	// Materials that only differ in parameters share a bind state, so they land in the same runs
+	std::sort(drawOrder.begin(), drawOrder.end(), [&](uint32_t a, uint32_t b) {
+		const RenderObject& objectA = slots[a].object;
+		const RenderObject& objectB = slots[b].object;
+		if (objectA.bindState != objectB.bindState) {
+			return objectA.bindState < objectB.bindState;
+		}
+
+		return objectA.mesh < objectB.mesh;
+	});
+
+	drawOrderDirty = false;
+	return drawOrder;
+}
+
+void RenderObjectManager::clearDirty(size_t count) {
+	count = std::min(count, dirtySlots.size());
+	for (size_t i = 0; i < count; ++i) {
+		slots[dirtySlots[i]].dirty = false;
+	}
+
+	dirtySlots.erase(dirtySlots.begin(), dirtySlots.begin() + count);
+}
+
+RenderObjectManager::Slot* RenderObjectManager::getSlot(RenderObjectHandle handle) {
+	if (handle.index >= slots.size()) {
+		return nullptr;
+	}
+
+	Slot& slot = slots[handle.index];
+	if (!slot.alive || slot.generation != handle.generation) {
+		return nullptr;
+	}
+
+	return &slot;
+}
+
+void RenderObjectManager::markDirty(uint32_t index) {
+	if (!slots[index].dirty) {
+		slots[index].dirty = true;
+		dirtySlots.push_back(index);
+	}
+}
+
+void RenderObjectManager::updateBounds(RenderObject& object) {
+	// transform all eight corners of the mesh bounds and take the box around them
+	const glm::vec3 corners[2] = { object.mesh->boundsMin, object.mesh->boundsMax };
+	object.boundsMin = glm::vec3{ FLT_MAX };
+	object.boundsMax = glm::vec3{ -FLT_MAX };
+
+	for (uint32_t i = 0; i < 8; ++i) {
+		glm::vec3 corner{ corners[i & 1].x, corners[(i >> 1) & 1].y, corners[(i >> 2) & 1].z };
+		glm::vec3 worldCorner = glm::vec3(object.transformMatrix * glm::vec4(corner, 1.f));
+		object.boundsMin = glm::min(object.boundsMin, worldCorner);
+		object.boundsMax = glm::max(object.boundsMax, worldCorner);
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+struct Mesh;
+
+#include <utils/types.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct RenderObjectHandle {
+	uint32_t index{ UINT32_MAX };
+	uint32_t generation{ 0 };
+
+	bool isValid() const { return index != UINT32_MAX; }
+};
+
+struct RenderObject {
+	Mesh* mesh;
+	MaterialId material;
+	// the material's, cached here so sorting and drawing don't have to look it up
+	MaterialBindState* bindState;
+	glm::mat4 transformMatrix;
+	// static objects are never expected to move and can be merged by Renderer::buildStaticBatches
+	bool isStatic{ false };
+	// the result of static batching, still static but never merged again
+	bool isBatch{ false };
+
+	// world space bounds, kept up to date by the manager whenever the transform changes
+	glm::vec3 boundsMin{ 0.f };
+	glm::vec3 boundsMax{ 0.f };
+};
+
+// Retained-mode store for render objects. Each object keeps the same slot for its whole lifetime,
+// and that slot is also its index in the persistent GPU object buffer, so only objects that
+// have been changed since the last upload need to be written.
+class RenderObjectManager {
+public:
+	void init(uint32_t capacity);
+
+	RenderObjectHandle add(const RenderObject& object);
+	void remove(RenderObjectHandle handle);
+	void setTransform(RenderObjectHandle handle, const glm::mat4& transform);
+	void setMaterial(RenderObjectHandle handle, MaterialId material, MaterialBindState* bindState);
+	RenderObject* get(RenderObjectHandle handle);
+	const RenderObject& getBySlot(uint32_t index) const { return slots[index].object; }
+	RenderObjectHandle getHandle(uint32_t index) const { return { index, slots[index].generation }; }
+
+	// Slot indices of the live objects sorted by bind state and mesh. Only rebuilt when objects are added, removed or change bind state
+	const std::vector<uint32_t>& getDrawOrder();
+	const std::vector<uint32_t>& getDirtySlots() const { return dirtySlots; }
+	// Marks the first `count` dirty slots as uploaded, anything past that stays dirty for the next frame
+	void clearDirty(size_t count);
+
+	// Bumped whenever a static object is added, removed or moved, anything cached from static geometry is stale once it changes
+	uint64_t getStaticVersion() const { return staticVersion; }
+
+	uint32_t getCount() const { return liveCount; }
+	uint32_t getCapacity() const { return capacity; }
+
+protected:
+	struct Slot {
+		RenderObject object;
+		uint32_t generation{ 0 };
+		bool alive{ false };
+		bool dirty{ false };
+	};
+
+	Slot* getSlot(RenderObjectHandle handle);
+	void markDirty(uint32_t index);
+	void updateBounds(RenderObject& object);
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	std::vector<uint32_t> dirtySlots;
+	std::vector<uint32_t> drawOrder;
+	bool drawOrderDirty{ false };
+	uint32_t liveCount{ 0 };
+	uint32_t capacity{ 0 };
+	uint64_t staticVersion{ 0 };
+};
@@ -0,0 +1,174 @@
+#include "shadowcascades.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include "camera.h"
+#include "renderobjectmanager.h"
+
+void ShadowCascades::init(uint32_t resolution) {
+	this->resolution = resolution;
+}
+
+void ShadowCascades::update(const Camera& camera, const glm::vec3& sunDirection, const RenderObjectManager& objects, const std::vector<uint32_t>& drawOrder, uint64_t staticVersion) {
+	const glm::vec3 sun = glm::normalize(sunDirection);
+	const glm::vec3 up = std::abs(sun.y) > 0.99f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+	lightView = glm::lookAt(glm::vec3(0.f), sun, up);
+
+	// anything that changes how the static casters look from the sun throws the cache away
+	if (sun != cachedSunDirection || staticVersion != cachedStaticVersion) {
+		cacheInvalid = true;
+	}
+	cachedSunDirection = sun;
+	cachedStaticVersion = staticVersion;
+
+	const float nearPlane = camera.nearPlane;
+	const float farPlane = std::min(camera.farPlane, settings.shadowDistance);
+	const glm::mat4 inverseView = glm::inverse(camera.view());
+	const float tanHalfFov = std::tan(glm::radians(camera.fov) * 0.5f);
+
+	float sliceNear = nearPlane;
+	for (uint32_t i = 0; i < SHADOW_CASCADES; ++i) {
+		const float t = (float)(i + 1) / SHADOW_CASCADES;
+		const float logSplit = nearPlane * std::pow(farPlane / nearPlane, t);
+		const float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+		const float sliceFar = uniformSplit + (logSplit - uniformSplit) * settings.splitLambda;
+
+		glm::vec3 corners[8];
+		glm::vec3 center{ 0.f };
+		for (uint32_t corner = 0; corner < 8; ++corner) {
+			const float depth = (corner & 4) ? sliceFar : sliceNear;
+			const glm::vec4 viewCorner(
+				((corner & 1) ? 1.f : -1.f) * depth * tanHalfFov * camera.aspect,
+				((corner & 2) ? 1.f : -1.f) * depth * tanHalfFov,
+				-depth,
+				1.f
+			);
+			corners[corner] = glm::vec3(inverseView * viewCorner);
+			center += corners[corner];
+		}
+		center /= 8.f;
+
+		// the sphere only depends on the slice and not on where the camera looks, rounding it keeps float noise from resizing it
+		float radius = 0.f;
+		for (const glm::vec3& corner : corners) {
+			radius = std::max(radius, glm::length(corner - center));
+		}
+		radius = std::ceil(radius * 16.f) / 16.f;
+
+		const glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.f));
+
+		ShadowCascade& cascade = cascades[i];
+		cascade.splitDepth = sliceFar;
+		cascade.cached = settings.cacheStatic && i >= SHADOW_FIRST_CACHED_CASCADE;
+		cascade.refreshCache = false;
+
+		Fit fit;
+		if (cascade.cached) {
+			Fit& cachedFit = cachedFits[i];
+			const glm::vec3 offset = glm::abs(lightCenter - cachedFit.center);
+			const bool covered = cachedFit.valid && std::max(offset.x, std::max(offset.y, offset.z)) + radius <= cachedFit.halfExtent;
+			if (cacheInvalid || !covered) {
+				cachedFit = fitCascade(lightCenter, radius * settings.cacheMargin);
+				cascade.refreshCache = true;
+				++stats.cacheRefreshes;
+			}
+			fit = cachedFit;
+		} else {
+			fit = fitCascade(lightCenter, radius);
+		}
+
+		frameFits[i] = fit;
+		cascade.viewProjection = projectionFor(fit) * lightView;
+		cascade.casters.clear();
+		cascade.staticCasters.clear();
+
+		sliceNear = sliceFar;
+	}
+	// while caching is off nothing keeps the cache up to date, so it has to start over once it's back on
+	cacheInvalid = !settings.cacheStatic;
+
+	// one transform into light space per object, every cascade then only has to compare boxes
+	const size_t objectCount = drawOrder.size();
+	lightBoundsMin.resize(objectCount);
+	lightBoundsMax.resize(objectCount);
+
+	glm::mat3 absoluteRotation = glm::mat3(lightView);
+	for (uint32_t column = 0; column < 3; ++column) {
+		absoluteRotation[column] = glm::abs(absoluteRotation[column]);
+	}
+
+	for (size_t i = 0; i < objectCount; ++i) {
+		const RenderObject& object = objects.getBySlot(drawOrder[i]);
+		const glm::vec3 center = glm::vec3(lightView * glm::vec4((object.boundsMin + object.boundsMax) * 0.5f, 1.f));
+		const glm::vec3 extents = absoluteRotation * ((object.boundsMax - object.boundsMin) * 0.5f);
+		lightBoundsMin[i] = center - extents;
+		lightBoundsMax[i] = center + extents;
+	}
+
+	for (uint32_t cascadeIndex = 0; cascadeIndex < SHADOW_CASCADES; ++cascadeIndex) {
+		ShadowCascade& cascade = cascades[cascadeIndex];
+		const Fit& fit = frameFits[cascadeIndex];
+
+		// casters between the sun and the cascade still throw shadows into it, so the box reaches further on that side
+		const glm::vec3 boxMin = fit.center - glm::vec3(fit.halfExtent);
+		const glm::vec3 boxMax = fit.center + glm::vec3(fit.halfExtent, fit.halfExtent, fit.halfExtent + settings.casterDistance);
+
+		for (size_t i = 0; i < objectCount; ++i) {
+			if (glm::any(glm::lessThan(lightBoundsMax[i], boxMin)) || glm::any(glm::greaterThan(lightBoundsMin[i], boxMax))) {
+				continue;
+			}
+
+			const uint32_t slot = drawOrder[i];
+			if (!cascade.cached || !objects.getBySlot(slot).isStatic) {
+				cascade.casters.push_back(slot);
+			} else if (cascade.refreshCache) {
+				cascade.staticCasters.push_back(slot);
+			}
+		}
+
+		stats.casters[cascadeIndex] = (uint32_t)cascade.casters.size();
+		if (cascade.refreshCache || !cascade.cached) {
+			stats.staticCasters[cascadeIndex] = (uint32_t)cascade.staticCasters.size();
+		}
+	}
+}
+
+void ShadowCascades::invalidateCache() {
+	cacheInvalid = true;
+}
+
+bool ShadowCascades::needsCacheRefresh() const {
+	for (const ShadowCascade& cascade : cascades) {
+		if (cascade.refreshCache) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+ShadowCascades::Fit ShadowCascades::fitCascade(const glm::vec3& center, float halfExtent) const {
+	// moving the box in whole texels means every texel keeps covering the same part of the world
+	const float texelSize = 2.f * halfExtent / resolution;
+
+	Fit fit;
+	fit.center = glm::vec3(std::floor(center.x / texelSize) * texelSize, std::floor(center.y / texelSize) * texelSize, center.z);
+	fit.halfExtent = halfExtent;
+	fit.valid = true;
+	return fit;
+}
+
+glm::mat4 ShadowCascades::projectionFor(const Fit& fit) const {
+	const glm::vec3& center = fit.center;
+	const float halfExtent = fit.halfExtent;
+
+	// the view looks down -z, so the side facing the sun is the largest z
+	return glm::orthoRH_ZO(
+		center.x - halfExtent, center.x + halfExtent,
+		center.y - halfExtent, center.y + halfExtent,
+		-(center.z + halfExtent + settings.casterDistance), -(center.z - halfExtent)
+	);
+}
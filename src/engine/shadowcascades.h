@@ -0,0 +1,87 @@
+#pragma once
+
+class Camera;
+class RenderObjectManager;
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+constexpr uint32_t SHADOW_CASCADES = 4;
+// the last cascades keep their static casters in a cache, the ones before them are redrawn in full every frame
+constexpr uint32_t SHADOW_CACHED_CASCADES = 2;
+constexpr uint32_t SHADOW_FIRST_CACHED_CASCADE = SHADOW_CASCADES - SHADOW_CACHED_CASCADES;
+
+struct ShadowSettings {
+	float shadowDistance{ 100.f };
+	// blends between uniform (0) and logarithmic (1) split distances
+	float splitLambda{ 0.75f };
+	// how far towards the sun casters outside a cascade still get drawn into it
+	float casterDistance{ 100.f };
+	// cached cascades cover this much more than they need to, so the camera can move for a while before they have to be redrawn
+	float cacheMargin{ 1.25f };
+	bool cacheStatic{ true };
+};
+
+struct ShadowCascade {
+	glm::mat4 viewProjection;
+	// the view depth this cascade ends at
+	float splitDepth;
+	// render object slots to draw on top of the cached static depth, or every caster for cascades that aren't cached
+	std::vector<uint32_t> casters;
+	// only filled when the cached static depth has to be redrawn
+	std::vector<uint32_t> staticCasters;
+	bool cached{ false };
+	bool refreshCache{ false };
+};
+
+struct ShadowStats {
+	uint32_t casters[SHADOW_CASCADES]{};
+	uint32_t staticCasters[SHADOW_CASCADES]{};
+	uint32_t cacheRefreshes{ 0 };
+};
+
+// Fits the cascades around the camera and sorts the shadow casters into them, the GPU side lives in the renderer.
+// Cascades are fitted to a bounding sphere and snapped to whole texels, so their edges don't shimmer as the camera moves and turns
+class ShadowCascades {
+public:
+	void init(uint32_t resolution);
+
+	void update(const Camera& camera, const glm::vec3& sunDirection, const RenderObjectManager& objects, const std::vector<uint32_t>& drawOrder, uint64_t staticVersion);
+	// Forces the cached cascades to be redrawn next update, for when the static depth was never written or might be stale
+	void invalidateCache();
+
+	const ShadowCascade& getCascade(uint32_t cascade) const { return cascades[cascade]; }
+	bool needsCacheRefresh() const;
+	const ShadowStats& getStats() const { return stats; }
+
+	ShadowSettings settings;
+
+protected:
+	// a cascade's box in light space, which cached cascades hold on to for as long as it still covers their slice
+	struct Fit {
+		glm::vec3 center{ 0.f };
+		float halfExtent{ 0.f };
+		bool valid{ false };
+	};
+
+	Fit fitCascade(const glm::vec3& center, float halfExtent) const;
+	glm::mat4 projectionFor(const Fit& fit) const;
+
+	uint32_t resolution{ 0 };
+	ShadowCascade cascades[SHADOW_CASCADES];
+	Fit cachedFits[SHADOW_CASCADES];
+	// what each cascade uses this frame, the cached fit or a fresh one
+	Fit frameFits[SHADOW_CASCADES];
+	glm::vec3 cachedSunDirection{ 0.f };
+	uint64_t cachedStaticVersion{ UINT64_MAX };
+	bool cacheInvalid{ true };
+
+	// the light space bounds of every object, filled once per update and shared by all cascades
+	std::vector<glm::vec3> lightBoundsMin;
+	std::vector<glm::vec3> lightBoundsMax;
+	glm::mat4 lightView{ 1.f };
+
+	ShadowStats stats;
+};
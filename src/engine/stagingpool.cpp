@@ -0,0 +1,121 @@
+#include "stagingpool.h"
+
+#include <algorithm>
+
+static VkDeviceSize classSize(uint32_t sizeClass) {
+	return STAGING_MIN_CHUNK_SIZE << sizeClass;
+}
+
+void StagingPool::init(VmaAllocator allocator, VkDeviceSize memoryCap) {
+	this->allocator = allocator;
+	// a transfer always has to be able to get at least one chunk of the largest class
+	this->memoryCap = std::max(memoryCap, STAGING_MAX_CHUNK_SIZE);
+}
+
+void StagingPool::cleanup() {
+	for (std::unique_ptr<StagingChunk>& chunk : chunks) {
+		vmaDestroyBuffer(allocator, chunk->buffer.buffer, chunk->buffer.allocation);
+	}
+
+	chunks.clear();
+	for (std::vector<StagingChunk*>& free : freeChunks) {
+		free.clear();
+	}
+	pendingChunks.clear();
+	stats.chunks = 0;
+	stats.bytes = 0;
+}
+
+StagingChunk* StagingPool::acquire(VkDeviceSize size) {
+	uint32_t sizeClass = 0;
+	while (sizeClass < STAGING_SIZE_CLASSES - 1 && classSize(sizeClass) < size) {
+		++sizeClass;
+	}
+
+	// a bigger free chunk does just as well, and saves growing the pool
+	for (uint32_t freeClass = sizeClass; freeClass < STAGING_SIZE_CLASSES; ++freeClass) {
+		if (!freeChunks[freeClass].empty()) {
+			StagingChunk* chunk = freeChunks[freeClass].back();
+			freeChunks[freeClass].pop_back();
+			++stats.reused;
+			return chunk;
+		}
+	}
+
+	if (!makeRoom(classSize(sizeClass))) {
+		++stats.stalls;
+		return nullptr;
+	}
+
+	return createChunk(sizeClass);
+}
+
+void StagingPool::release(StagingChunk* chunk, uint64_t submitValue) {
+	chunk->submitValue = submitValue;
+	pendingChunks.push_back(chunk);
+}
+
+void StagingPool::recycle(uint64_t completedValue) {
+	auto done = std::partition(pendingChunks.begin(), pendingChunks.end(), [&](const StagingChunk* chunk) {
+		return chunk->submitValue > completedValue;
+	});
+
+	for (auto chunk = done; chunk != pendingChunks.end(); ++chunk) {
+		freeChunks[(*chunk)->sizeClass].push_back(*chunk);
+	}
+
+	pendingChunks.erase(done, pendingChunks.end());
+}
+
+StagingChunk* StagingPool::createChunk(uint32_t sizeClass) {
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = classSize(sizeClass);
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	std::unique_ptr<StagingChunk> chunk = std::make_unique<StagingChunk>();
+	VmaAllocationInfo allocationInfo;
+	if (vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &chunk->buffer.buffer, &chunk->buffer.allocation, &allocationInfo) != VK_SUCCESS) {
+		return nullptr;
+	}
+
+	chunk->mapped = allocationInfo.pMappedData;
+	chunk->size = bufferInfo.size;
+	chunk->sizeClass = sizeClass;
+
+	++stats.chunks;
+	++stats.created;
+	stats.bytes += chunk->size;
+
+	chunks.push_back(std::move(chunk));
+	return chunks.back().get();
+}
+
+void StagingPool::destroyChunk(StagingChunk* chunk) {
+	vmaDestroyBuffer(allocator, chunk->buffer.buffer, chunk->buffer.allocation);
+
+	--stats.chunks;
+	stats.bytes -= chunk->size;
+
+	auto owner = std::find_if(chunks.begin(), chunks.end(), [&](const std::unique_ptr<StagingChunk>& other) {
+		return other.get() == chunk;
+	});
+	chunks.erase(owner);
+}
+
+bool StagingPool::makeRoom(VkDeviceSize size) {
+	for (uint32_t sizeClass = STAGING_SIZE_CLASSES; sizeClass-- > 0 && stats.bytes + size > memoryCap;) {
+		std::vector<StagingChunk*>& free = freeChunks[sizeClass];
+		while (!free.empty() && stats.bytes + size > memoryCap) {
+			destroyChunk(free.back());
+			free.pop_back();
+		}
+	}
+
+	return stats.bytes + size <= memoryCap;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <utils/types.h>
+
+#include <memory>
+#include <vector>
+
+// chunk sizes double from the smallest class up to the largest, transfers past the largest are split across chunks
+constexpr VkDeviceSize STAGING_MIN_CHUNK_SIZE = 64 * 1024;
+constexpr uint32_t STAGING_SIZE_CLASSES = 7;
+constexpr VkDeviceSize STAGING_MAX_CHUNK_SIZE = STAGING_MIN_CHUNK_SIZE << (STAGING_SIZE_CLASSES - 1);
+
+struct StagingChunk {
+	AllocatedBuffer buffer;
+	// mapped for the chunk's whole lifetime
+	void* mapped{ nullptr };
+	VkDeviceSize size{ 0 };
+	uint32_t sizeClass{ 0 };
+	// the upload submit that last read from the chunk
+	uint64_t submitValue{ 0 };
+};
+
+struct StagingPoolStats {
+	uint32_t chunks{ 0 };
+	VkDeviceSize bytes{ 0 };
+	// acquires handed an existing chunk, against those that had to create one
+	uint64_t reused{ 0 };
+	uint64_t created{ 0 };
+	// acquires turned away at the cap with every chunk in flight, the caller has to wait on its earlier copies
+	uint64_t stalls{ 0 };
+};
+
+// Host visible staging buffers in power of two size classes, kept mapped and handed out again once the transfer
+// reading them has finished. Free chunks are dropped to make room for other classes when the pool reaches its cap
+class StagingPool {
+public:
+	void init(VmaAllocator allocator, VkDeviceSize memoryCap);
+	// Nothing may still be reading from the chunks
+	void cleanup();
+
+	// A free chunk of the smallest class that holds `size`, or of the largest class when nothing does.
+	// Returns nullptr when the cap is reached and every chunk is still in flight
+	StagingChunk* acquire(VkDeviceSize size);
+	// The chunk is handed out again once recycle is called with submitValue or later
+	void release(StagingChunk* chunk, uint64_t submitValue);
+	void recycle(uint64_t completedValue);
+
+	VkDeviceSize getCap() const { return memoryCap; }
+	const StagingPoolStats& getStats() const { return stats; }
+
+protected:
+	StagingChunk* createChunk(uint32_t sizeClass);
+	void destroyChunk(StagingChunk* chunk);
+	// Destroys free chunks, largest first, until `size` more bytes fit under the cap
+	bool makeRoom(VkDeviceSize size);
+
+	VmaAllocator allocator;
+	VkDeviceSize memoryCap{ 0 };
+
+	std::vector<std::unique_ptr<StagingChunk>> chunks;
+	std::vector<StagingChunk*> freeChunks[STAGING_SIZE_CLASSES];
+	// released, but the transfer reading them may not have finished yet
+	std::vector<StagingChunk*> pendingChunks;
+
+	StagingPoolStats stats;
+};
@@ -0,0 +1,74 @@
+#include "staticbatcher.h"
+
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <cstring>
+#include <map>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+
+void StaticBatcher::add(const StaticBatchSource& source) {
+	sources.push_back(source);
+}
+
+std::vector<StaticBatch> StaticBatcher::build(float chunkSize) {
+	// group the sources by material and chunk, the map keeps the output order stable between runs
+	using ChunkKey = std::tuple<MaterialId, int32_t, int32_t, int32_t>;
+	std::map<ChunkKey, std::vector<const StaticBatchSource*>> chunks;
+
+	for (const StaticBatchSource& source : sources) {
+		glm::vec3 centre = (source.boundsMin + source.boundsMax) * 0.5f;
+		glm::ivec3 cell = glm::ivec3(glm::floor(centre / chunkSize));
+		chunks[{ source.material, cell.x, cell.y, cell.z }].push_back(&source);
+	}
+
+	std::vector<StaticBatch> batches;
+	batches.reserve(chunks.size());
+
+	for (auto& [key, chunkSources] : chunks) {
+		size_t vertexCount = 0;
+		for (const StaticBatchSource* source : chunkSources) {
+			vertexCount += source->mesh->vertices.size();
+		}
+
+		StaticBatch batch;
+		batch.material = std::get<0>(key);
+		batch.sourceCount = (uint32_t)chunkSources.size();
+		batch.mesh = std::make_unique<Mesh>();
+
+		Mesh& mesh = *batch.mesh;
+		// reserving up front keeps the vertex data in place, so the dedup map can key on views into it
+		mesh.vertices.reserve(vertexCount);
+		mesh.indices.reserve(vertexCount);
+
+		std::unordered_map<std::string_view, uint32_t> uniqueVertices;
+		uniqueVertices.reserve(vertexCount);
+
+		for (const StaticBatchSource* source : chunkSources) {
+			const glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(source->transformMatrix));
+
+			for (const Vertex& vertex : source->mesh->vertices) {
+				Vertex worldVertex = vertex;
+				worldVertex.position = glm::vec3(source->transformMatrix * glm::vec4(vertex.position, 1.f));
+				worldVertex.normal = glm::normalize(normalMatrix * vertex.normal);
+
+				mesh.vertices.push_back(worldVertex);
+				std::string_view vertexBytes((const char*)&mesh.vertices.back(), sizeof(Vertex));
+
+				auto [it, inserted] = uniqueVertices.try_emplace(vertexBytes, (uint32_t)mesh.vertices.size() - 1);
+				if (!inserted) {
+					mesh.vertices.pop_back();
+				}
+
+				mesh.indices.push_back(it->second);
+			}
+		}
+
+		mesh.vertices.shrink_to_fit();
+		mesh.calculateBounds();
+		batches.push_back(std::move(batch));
+	}
+
+	return batches;
+}
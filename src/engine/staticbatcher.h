@@ -0,0 +1,39 @@
+#pragma once
+
+#include <utils/types.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "mesh.h"
+
+struct StaticBatchSource {
+	Mesh* mesh;
+	MaterialId material;
+	glm::mat4 transformMatrix;
+	// world space bounds, used to pick the chunk the source ends up in
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+};
+
+struct StaticBatch {
+	MaterialId material;
+	// indexed mesh with its vertices already in world space
+	std::unique_ptr<Mesh> mesh;
+	uint32_t sourceCount{ 0 };
+};
+
+// Merges immovable objects that share a material into combined world space meshes. The merged mesh has a single
+// material index in the object buffer, so sources that only share a bind state still end up in separate batches.
+// Objects are split into a grid of chunks by the centre of their bounds, so each batch stays small enough to be frustum culled.
+class StaticBatcher {
+public:
+	void add(const StaticBatchSource& source);
+	std::vector<StaticBatch> build(float chunkSize);
+
+	size_t getSourceCount() const { return sources.size(); }
+
+protected:
+	std::vector<StaticBatchSource> sources;
+};
@@ -6,16 +6,23 @@
 #include <iostream>
 
 #include "renderer.h"
+#include "rendergraph.h"
 #include "console.h"
 
-void TextureManager::init(Console& console) {
+void TextureManager::init(Console& console, uint32_t textureCapacity) {
 	this->console = &console;
+	loadedTextures.init(textureCapacity);
 }
 
-Texture* TextureManager::loadTexture(Renderer& renderer, const char* file) {
-	auto pair = loadedTextures.find(file);
-	if (pair != loadedTextures.end()) {
-		return &(*pair).second;
+TextureHandle TextureManager::loadTexture(Renderer& renderer, const char* file, uint64_t tick) {
+	TextureHandle handle = loadedTextures.find(file);
+	if (handle.isValid()) {
+		return handle;
+	}
+
+	if (loadedTextures.getCount() == loadedTextures.getCapacity()) {
+		console->log("[ERROR]: Texture limit of " + std::to_string(loadedTextures.getCapacity()) + " reached, failed to load " + std::string(file));
+		return {};
 	}
 
 	int32_t textureWidth, textureHeight, textureChannels;
@@ -23,91 +30,77 @@ Texture* TextureManager::loadTexture(Renderer& renderer, const char* file) {
 
 	if (!pixels) {
 		console->log("Failed to load texture file " + std::string(file));
-		return nullptr;
+		return {};
 	}
 
-	void* pixel_ptr = pixels;
-	VkDeviceSize imageSize = textureWidth * textureHeight * 4;
+	const VkDeviceSize rowSize = (VkDeviceSize)textureWidth * 4;
+	VkDeviceSize imageSize = rowSize * textureHeight;
 	VkFormat image_format = VK_FORMAT_R8G8B8A8_SRGB;
 
-	AllocatedBuffer stagingBuffer = renderer.createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-
-	void* data;
-	vmaMapMemory(renderer.allocator, stagingBuffer.allocation, &data);
-	memcpy(data, pixel_ptr, static_cast<size_t>(imageSize));
-	vmaUnmapMemory(renderer.allocator, stagingBuffer.allocation);
-	stbi_image_free(pixels);
-
 	VkExtent3D imageExtent;
 	imageExtent.width = static_cast<uint32_t>(textureWidth);
 	imageExtent.height = static_cast<uint32_t>(textureHeight);
 	imageExtent.depth = 1;
 
-	VkImageCreateInfo dimg_info = vkinit::imageCreateInfo(image_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent);
+	VkImageCreateInfo dimg_info = vkinit::imageCreateInfo(image_format, TEXTURE_USAGE, imageExtent);
 	AllocatedImage newImage;
 	VmaAllocationCreateInfo dimg_allocinfo = {};
 	dimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
 	vmaCreateImage(renderer.allocator, &dimg_info, &dimg_allocinfo, &newImage.image, &newImage.allocation, nullptr);
 
-	renderer.immediateSubmit([&](VkCommandBuffer cmd) {
-		VkImageSubresourceRange range;
-		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		range.baseMipLevel = 0;
-		range.levelCount = 1;
-		range.baseArrayLayer = 0;
-		range.layerCount = 1;
-
-		VkImageMemoryBarrier imageBarrier_toTransfer = {};
-		imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-
-		imageBarrier_toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageBarrier_toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageBarrier_toTransfer.image = newImage.image;
-		imageBarrier_toTransfer.subresourceRange = range;
-
-		imageBarrier_toTransfer.srcAccessMask = 0;
-		imageBarrier_toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-		//barrier the image into the transfer-receive layout
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toTransfer);
-
-		VkBufferImageCopy copyRegion = {};
-		copyRegion.bufferOffset = 0;
-		copyRegion.bufferRowLength = 0;
-		copyRegion.bufferImageHeight = 0;
-
-		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		copyRegion.imageSubresource.mipLevel = 0;
-		copyRegion.imageSubresource.baseArrayLayer = 0;
-		copyRegion.imageSubresource.layerCount = 1;
-		copyRegion.imageExtent = imageExtent;
-
-		//copy the buffer into the image
-		vkCmdCopyBufferToImage(cmd, stagingBuffer.buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-		VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
-
-		imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		//barrier the image into the shader readable layout
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
+	//the pixels are staged a band of whole rows per chunk, so big textures never need a staging buffer of their own size
+	const bool uploaded = renderer.stageUpload(pixels, imageSize, rowSize, [&](VkCommandBuffer cmd, const StagedCopy* copies, uint32_t copyCount, bool first, bool last) {
+		//the graph moves the image into the transfer layout for the first copies, and on to the shader readable layout after the last
+		RenderGraph graph;
+		graph.init(renderer.device, renderer.allocator, *console);
+
+		RenderGraphState state = {};
+		if (!first) {
+			state = { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+		}
+
+		RenderGraphResource texture = graph.importImage(file, newImage.image, VK_IMAGE_ASPECT_COLOR_BIT, state);
+		graph.markOutput(texture, last ? USAGE_FRAGMENT_SAMPLED : USAGE_TRANSFER_DST);
+
+		graph.addPass("Texture Upload", [&](VkCommandBuffer cmd) {
+			for (uint32_t i = 0; i < copyCount; ++i) {
+				VkBufferImageCopy copyRegion = {};
+				copyRegion.bufferOffset = 0;
+				copyRegion.bufferRowLength = 0;
+				copyRegion.bufferImageHeight = 0;
+
+				copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				copyRegion.imageSubresource.mipLevel = 0;
+				copyRegion.imageSubresource.baseArrayLayer = 0;
+				copyRegion.imageSubresource.layerCount = 1;
+				copyRegion.imageOffset = { 0, (int32_t)(copies[i].dataOffset / rowSize), 0 };
+				copyRegion.imageExtent = { imageExtent.width, (uint32_t)(copies[i].size / rowSize), 1 };
+
+				//copy the chunk's rows into the image
+				vkCmdCopyBufferToImage(cmd, copies[i].buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+			}
+		})
+			.write(texture, USAGE_TRANSFER_DST);
+
+		graph.compile();
+		graph.execute(cmd);
+		graph.cleanup();
 	});
+	stbi_image_free(pixels);
 
-	renderer.mainDeletionQueue.pushFunction([=]() {
+	if (!uploaded) {
+		//never made shader readable, and the copies submitted before the upload was abandoned have been waited on
+		console->log("[ERROR]: Failed to upload texture " + std::string(file));
 		vmaDestroyImage(renderer.allocator, newImage.image, newImage.allocation);
-	});
-
-	vmaDestroyBuffer(renderer.allocator, stagingBuffer.buffer, stagingBuffer.allocation);
+		return {};
+	}
 
 	console->log("Texture " + std::string(file) + " loaded successfully");
 
 	Texture newTexture = {};
 	newTexture.image = newImage;
+	newTexture.extent = imageExtent;
 
 	VkImageViewCreateInfo imageInfo = vkinit::imageviewCreateInfo(
 		VK_FORMAT_R8G8B8A8_SRGB, newTexture.image.image, VK_IMAGE_ASPECT_COLOR_BIT
@@ -115,10 +108,9 @@ Texture* TextureManager::loadTexture(Renderer& renderer, const char* file) {
 
 	vkCreateImageView(renderer.device, &imageInfo, nullptr, &newTexture.imageView);
 
-	renderer.mainDeletionQueue.pushFunction([=]() {
-		vkDestroyImageView(renderer.device, newTexture.imageView, nullptr);
-	});
+	//textures are uploaded without mips, so the image is exactly its pixels
+	AssetMemory memory;
+	memory.gpuBytes = imageSize;
 
-	loadedTextures[file] = newTexture;
-	return &loadedTextures[file];
+	return loadedTextures.add(file, std::move(newTexture), memory, tick);
 }
\ No newline at end of file
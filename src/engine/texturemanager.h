@@ -4,18 +4,25 @@ class Renderer;
 class Console;
 
 #include <utils/types.h>
-#include <unordered_map>
+
+#include "assetpool.h"
+
+// textures are copied out of as well when defragmentation moves them
+constexpr VkImageUsageFlags TEXTURE_USAGE = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
 struct Texture {
 	AllocatedImage image;
 	VkImageView imageView;
+	VkExtent3D extent;
 };
 
 class TextureManager {
 public:
-	void init(Console& console);
-	Texture* loadTexture(Renderer& renderer, const char* file);
-	std::unordered_map<std::string, Texture> loadedTextures;
+	void init(Console& console, uint32_t textureCapacity);
+	// Like meshes, textures stay loaded after their last reference is released until they get evicted
+	TextureHandle loadTexture(Renderer& renderer, const char* file, uint64_t tick);
+	Texture* getTexture(TextureHandle handle) { return loadedTextures.get(handle); }
+	AssetPool<Texture> loadedTextures;
 
 protected:
 	Console* console;
@@ -264,4 +264,43 @@ VkWriteDescriptorSet vkinit::writeDescriptorImage(VkDescriptorType type, VkDescr
 	write.pImageInfo = imageInfo;
 
 	return write;
+}
+
+VkComputePipelineCreateInfo vkinit::computePipelineCreateInfo(VkShaderModule shaderModule, VkPipelineLayout layout) {
+	VkComputePipelineCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	info.pNext = nullptr;
+
+	info.stage = pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, shaderModule);
+	info.layout = layout;
+
+	return info;
+}
+
+VkRenderingAttachmentInfo vkinit::renderingAttachmentInfo(VkImageView view, VkImageLayout layout, VkAttachmentLoadOp loadOp, VkClearValue clearValue /*= {}*/) {
+	VkRenderingAttachmentInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+	info.pNext = nullptr;
+
+	info.imageView = view;
+	info.imageLayout = layout;
+	info.loadOp = loadOp;
+	info.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	info.clearValue = clearValue;
+
+	return info;
+}
+
+VkRenderingInfo vkinit::renderingInfo(VkExtent2D extent, const VkRenderingAttachmentInfo* colorAttachment, const VkRenderingAttachmentInfo* depthAttachment) {
+	VkRenderingInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+	info.pNext = nullptr;
+
+	info.renderArea = { { 0, 0 }, extent };
+	info.layerCount = 1;
+	info.colorAttachmentCount = colorAttachment ? 1 : 0;
+	info.pColorAttachments = colorAttachment;
+	info.pDepthAttachment = depthAttachment;
+
+	return info;
 }
\ No newline at end of file
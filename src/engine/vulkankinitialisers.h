@@ -36,9 +36,13 @@ namespace vkinit {
 	VkPipelineMultisampleStateCreateInfo multisamplingStateCreateInfo();
 	VkPipelineColorBlendAttachmentState colorBlendAttachmentState();
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo();
+	VkComputePipelineCreateInfo computePipelineCreateInfo(VkShaderModule shaderModule, VkPipelineLayout layout);
 
 	VkDescriptorSetLayoutBinding descriptorsetLayoutBinding(VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t binding);
 	VkWriteDescriptorSet writeDescriptorBuffer(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorBufferInfo* bufferInfo, uint32_t binding);
 	VkSamplerCreateInfo samplerCreateInfo(VkFilter filters, VkSamplerAddressMode samplerAddressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT);
 	VkWriteDescriptorSet writeDescriptorImage(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorImageInfo* imageInfo, uint32_t binding);
+
+	VkRenderingAttachmentInfo renderingAttachmentInfo(VkImageView view, VkImageLayout layout, VkAttachmentLoadOp loadOp, VkClearValue clearValue = {});
+	VkRenderingInfo renderingInfo(VkExtent2D extent, const VkRenderingAttachmentInfo* colorAttachment, const VkRenderingAttachmentInfo* depthAttachment);
 }
\ No newline at end of file
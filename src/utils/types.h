@@ -7,20 +7,35 @@
 #include <string>
 #include <sstream>
 
-struct Material {
+class Console;
+
+// Logs the result and aborts when it is an error, defined in renderer.cpp
+void VK_CHECK(VkResult err, Console& console);
+
+// Index into the GPU material buffer, reused once the material is released
+typedef uint32_t MaterialId;
+constexpr MaterialId INVALID_MATERIAL = UINT32_MAX;
+
+// The pipelines and sets a material is drawn with. Materials that only differ in their parameters share one,
+// so they sort next to each other and draw without rebinding anything
+struct MaterialBindState {
     VkDescriptorSet textureSet{ VK_NULL_HANDLE };
     VkPipeline pipeline;
     VkPipelineLayout pipelineLayout;
+    // same as pipeline but with an equal depth test and no depth writes, used after the depth pre-pass
+    VkPipeline depthEqualPipeline{ VK_NULL_HANDLE };
+    // created along with the bind state and released with it
+    MaterialId baseMaterial{ INVALID_MATERIAL };
 };
 
 struct AllocatedBuffer {
-    VkBuffer buffer;
-    VmaAllocation allocation;
+    VkBuffer buffer{ VK_NULL_HANDLE };
+    VmaAllocation allocation{ VK_NULL_HANDLE };
 };
 
 struct AllocatedImage {
-    VkImage image;
-    VmaAllocation allocation;
+    VkImage image{ VK_NULL_HANDLE };
+    VmaAllocation allocation{ VK_NULL_HANDLE };
 };
 
 namespace utils {